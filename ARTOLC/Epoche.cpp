@@ -5,11 +5,19 @@
 #define EPOCHE_CPP
 
 #include <assert.h>
+#include <stdlib.h>
 #include <iostream>
+#include <new>
 #include "Epoche.h"
 using namespace ART;
 
 
+inline NodePool::~NodePool() {
+    for (void *slab : slabs) {
+        free(slab);
+    }
+}
+
 inline DeletionList::~DeletionList() {
     assert(deletitionListCount == 0 && headDeletionList == nullptr);
     LabelDelete *cur = nullptr, *next = freeLabelDeletes;
@@ -38,7 +46,7 @@ inline void DeletionList::remove(LabelDelete *label, LabelDelete *prev) {
     deleted += label->nodesCount;
 }
 
-inline void DeletionList::add(void *n, uint64_t globalEpoch) {
+inline void DeletionList::add(void *n, uint64_t globalEpoch, uint8_t sizeClass) {
     deletitionListCount++;
     LabelDelete *label;
     if (headDeletionList != nullptr && headDeletionList->nodesCount < headDeletionList->nodes.size()) {
@@ -55,6 +63,7 @@ inline void DeletionList::add(void *n, uint64_t globalEpoch) {
         headDeletionList = label;
     }
     label->nodes[label->nodesCount] = n;
+    label->sizeClasses[label->nodesCount] = sizeClass;
     label->nodesCount++;
     label->epoche = globalEpoch;
 
@@ -70,8 +79,62 @@ inline void Epoche::enterEpoche(ThreadInfo &epocheInfo) {
     epocheInfo.getDeletionList().localEpoche.store(curEpoche, std::memory_order_release);
 }
 
-inline void Epoche::markNodeForDeletion(void *n, ThreadInfo &epocheInfo) {
-    epocheInfo.getDeletionList().add(n, currentEpoche.load());
+inline void *Epoche::allocateNode(std::size_t size, uint8_t sizeClass, ThreadInfo &epocheInfo) {
+    NodePool &pool = epocheInfo.getDeletionList().pool;
+    pool.allocations[sizeClass]++;
+    if (!poolNodes) {
+        return operator new(size);
+    }
+    if (pool.freeList[sizeClass] != nullptr) {
+        pool.hits[sizeClass]++;
+        NodePool::FreeNode *n = pool.freeList[sizeClass];
+        pool.freeList[sizeClass] = n->next;
+        return n;
+    }
+    // Round up to whole cache lines so that no two nodes share one
+    std::size_t stride = (size + 63) & ~static_cast<std::size_t>(63);
+    if (pool.slabLeft[sizeClass] == 0) {
+        void *slab;
+        if (posix_memalign(&slab, 64, stride * NodePool::slabNodes) != 0) {
+            throw std::bad_alloc();
+        }
+        pool.slabs.push_back(slab);
+        pool.slabPos[sizeClass] = static_cast<char *>(slab);
+        pool.slabLeft[sizeClass] = NodePool::slabNodes;
+    }
+    void *n = pool.slabPos[sizeClass];
+    pool.slabPos[sizeClass] += stride;
+    pool.slabLeft[sizeClass]--;
+    return n;
+}
+
+inline void Epoche::freeNode(void *n, uint8_t sizeClass, DeletionList &deletionList) {
+    if (poolNodes && sizeClass != NodePool::noSizeClass) {
+        NodePool &pool = deletionList.pool;
+        auto freeNode = static_cast<NodePool::FreeNode *>(n);
+        freeNode->next = pool.freeList[sizeClass];
+        pool.freeList[sizeClass] = freeNode;
+        pool.recycled[sizeClass]++;
+    } else {
+        operator delete(n);
+    }
+}
+
+inline void Epoche::getNodePoolStats(uint64_t allocations[], uint64_t hits[], uint64_t recycled[]) {
+    for (std::size_t i = 0; i < NodePool::sizeClasses; ++i) {
+        allocations[i] = hits[i] = recycled[i] = 0;
+    }
+    for (auto &d : deletionLists) {
+        for (std::size_t i = 0; i < NodePool::sizeClasses; ++i) {
+            allocations[i] += d.pool.allocations[i];
+            hits[i] += d.pool.hits[i];
+            recycled[i] += d.pool.recycled[i];
+        }
+    }
+}
+
+inline void Epoche::markNodeForDeletion(void *n, ThreadInfo &epocheInfo, uint8_t sizeClass) {
+    epocheInfo.getDeletionList().add(n, currentEpoche.load(), sizeClass);
     epocheInfo.getDeletionList().thresholdCounter++;
 }
 
@@ -79,6 +142,7 @@ inline void Epoche::exitEpocheAndCleanup(ThreadInfo &epocheInfo) {
     DeletionList &deletionList = epocheInfo.getDeletionList();
     if ((deletionList.thresholdCounter & (64 - 1)) == 1) {
         currentEpoche++;
+        ART_COUNT(epocheInfo, epocheAdvances);
     }
     if (deletionList.thresholdCounter > startGCThreshhold) {
         if (deletionList.size() == 0) {
@@ -101,7 +165,7 @@ inline void Epoche::exitEpocheAndCleanup(ThreadInfo &epocheInfo) {
 
             if (cur->epoche < oldestEpoche) {
                 for (std::size_t i = 0; i < cur->nodesCount; ++i) {
-                    operator delete(cur->nodes[i]);
+                    freeNode(cur->nodes[i], cur->sizeClasses[i], deletionList);
                 }
                 deletionList.remove(cur, prev);
             } else {
@@ -128,7 +192,7 @@ inline Epoche::~Epoche() {
 
             assert(cur->epoche < oldestEpoche);
             for (std::size_t i = 0; i < cur->nodesCount; ++i) {
-                operator delete(cur->nodes[i]);
+                freeNode(cur->nodes[i], cur->sizeClasses[i], d);
             }
             d.remove(cur, prev);
             cur = next;
@@ -3,6 +3,7 @@
 
 #include <atomic>
 #include <array>
+#include <vector>
 #include "tbb/enumerable_thread_specific.h"
 #include "tbb/combinable.h"
 
@@ -10,11 +11,64 @@ namespace ART {
 
     struct LabelDelete {
         std::array<void*, 32> nodes;
+        std::array<uint8_t, 32> sizeClasses;
         uint64_t epoche;
         std::size_t nodesCount;
         LabelDelete *next;
     };
 
+    /*
+     * NodePool - Per-thread free lists for the fixed node sizes of a tree
+     *
+     * Nodes are carved out of cache line aligned slabs and nodes reclaimed by
+     * the epoch manager go back to the free list of the thread reclaiming them.
+     * Slabs are only released together with the Epoche.
+     */
+    struct NodePool {
+        static constexpr std::size_t sizeClasses = 4;
+        static constexpr std::size_t slabNodes = 64;
+        static constexpr uint8_t noSizeClass = 0xFF;
+
+        struct FreeNode {
+            FreeNode *next;
+        };
+
+        FreeNode *freeList[sizeClasses] = {};
+        char *slabPos[sizeClasses] = {};
+        std::size_t slabLeft[sizeClasses] = {};
+        std::vector<void *> slabs;
+
+        uint64_t allocations[sizeClasses] = {};
+        uint64_t hits[sizeClasses] = {};
+        uint64_t recycled[sizeClasses] = {};
+
+        ~NodePool();
+    };
+
+    /*
+     * OpStats - Per-thread operation counters of a tree
+     *
+     * Traversals only count point operations (lookup, insert and remove)
+     */
+    struct OpStats {
+        uint64_t restarts = 0;
+        // Node grows and prefix splits
+        uint64_t splits = 0;
+        // Node shrinks and path collapses
+        uint64_t merges = 0;
+        uint64_t epocheAdvances = 0;
+        uint64_t traversals = 0;
+        uint64_t traversalNodes = 0;
+    };
+
+// Counts an OpStats event of a thread; compiles to nothing unless the
+// counters are enabled with INDEX_COLLECT_STATISTICS
+#ifdef INDEX_COLLECT_STATISTICS
+#define ART_COUNT(threadInfo, name) ((threadInfo).getOpStats().name++)
+#else
+#define ART_COUNT(threadInfo, name) ((void)0)
+#endif
+
     class DeletionList {
         LabelDelete *headDeletionList = nullptr;
         LabelDelete *freeLabelDeletes = nullptr;
@@ -27,7 +81,7 @@ namespace ART {
         ~DeletionList();
         LabelDelete *head();
 
-        void add(void *n, uint64_t globalEpoch);
+        void add(void *n, uint64_t globalEpoch, uint8_t sizeClass);
 
         void remove(LabelDelete *label, LabelDelete *prev);
 
@@ -35,6 +89,10 @@ namespace ART {
 
         std::uint64_t deleted = 0;
         std::uint64_t added = 0;
+
+        NodePool pool;
+
+        OpStats stats;
     };
 
     class Epoche;
@@ -58,6 +116,13 @@ namespace ART {
         ~ThreadInfo();
 
         Epoche & getEpoche() const;
+
+        OpStats & getOpStats() const { return deletionList.stats; }
+
+        // Nodes (including leaves) this thread handed to and got back from the epoch manager
+        uint64_t getRetiredCount() const { return deletionList.added; }
+
+        uint64_t getFreedCount() const { return deletionList.deleted; }
     };
 
     class Epoche {
@@ -68,6 +133,10 @@ namespace ART {
 
         size_t startGCThreshhold;
 
+        bool poolNodes = false;
+
+        void freeNode(void *n, uint8_t sizeClass, DeletionList &deletionList);
+
 
     public:
         Epoche(size_t startGCThreshhold) : startGCThreshhold(startGCThreshhold) { }
@@ -76,7 +145,17 @@ namespace ART {
 
         void enterEpoche(ThreadInfo &epocheInfo);
 
-        void markNodeForDeletion(void *n, ThreadInfo &epocheInfo);
+        void markNodeForDeletion(void *n, ThreadInfo &epocheInfo, uint8_t sizeClass = NodePool::noSizeClass);
+
+        // Pooling must be chosen before the first node is allocated
+        void setNodePool(bool enabled) { poolNodes = enabled; }
+
+        bool isNodePool() const { return poolNodes; }
+
+        void *allocateNode(std::size_t size, uint8_t sizeClass, ThreadInfo &epocheInfo);
+
+        // Sums the per-thread pool counters; each array has NodePool::sizeClasses entries
+        void getNodePoolStats(uint64_t allocations[], uint64_t hits[], uint64_t recycled[]);
 
         void exitEpocheAndCleanup(ThreadInfo &info);
 
@@ -89,6 +89,33 @@ namespace ART_OLC {
         __builtin_unreachable();
     }
 
+    void N::insert(N *node, uint8_t key, N *val) {
+        switch (node->getType()) {
+            case NTypes::N4: {
+                auto n = static_cast<N4 *>(node);
+                n->insert(key, val);
+                return;
+            }
+            case NTypes::N16: {
+                auto n = static_cast<N16 *>(node);
+                n->insert(key, val);
+                return;
+            }
+            case NTypes::N48: {
+                auto n = static_cast<N48 *>(node);
+                n->insert(key, val);
+                return;
+            }
+            case NTypes::N256: {
+                auto n = static_cast<N256 *>(node);
+                n->insert(key, val);
+                return;
+            }
+        }
+        assert(false);
+        __builtin_unreachable();
+    }
+
     template<typename curN, typename biggerN>
     void N::insertGrow(curN *n, uint64_t v, N *parentNode, uint64_t parentVersion, uint8_t keyParent, uint8_t key, N *val, bool &needRestart, ThreadInfo &threadInfo) {
         if (!n->isFull()) {
@@ -112,14 +139,15 @@ namespace ART_OLC {
             return;
         }
 
-        auto nBig = new biggerN(n->getPrefix(), n->getPrefixLength());
+        auto nBig = N::newNode<biggerN>(n->getPrefix(), n->getPrefixLength(), threadInfo);
+        ART_COUNT(threadInfo, splits);
         n->copyTo(nBig);
         nBig->insert(key, val);
 
         N::change(parentNode, keyParent, nBig);
 
         n->writeUnlockObsolete();
-        threadInfo.getEpoche().markNodeForDeletion(n, threadInfo);
+        N::retireNode(n, threadInfo);
         parentNode->writeUnlock();
     }
 
@@ -224,14 +252,15 @@ namespace ART_OLC {
             return;
         }
 
-        auto nSmall = new smallerN(n->getPrefix(), n->getPrefixLength());
+        auto nSmall = N::newNode<smallerN>(n->getPrefix(), n->getPrefixLength(), threadInfo);
+        ART_COUNT(threadInfo, merges);
 
         n->copyTo(nSmall);
         nSmall->remove(key);
         N::change(parentNode, keyParent, nSmall);
 
         n->writeUnlockObsolete();
-        threadInfo.getEpoche().markNodeForDeletion(n, threadInfo);
+        N::retireNode(n, threadInfo);
         parentNode->writeUnlock();
     }
 
@@ -425,4 +454,27 @@ namespace ART_OLC {
         assert(false);
         __builtin_unreachable();
     }
-}
\ No newline at end of file
+
+    N *N::getNextChild(const N *node, uint32_t &k, uint8_t end) {
+        switch (node->getType()) {
+            case NTypes::N4: {
+                auto n = static_cast<const N4 *>(node);
+                return n->getNextChild(k, end);
+            }
+            case NTypes::N16: {
+                auto n = static_cast<const N16 *>(node);
+                return n->getNextChild(k, end);
+            }
+            case NTypes::N48: {
+                auto n = static_cast<const N48 *>(node);
+                return n->getNextChild(k, end);
+            }
+            case NTypes::N256: {
+                auto n = static_cast<const N256 *>(node);
+                return n->getNextChild(k, end);
+            }
+        }
+        assert(false);
+        __builtin_unreachable();
+    }
+}
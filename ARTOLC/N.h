@@ -96,6 +96,11 @@ namespace ART_OLC {
 
         static bool change(N *node, uint8_t key, N *val);
 
+        /**
+         * inserts without growing or locking; only for nodes that are not yet reachable and have room
+         */
+        static void insert(N *node, uint8_t key, N *val);
+
         static void removeAndUnlock(N *node, uint64_t v, uint8_t key, N *parentNode, uint64_t parentVersion, uint8_t keyParent, bool &needRestart, ThreadInfo &threadInfo);
 
         bool hasPrefix() const;
@@ -124,6 +129,23 @@ namespace ART_OLC {
 
         static std::tuple<N *, uint8_t> getSecondChild(N *node, const uint8_t k);
 
+        /**
+         * allocates an inner node through the epoch manager, which may hand out a pooled one
+         */
+        template<typename NODE>
+        static NODE *newNode(const uint8_t *prefix, uint32_t prefixLength, ThreadInfo &threadInfo) {
+            void *mem = threadInfo.getEpoche().allocateNode(sizeof(NODE), static_cast<uint8_t>(NODE::nodeType),
+                                                            threadInfo);
+            return new(mem) NODE(prefix, prefixLength);
+        }
+
+        /**
+         * hands an obsolete inner node to the epoch manager
+         */
+        static void retireNode(N *node, ThreadInfo &threadInfo) {
+            threadInfo.getEpoche().markNodeForDeletion(node, threadInfo, static_cast<uint8_t>(node->getType()));
+        }
+
         template<typename curN, typename biggerN>
         static void insertGrow(curN *n, uint64_t v, N *parentNode, uint64_t parentVersion, uint8_t keyParent, uint8_t key, N *val, bool &needRestart, ThreadInfo &threadInfo);
 
@@ -132,6 +154,12 @@ namespace ART_OLC {
 
         static uint64_t getChildren(const N *node, uint8_t start, uint8_t end, std::tuple<uint8_t, N *> children[],
                                 uint32_t &childrenCount);
+
+        /**
+         * returns the child with the smallest key in [k, end] and stores its key in k,
+         * or nullptr; the caller validates the version afterwards
+         */
+        static N *getNextChild(const N *node, uint32_t &k, uint8_t end);
     };
 
     class N4 : public N {
@@ -140,6 +168,8 @@ namespace ART_OLC {
         N *children[4] = {nullptr, nullptr, nullptr, nullptr};
 
     public:
+        static constexpr NTypes nodeType = NTypes::N4;
+
         N4(const uint8_t *prefix, uint32_t prefixLength) : N(NTypes::N4, prefix,
                                                                              prefixLength) { }
 
@@ -166,6 +196,8 @@ namespace ART_OLC {
 
         uint64_t getChildren(uint8_t start, uint8_t end, std::tuple<uint8_t, N *> *&children,
                          uint32_t &childrenCount) const;
+
+        N *getNextChild(uint32_t &k, uint8_t end) const;
     };
 
     class N16 : public N {
@@ -195,6 +227,8 @@ namespace ART_OLC {
         N *const *getChildPos(const uint8_t k) const;
 
     public:
+        static constexpr NTypes nodeType = NTypes::N16;
+
         N16(const uint8_t *prefix, uint32_t prefixLength) : N(NTypes::N16, prefix,
                                                                               prefixLength) {
             memset(keys, 0, sizeof(keys));
@@ -222,6 +256,8 @@ namespace ART_OLC {
 
         uint64_t getChildren(uint8_t start, uint8_t end, std::tuple<uint8_t, N *> *&children,
                          uint32_t &childrenCount) const;
+
+        N *getNextChild(uint32_t &k, uint8_t end) const;
     };
 
     class N48 : public N {
@@ -230,6 +266,8 @@ namespace ART_OLC {
     public:
         static const uint8_t emptyMarker = 48;
 
+        static constexpr NTypes nodeType = NTypes::N48;
+
         N48(const uint8_t *prefix, uint32_t prefixLength) : N(NTypes::N48, prefix,
                                                                               prefixLength) {
             memset(childIndex, emptyMarker, sizeof(childIndex));
@@ -257,12 +295,16 @@ namespace ART_OLC {
 
         uint64_t getChildren(uint8_t start, uint8_t end, std::tuple<uint8_t, N *> *&children,
                          uint32_t &childrenCount) const;
+
+        N *getNextChild(uint32_t &k, uint8_t end) const;
     };
 
     class N256 : public N {
         N *children[256];
 
     public:
+        static constexpr NTypes nodeType = NTypes::N256;
+
         N256(const uint8_t *prefix, uint32_t prefixLength) : N(NTypes::N256, prefix,
                                                                                prefixLength) {
             memset(children, '\0', sizeof(children));
@@ -289,6 +331,8 @@ namespace ART_OLC {
 
         uint64_t getChildren(uint8_t start, uint8_t end, std::tuple<uint8_t, N *> *&children,
                          uint32_t &childrenCount) const;
+
+        N *getNextChild(uint32_t &k, uint8_t end) const;
     };
 }
 #endif //ART_OPTIMISTIC_LOCK_COUPLING_N_H
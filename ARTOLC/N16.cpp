@@ -109,4 +109,24 @@ namespace ART_OLC {
         if (needRestart) goto restart;
         return v;
     }
-}
\ No newline at end of file
+
+    N *N16::getNextChild(uint32_t &k, uint8_t end) const {
+        if (k > end) {
+            return nullptr;
+        }
+        // keys are sorted by their flipped value, so the first one not below k is the next child
+        __m128i cmp = _mm_cmplt_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(keys)),
+                                     _mm_set1_epi8(flipSign(k)));
+        unsigned bitfield = ~_mm_movemask_epi8(cmp) & ((1 << count) - 1);
+        if (bitfield == 0) {
+            return nullptr;
+        }
+        unsigned pos = ctz(bitfield);
+        uint8_t key = flipSign(keys[pos]);
+        if (key > end) {
+            return nullptr;
+        }
+        k = key;
+        return children[pos];
+    }
+}
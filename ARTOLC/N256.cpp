@@ -81,4 +81,14 @@ namespace ART_OLC {
         if (needRestart) goto restart;
         return v;
     }
-}
\ No newline at end of file
+
+    N *N256::getNextChild(uint32_t &k, uint8_t end) const {
+        for (unsigned i = k; i <= end; i++) {
+            if (this->children[i] != nullptr) {
+                k = i;
+                return this->children[i];
+            }
+        }
+        return nullptr;
+    }
+}
@@ -106,4 +106,17 @@ namespace ART_OLC {
         if (needRestart) goto restart;
         return v;
     }
-}
\ No newline at end of file
+
+    N *N4::getNextChild(uint32_t &k, uint8_t end) const {
+        for (uint32_t i = 0; i < count; ++i) {
+            if (keys[i] >= k) {
+                if (keys[i] > end) {
+                    return nullptr;
+                }
+                k = keys[i];
+                return children[i];
+            }
+        }
+        return nullptr;
+    }
+}
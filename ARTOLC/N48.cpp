@@ -93,4 +93,14 @@ namespace ART_OLC {
         if (needRestart) goto restart;
         return v;
     }
-}
\ No newline at end of file
+
+    N *N48::getNextChild(uint32_t &k, uint8_t end) const {
+        for (unsigned i = k; i <= end; i++) {
+            if (this->childIndex[i] != emptyMarker) {
+                k = i;
+                return this->children[this->childIndex[i]];
+            }
+        }
+        return nullptr;
+    }
+}
@@ -1,5 +1,7 @@
 #include <assert.h>
 #include <algorithm>
+#include <vector>
+#include <thread>
 #include "Tree.h"
 #include "N.cpp"
 #include "Epoche.cpp"
@@ -8,11 +10,20 @@
 
 namespace ART_OLC {
 
-    Tree::Tree(LoadKeyFunction loadKey) : root(new N256( nullptr, 0)), loadKey(loadKey) {
+    Tree::Tree(LoadKeyFunction loadKey) : root(new N256( nullptr, 0)), loadKey(loadKey), ownsLeaves(false) {
+    }
+
+    Tree::Tree() : root(new N256( nullptr, 0)), loadKey(loadLeafKey), ownsLeaves(true) {
     }
 
     Tree::~Tree() {
-        N::deleteChildren(root);
+        if (ownsLeaves) {
+            deleteLeaves(root);
+        }
+        // Pooled nodes go away with the slabs of the epoch manager
+        if (!epoche.isNodePool()) {
+            N::deleteChildren(root);
+        }
         N::deleteNode(root);
     }
 
@@ -30,10 +41,13 @@ namespace ART_OLC {
 
     TID Tree::lookup(const Key &k, ThreadInfo &threadEpocheInfo) const {
         EpocheGuardReadonly epocheGuard(threadEpocheInfo);
+        ART_COUNT(threadEpocheInfo, traversals);
         int restartCount = 0;
     restart:
-        if (restartCount++)
+        if (restartCount++) {
+           ART_COUNT(threadEpocheInfo, restarts);
            yield(restartCount);
+        }
         bool needRestart = false;
 
         N *node;
@@ -46,6 +60,7 @@ namespace ART_OLC {
         v = node->readLockOrRestart(needRestart);
         if (needRestart) goto restart;
         while (true) {
+            ART_COUNT(threadEpocheInfo, traversalNodes);
             switch (checkPrefix(node, k, level)) { // increases level
                 case CheckPrefixResult::NoMatch:
                     node->readUnlockOrRestart(v, needRestart);
@@ -74,7 +89,7 @@ namespace ART_OLC {
                         if (level < k.getKeyLen() - 1 || optimisticPrefixMatch) {
                             return checkKey(tid, k);
                         }
-                        return tid;
+                        return leafValue(tid);
                     }
                     level++;
             }
@@ -87,8 +102,29 @@ namespace ART_OLC {
         }
     }
 
-    bool Tree::lookupRange(const Key &start, const Key &end, Key &continueKey, TID result[],
-                                std::size_t resultSize, std::size_t &resultsFound, ThreadInfo &threadEpocheInfo) const {
+    int Tree::compareLeafKey(TID tid, const Key &k) const {
+        const uint8_t *leafKey;
+        uint32_t leafKeyLen;
+        Key kt;
+        if (ownsLeaves) {
+            auto leaf = reinterpret_cast<const Leaf *>(tid);
+            leafKey = leaf->key;
+            leafKeyLen = leaf->keyLen;
+        } else {
+            this->loadKey(tid, kt);
+            leafKey = &kt[0];
+            leafKeyLen = kt.getKeyLen();
+        }
+        int c = std::memcmp(leafKey, &k[0], std::min(leafKeyLen, k.getKeyLen()));
+        if (c != 0) {
+            return c;
+        }
+        return (leafKeyLen > k.getKeyLen()) - (leafKeyLen < k.getKeyLen());
+    }
+
+    template<typename Consumer>
+    bool Tree::scanRange(const Key &start, const Key &end, Key &continueKey, std::size_t resultSize,
+                         std::size_t &resultsFound, Consumer &&consume, ThreadInfo &threadEpocheInfo) const {
         for (uint32_t i = 0; i < std::min(start.getKeyLen(), end.getKeyLen()); ++i) {
             if (start[i] > end[i]) {
                 resultsFound = 0;
@@ -98,237 +134,115 @@ namespace ART_OLC {
             }
         }
         EpocheGuard epocheGuard(threadEpocheInfo);
-        TID toContinue = 0;
-        std::function<void(const N *)> copy = [&result, &resultSize, &resultsFound, &toContinue, &copy](const N *node) {
-            if (N::isLeaf(node)) {
-                if (resultsFound == resultSize) {
-                    toContinue = N::getLeaf(node);
-                    return;
-                }
-                result[resultsFound] = N::getLeaf(node);
-                resultsFound++;
-            } else {
-                std::tuple<uint8_t, N *> children[256];
-                uint32_t childrenCount = 0;
-                N::getChildren(node, 0u, 255u, children, childrenCount);
-                for (uint32_t i = 0; i < childrenCount; ++i) {
-                    const N *n = std::get<1>(children[i]);
-                    copy(n);
-                    if (toContinue != 0) {
-                        break;
-                    }
-                }
-            }
-        };
-        std::function<void(N *, uint8_t, uint32_t, const N *, uint64_t)> findStart = [&copy, &start, &findStart, &toContinue, this](
-                N *node, uint8_t nodeK, uint32_t level, const N *parentNode, uint64_t vp) {
-            if (N::isLeaf(node)) {
-                copy(node);
-                return;
-            }
-            uint64_t v;
-            PCCompareResults prefixResult;
-
-            {
-                readAgain:
-                bool needRestart = false;
-                v = node->readLockOrRestart(needRestart);
-                if (needRestart) goto readAgain;
-
-                prefixResult = checkPrefixCompare(node, start, 0, level, loadKey, needRestart);
-                if (needRestart) goto readAgain;
 
-                parentNode->readUnlockOrRestart(vp, needRestart);
-                if (needRestart) {
-                    readParentAgain:
-		  needRestart = false;
-                    vp = parentNode->readLockOrRestart(needRestart);
-                    if (needRestart) goto readParentAgain;
-
-                    node = N::getChild(nodeK, parentNode);
-
-                    parentNode->readUnlockOrRestart(vp, needRestart);
-                    if (needRestart) goto readParentAgain;
-
-                    if (node == nullptr) {
-                        return;
-                    }
-                    if (N::isLeaf(node)) {
-                        copy(node);
-                        return;
-                    }
-                    goto readAgain;
-                }
-                node->readUnlockOrRestart(v, needRestart);
-                if (needRestart) goto readAgain;
-            }
-
-            switch (prefixResult) {
-                case PCCompareResults::Bigger:
-                    copy(node);
-                    break;
-                case PCCompareResults::Equal: {
-                    uint8_t startLevel = (start.getKeyLen() > level) ? start[level] : 0;
-                    std::tuple<uint8_t, N *> children[256];
-                    uint32_t childrenCount = 0;
-                    v = N::getChildren(node, startLevel, 255, children, childrenCount);
-                    for (uint32_t i = 0; i < childrenCount; ++i) {
-                        const uint8_t k = std::get<0>(children[i]);
-                        N *n = std::get<1>(children[i]);
-                        if (k == startLevel) {
-                            findStart(n, k, level + 1, node, v);
-                        } else if (k > startLevel) {
-                            copy(n);
-                        }
-                        if (toContinue != 0) {
-                            break;
-                        }
-                    }
-                    break;
-                }
-                case PCCompareResults::Smaller:
-                    break;
-            }
+        // One frame per inner node on the current path; children are visited in
+        // key order by advancing next, so no child lists are materialized
+        struct ScanFrame {
+            N *node;
+            uint64_t version;
+            uint32_t level;
+            uint16_t next;
+            uint8_t startKey, endKey;
+            bool onStart, onEnd;
         };
-        std::function<void(N *, uint8_t, uint32_t, const N *, uint64_t)> findEnd = [&copy, &end, &toContinue, &findEnd, this](
-                N *node, uint8_t nodeK, uint32_t level, const N *parentNode, uint64_t vp) {
-            if (N::isLeaf(node)) {
-                return;
-            }
-            uint64_t v;
-            PCCompareResults prefixResult;
-            {
-                readAgain:
-                bool needRestart = false;
-                v = node->readLockOrRestart(needRestart);
-                if (needRestart) goto readAgain;
-
-                prefixResult = checkPrefixCompare(node, end, 255, level, loadKey, needRestart);
-                if (needRestart) goto readAgain;
-
-                parentNode->readUnlockOrRestart(vp, needRestart);
-                if (needRestart) {
-                    readParentAgain:
-                    vp = parentNode->readLockOrRestart(needRestart);
-                    if (needRestart) goto readParentAgain;
+        static thread_local std::vector<ScanFrame> stack;
 
-                    node = N::getChild(nodeK, parentNode);
-
-                    parentNode->readUnlockOrRestart(vp, needRestart);
-                    if (needRestart) goto readParentAgain;
+        // After a restart the scan resumes strictly after the last leaf it returned
+        Key restartKey;
+        const Key *lower = &start;
+        bool lowerExclusive = false;
+        TID lastLeaf = 0;
+        TID toContinue = 0;
 
-                    if (node == nullptr) {
-                        return;
-                    }
-                    if (N::isLeaf(node)) {
-                        return;
-                    }
-                    goto readAgain;
-                }
-                node->readUnlockOrRestart(v, needRestart);
-                if (needRestart) goto readAgain;
+        enum class EnterResult : uint8_t { Pushed, Skipped, Restart };
+        auto enter = [&](N *node, uint32_t level, bool onStart, bool onEnd) {
+            bool needRestart = false;
+            uint64_t v = node->readLockOrRestart(needRestart);
+            if (needRestart) return EnterResult::Restart;
+            uint32_t nextLevel = level + node->getPrefixLength();
+            if (onStart) {
+                uint32_t l = level;
+                auto res = checkPrefixCompare(node, *lower, 0, l, loadKey, needRestart);
+                if (needRestart) return EnterResult::Restart;
+                if (res == PCCompareResults::Smaller) return EnterResult::Skipped;
+                onStart = (res == PCCompareResults::Equal);
             }
-            switch (prefixResult) {
-                case PCCompareResults::Smaller:
-                    copy(node);
-                    break;
-                case PCCompareResults::Equal: {
-                    uint8_t endLevel = (end.getKeyLen() > level) ? end[level] : 255;
-                    std::tuple<uint8_t, N *> children[256];
-                    uint32_t childrenCount = 0;
-                    v = N::getChildren(node, 0, endLevel, children, childrenCount);
-                    for (uint32_t i = 0; i < childrenCount; ++i) {
-                        const uint8_t k = std::get<0>(children[i]);
-                        N *n = std::get<1>(children[i]);
-                        if (k == endLevel) {
-                            findEnd(n, k, level + 1, node, v);
-                        } else if (k < endLevel) {
-                            copy(n);
-                        }
-                        if (toContinue != 0) {
-                            break;
-                        }
-                    }
-                    break;
-                }
-                case PCCompareResults::Bigger:
-                    break;
+            if (onEnd) {
+                uint32_t l = level;
+                auto res = checkPrefixCompare(node, end, 255, l, loadKey, needRestart);
+                if (needRestart) return EnterResult::Restart;
+                if (res == PCCompareResults::Bigger) return EnterResult::Skipped;
+                onEnd = (res == PCCompareResults::Equal);
             }
+            node->checkOrRestart(v, needRestart);
+            if (needRestart) return EnterResult::Restart;
+
+            ScanFrame f;
+            f.node = node;
+            f.version = v;
+            f.level = nextLevel;
+            f.startKey = (onStart && lower->getKeyLen() > nextLevel) ? (*lower)[nextLevel] : 0;
+            f.endKey = (onEnd && end.getKeyLen() > nextLevel) ? end[nextLevel] : 255;
+            f.next = f.startKey;
+            f.onStart = onStart;
+            f.onEnd = onEnd;
+            stack.push_back(f);
+            return EnterResult::Pushed;
         };
 
-
         int restartCount = 0;
     restart:
-        if (restartCount++)
-           yield(restartCount);
-        bool needRestart = false;
-
-        resultsFound = 0;
-
-        uint32_t level = 0;
-        N *node = nullptr;
-        N *nextNode = root;
-        N *parentNode;
-        uint64_t v = 0;
-        uint64_t vp;
-
-        while (true) {
-            parentNode = node;
-            vp = v;
-            node = nextNode;
-            PCEqualsResults prefixResult;
-            v = node->readLockOrRestart(needRestart);
-            if (needRestart) goto restart;
-            prefixResult = checkPrefixEquals(node, level, start, end, loadKey, needRestart);
-            if (needRestart) goto restart;
-            if (parentNode != nullptr) {
-                parentNode->readUnlockOrRestart(vp, needRestart);
-                if (needRestart) goto restart;
+        if (restartCount++) {
+            ART_COUNT(threadEpocheInfo, restarts);
+            yield(restartCount);
+            if (lastLeaf != 0) {
+                loadKey(lastLeaf, restartKey);
+                lower = &restartKey;
+                lowerExclusive = true;
             }
-            node->readUnlockOrRestart(v, needRestart);
+        }
+        stack.clear();
+        if (enter(root, 0, true, true) == EnterResult::Restart) goto restart;
+
+        while (!stack.empty()) {
+            ScanFrame &f = stack.back();
+            if (f.next > f.endKey) {
+                stack.pop_back();
+                continue;
+            }
+            uint32_t k = f.next;
+            N *child = N::getNextChild(f.node, k, f.endKey);
+            bool needRestart = false;
+            f.node->checkOrRestart(f.version, needRestart);
             if (needRestart) goto restart;
-
-            switch (prefixResult) {
-                case PCEqualsResults::NoMatch: {
-                    return false;
-                }
-                case PCEqualsResults::Contained: {
-                    copy(node);
-                    break;
+            if (child == nullptr) {
+                stack.pop_back();
+                continue;
+            }
+            f.next = k + 1;
+            bool onStart = f.onStart && k == f.startKey;
+            bool onEnd = f.onEnd && k == f.endKey;
+
+            if (N::isLeaf(child)) {
+                TID leaf = N::getLeaf(child);
+                // Only leaves on a boundary path can fall outside the range
+                if (onStart) {
+                    int c = compareLeafKey(leaf, *lower);
+                    if (c < 0 || (c == 0 && lowerExclusive)) continue;
                 }
-                case PCEqualsResults::BothMatch: {
-                    uint8_t startLevel = (start.getKeyLen() > level) ? start[level] : 0;
-                    uint8_t endLevel = (end.getKeyLen() > level) ? end[level] : 255;
-                    if (startLevel != endLevel) {
-                        std::tuple<uint8_t, N *> children[256];
-                        uint32_t childrenCount = 0;
-                        v = N::getChildren(node, startLevel, endLevel, children, childrenCount);
-                        for (uint32_t i = 0; i < childrenCount; ++i) {
-                            const uint8_t k = std::get<0>(children[i]);
-                            N *n = std::get<1>(children[i]);
-                            if (k == startLevel) {
-                                findStart(n, k, level + 1, node, v);
-                            } else if (k > startLevel && k < endLevel) {
-                                copy(n);
-                            } else if (k == endLevel) {
-                                findEnd(n, k, level + 1, node, v);
-                            }
-                            if (toContinue) {
-                                break;
-                            }
-                        }
-                    } else {
-                        nextNode = N::getChild(startLevel, node);
-                        node->readUnlockOrRestart(v, needRestart);
-                        if (needRestart) goto restart;
-                        level++;
-                        continue;
-                    }
+                if (onEnd && compareLeafKey(leaf, end) > 0) continue;
+                if (resultsFound == resultSize) {
+                    toContinue = leaf;
                     break;
                 }
+                consume(resultsFound, leafValue(leaf));
+                resultsFound++;
+                lastLeaf = leaf;
+            } else {
+                if (enter(child, f.level + 1, onStart, onEnd) == EnterResult::Restart) goto restart;
             }
-            break;
         }
+
         if (toContinue != 0) {
             loadKey(toContinue, continueKey);
             return true;
@@ -337,8 +251,29 @@ namespace ART_OLC {
         }
     }
 
+    bool Tree::lookupRange(const Key &start, const Key &end, Key &continueKey, TID result[],
+                                std::size_t resultSize, std::size_t &resultsFound, ThreadInfo &threadEpocheInfo) const {
+        resultsFound = 0;
+        return scanRange(start, end, continueKey, resultSize, resultsFound,
+                         [result](std::size_t i, TID value) { result[i] = value; }, threadEpocheInfo);
+    }
+
+    bool Tree::lookupRange(const Key &start, const Key &end, Key &continueKey, ScanFunction fn, void *arg,
+                           std::size_t resultSize, std::size_t &resultsFound, ThreadInfo &threadEpocheInfo) const {
+        resultsFound = 0;
+        return scanRange(start, end, continueKey, resultSize, resultsFound,
+                         [fn, arg](std::size_t, TID value) { fn(value, arg); }, threadEpocheInfo);
+    }
 
     TID Tree::checkKey(const TID tid, const Key &k) const {
+        if (ownsLeaves) {
+            // Compare in place instead of copying the key out of the leaf
+            auto leaf = reinterpret_cast<const Leaf *>(tid);
+            if (leaf->keyLen == k.getKeyLen() && std::memcmp(leaf->key, &k[0], leaf->keyLen) == 0) {
+                return leaf->value;
+            }
+            return 0;
+        }
         Key kt;
         this->loadKey(tid, kt);
         if (k == kt) {
@@ -347,12 +282,53 @@ namespace ART_OLC {
         return 0;
     }
 
+    void Tree::loadLeafKey(TID tid, Key &key) {
+        auto leaf = reinterpret_cast<const Leaf *>(tid);
+        key.set(reinterpret_cast<const char *>(leaf->key), leaf->keyLen);
+    }
+
+    TID Tree::makeLeaf(const Key &k, TID value) {
+        auto leaf = static_cast<Leaf *>(operator new(sizeof(Leaf) + k.getKeyLen()));
+        leaf->value = value;
+        leaf->keyLen = k.getKeyLen();
+        memcpy(leaf->key, &k[0], k.getKeyLen());
+        return reinterpret_cast<TID>(leaf);
+    }
+
+    void Tree::deleteLeaves(N *node) {
+        uint32_t k = 0;
+        N *n;
+        while ((n = N::getNextChild(node, k, 255)) != nullptr) {
+            k++;
+            if (N::isLeaf(n)) {
+                operator delete(reinterpret_cast<void *>(N::getLeaf(n)));
+            } else {
+                deleteLeaves(n);
+            }
+        }
+    }
+
     void Tree::insert(const Key &k, TID tid, ThreadInfo &epocheInfo) {
         EpocheGuard epocheGuard(epocheInfo);
+        // With self-contained leaves the leaf is built once, on first use, and
+        // survives restarts until it is linked into the tree
+        TID newLeaf = 0;
+        auto leafTid = [&]() {
+            if (!ownsLeaves) {
+                return tid;
+            }
+            if (newLeaf == 0) {
+                newLeaf = makeLeaf(k, tid);
+            }
+            return newLeaf;
+        };
+        ART_COUNT(epocheInfo, traversals);
         int restartCount = 0;
     restart:
-        if (restartCount++)
+        if (restartCount++) {
+           ART_COUNT(epocheInfo, restarts);
            yield(restartCount);
+        }
         bool needRestart = false;
 
         N *node = nullptr;
@@ -366,6 +342,7 @@ namespace ART_OLC {
             parentNode = node;
             parentKey = nodeKey;
             node = nextNode;
+            ART_COUNT(epocheInfo, traversalNodes);
             auto v = node->readLockOrRestart(needRestart);
             if (needRestart) goto restart;
 
@@ -387,10 +364,11 @@ namespace ART_OLC {
                         goto restart;
                     }
                     // 1) Create new node which will be parent of node, Set common prefix, level to this node
-                    auto newNode = new N4(node->getPrefix(), nextLevel - level);
+                    auto newNode = N::newNode<N4>(node->getPrefix(), nextLevel - level, epocheInfo);
+                    ART_COUNT(epocheInfo, splits);
 
                     // 2)  add node and (tid, *k) as children
-                    newNode->insert(k[nextLevel], N::setLeaf(tid));
+                    newNode->insert(k[nextLevel], N::setLeaf(leafTid()));
                     newNode->insert(nonMatchingKey, node);
 
                     // 3) upgradeToWriteLockOrRestart, update parentNode to point to the new node, unlock
@@ -414,7 +392,7 @@ namespace ART_OLC {
             if (needRestart) goto restart;
 
             if (nextNode == nullptr) {
-                N::insertAndUnlock(node, v, parentNode, parentVersion, parentKey, nodeKey, N::setLeaf(tid), needRestart, epocheInfo);
+                N::insertAndUnlock(node, v, parentNode, parentVersion, parentKey, nodeKey, N::setLeaf(leafTid()), needRestart, epocheInfo);
                 if (needRestart) goto restart;
                 return;
             }
@@ -433,7 +411,14 @@ namespace ART_OLC {
 
 		if (key == k) {
 		  // upsert
-		  N::change(node, k[level], N::setLeaf(tid));
+		  if (ownsLeaves) {
+		    // Overwrite the value in place; a leaf built before a restart
+		    // was never published and can be freed right away
+		    reinterpret_cast<Leaf *>(N::getLeaf(nextNode))->value = tid;
+		    operator delete(reinterpret_cast<void *>(newLeaf));
+		  } else {
+		    N::change(node, k[level], N::setLeaf(tid));
+		  }
 		  node->writeUnlock();
 		  return;
 		}
@@ -444,8 +429,8 @@ namespace ART_OLC {
                     prefixLength++;
                 }
 
-                auto n4 = new N4(&k[level], prefixLength);
-                n4->insert(k[level + prefixLength], N::setLeaf(tid));
+                auto n4 = N::newNode<N4>(&k[level], prefixLength, epocheInfo);
+                n4->insert(k[level + prefixLength], N::setLeaf(leafTid()));
                 n4->insert(key[level + prefixLength], nextNode);
                 N::change(node, k[level - 1], n4);
                 node->writeUnlock();
@@ -456,12 +441,167 @@ namespace ART_OLC {
         }
     }
 
+    // Subtrees of the bulk load that are left to the worker threads
+    struct BulkTask {
+        N *parent;
+        uint8_t key;
+        std::size_t begin, end;
+        uint32_t level;
+        N *child;
+    };
+
+    struct Tree::BulkLoader {
+        BulkKeyFunction keyAt;
+        BulkByteFunction byteFn;
+        void *arg;
+        const TID *tids;
+        // Ranges up to this size become a task instead of being split further
+        std::size_t grain;
+        std::vector<BulkTask> tasks;
+
+        uint8_t byteAt(std::size_t i, uint32_t depth) {
+            return byteFn(i, depth, arg);
+        }
+
+        // Returns the end of the run of keys sharing the byte of key begin at
+        // depth; keys are sorted, so a galloping search finds it
+        std::size_t runEnd(std::size_t begin, std::size_t end, uint32_t depth) {
+            uint8_t b = byteAt(begin, depth);
+            std::size_t lo = begin, step = 1;
+            while (lo + step < end && byteAt(lo + step, depth) == b) {
+                lo += step;
+                step *= 2;
+            }
+            std::size_t hi = std::min(lo + step, end);
+            while (hi - lo > 1) {
+                std::size_t mid = lo + (hi - lo) / 2;
+                if (byteAt(mid, depth) == b) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+            return hi;
+        }
+    };
+
+    N *Tree::bulkLeaf(BulkLoader &loader, std::size_t i) const {
+        if (!ownsLeaves) {
+            return N::setLeaf(loader.tids[i]);
+        }
+        Key k;
+        loader.keyAt(i, k, loader.arg);
+        return N::setLeaf(makeLeaf(k, loader.tids[i]));
+    }
+
+    void Tree::bulkFill(BulkLoader &loader, N *node, std::size_t begin, std::size_t end, uint32_t depth, bool plan,
+                        ThreadInfo &threadInfo) {
+        std::size_t runBegin = begin;
+        while (runBegin < end) {
+            uint8_t b = loader.byteAt(runBegin, depth);
+            std::size_t hi = loader.runEnd(runBegin, end, depth);
+            if (plan && hi - runBegin > 1 && hi - runBegin <= loader.grain) {
+                // Linked in by N::change() once a worker has built it
+                loader.tasks.push_back(BulkTask{node, b, runBegin, hi, depth + 1, nullptr});
+                N::insert(node, b, nullptr);
+            } else {
+                N::insert(node, b, bulkBuild(loader, runBegin, hi, depth + 1, plan, threadInfo));
+            }
+            runBegin = hi;
+        }
+    }
+
+    N *Tree::bulkBuild(BulkLoader &loader, std::size_t begin, std::size_t end, uint32_t level, bool plan,
+                       ThreadInfo &threadInfo) {
+        if (end - begin == 1) {
+            return bulkLeaf(loader, begin);
+        }
+        Key first, last;
+        loader.keyAt(begin, first, loader.arg);
+        loader.keyAt(end - 1, last, loader.arg);
+        uint32_t depth = level;
+        uint32_t maxDepth = std::min(first.getKeyLen(), last.getKeyLen());
+        while (depth < maxDepth && first[depth] == last[depth]) {
+            depth++;
+        }
+        if (depth == maxDepth) {
+            // Only duplicates get here since keys must not be prefixes of each other
+            return bulkLeaf(loader, end - 1);
+        }
+
+        // Count the distinct bytes at depth to pick the node type up front
+        uint32_t childCount = 0;
+        std::size_t i = begin;
+        while (i < end) {
+            i = loader.runEnd(i, end, depth);
+            childCount++;
+        }
+
+        N *node;
+        if (childCount <= 4) {
+            node = N::newNode<N4>(&first[level], depth - level, threadInfo);
+        } else if (childCount <= 16) {
+            node = N::newNode<N16>(&first[level], depth - level, threadInfo);
+        } else if (childCount <= 48) {
+            node = N::newNode<N48>(&first[level], depth - level, threadInfo);
+        } else {
+            node = N::newNode<N256>(&first[level], depth - level, threadInfo);
+        }
+        bulkFill(loader, node, begin, end, depth, plan, threadInfo);
+        return node;
+    }
+
+    bool Tree::bulkLoad(std::size_t count, BulkKeyFunction keyAt, BulkByteFunction byteAt, void *arg,
+                        const TID tids[], int threadNum) {
+        if (root->getCount() != 0) {
+            return false;
+        }
+        if (count == 0) {
+            return true;
+        }
+        std::size_t workers = threadNum < 1 ? 1 : static_cast<std::size_t>(threadNum);
+        BulkLoader loader{keyAt, byteAt, arg, tids, std::max<std::size_t>(count / (workers * 16), 1), {}};
+
+        // The main thread builds the top of the tree down to ranges of at most
+        // grain keys, which are then built in parallel and linked in below
+        {
+            ThreadInfo threadInfo = getThreadInfo();
+            bulkFill(loader, root, 0, count, 0, workers > 1, threadInfo);
+        }
+
+        std::atomic<std::size_t> nextTask{0};
+        auto work = [this, &loader, &nextTask]() {
+            ThreadInfo threadInfo = getThreadInfo();
+            std::size_t i;
+            while ((i = nextTask++) < loader.tasks.size()) {
+                BulkTask &task = loader.tasks[i];
+                task.child = bulkBuild(loader, task.begin, task.end, task.level, false, threadInfo);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (std::size_t i = 1; i < workers; ++i) {
+            threads.emplace_back(work);
+        }
+        work();
+        for (std::thread &t : threads) {
+            t.join();
+        }
+
+        for (BulkTask &task : loader.tasks) {
+            N::change(task.parent, task.key, task.child);
+        }
+        return true;
+    }
+
     void Tree::remove(const Key &k, TID tid, ThreadInfo &threadInfo) {
         EpocheGuard epocheGuard(threadInfo);
+        ART_COUNT(threadInfo, traversals);
         int restartCount = 0;
     restart:
-        if (restartCount++)
+        if (restartCount++) {
+           ART_COUNT(threadInfo, restarts);
            yield(restartCount);
+        }
         bool needRestart = false;
 
         N *node = nullptr;
@@ -475,6 +615,7 @@ namespace ART_OLC {
             parentNode = node;
             parentKey = nodeKey;
             node = nextNode;
+            ART_COUNT(threadInfo, traversalNodes);
             auto v = node->readLockOrRestart(needRestart);
             if (needRestart) goto restart;
 
@@ -498,7 +639,11 @@ namespace ART_OLC {
                         return;
                     }
                     if (N::isLeaf(nextNode)) {
-                        if (N::getLeaf(nextNode) != tid) {
+                        TID leaf = N::getLeaf(nextNode);
+                        if (leafValue(leaf) != tid) {
+                            return;
+                        }
+                        if (ownsLeaves && checkKey(leaf, k) != tid) {
                             return;
                         }
                         assert(parentNode == nullptr || node->getCount() != 1);
@@ -515,13 +660,14 @@ namespace ART_OLC {
                             N *secondNodeN;
                             uint8_t secondNodeK;
                             std::tie(secondNodeN, secondNodeK) = N::getSecondChild(node, nodeKey);
+                            ART_COUNT(threadInfo, merges);
                             if (N::isLeaf(secondNodeN)) {
                                 //N::remove(node, k[level]); not necessary
                                 N::change(parentNode, parentKey, secondNodeN);
 
                                 parentNode->writeUnlock();
                                 node->writeUnlockObsolete();
-                                this->epoche.markNodeForDeletion(node, threadInfo);
+                                N::retireNode(node, threadInfo);
                             } else {
                                 secondNodeN->writeLockOrRestart(needRestart);
                                 if (needRestart) {
@@ -538,12 +684,15 @@ namespace ART_OLC {
                                 secondNodeN->writeUnlock();
 
                                 node->writeUnlockObsolete();
-                                this->epoche.markNodeForDeletion(node, threadInfo);
+                                N::retireNode(node, threadInfo);
                             }
                         } else {
                             N::removeAndUnlock(node, v, k[level], parentNode, parentVersion, parentKey, needRestart, threadInfo);
                             if (needRestart) goto restart;
                         }
+                        if (ownsLeaves) {
+                            this->epoche.markNodeForDeletion(reinterpret_cast<void *>(leaf), threadInfo);
+                        }
                         return;
                     }
                     level++;
@@ -10,10 +10,31 @@ using namespace ART;
 
 namespace ART_OLC {
 
+    /*
+     * Leaf - Self-contained leaf holding the full key next to its value
+     *
+     * Trees constructed without a LoadKeyFunction store one of these behind
+     * every leaf pointer instead of the raw TID, so key checks never leave the
+     * tree. An 8 byte integer key and its value share a single 24 byte object.
+     */
+    struct Leaf {
+        TID value;
+        uint32_t keyLen;
+        uint8_t key[];
+    };
+
     class Tree {
     public:
         using LoadKeyFunction = void (*)(TID tid, Key &key);
 
+        using ScanFunction = void (*)(TID value, void *arg);
+
+        // Stores the i-th key of a bulk load into key
+        using BulkKeyFunction = void (*)(std::size_t i, Key &key, void *arg);
+
+        // Returns byte depth of the i-th key of a bulk load
+        using BulkByteFunction = uint8_t (*)(std::size_t i, uint32_t depth, void *arg);
+
     private:
         N *const root;
 
@@ -21,6 +42,35 @@ namespace ART_OLC {
 
         LoadKeyFunction loadKey;
 
+        // True if leaves point to Leaf objects owned by the tree
+        const bool ownsLeaves;
+
+        static void loadLeafKey(TID tid, Key &key);
+
+        static TID makeLeaf(const Key &k, TID value);
+
+        static void deleteLeaves(N *node);
+
+        struct BulkLoader;
+
+        N *bulkLeaf(BulkLoader &loader, std::size_t i) const;
+
+        N *bulkBuild(BulkLoader &loader, std::size_t begin, std::size_t end, uint32_t level, bool plan,
+                     ThreadInfo &threadInfo);
+
+        void bulkFill(BulkLoader &loader, N *node, std::size_t begin, std::size_t end, uint32_t depth, bool plan,
+                      ThreadInfo &threadInfo);
+
+        int compareLeafKey(TID tid, const Key &k) const;
+
+        template<typename Consumer>
+        bool scanRange(const Key &start, const Key &end, Key &continueKey, std::size_t resultSize,
+                       std::size_t &resultsFound, Consumer &&consume, ThreadInfo &threadEpocheInfo) const;
+
+        TID leafValue(TID tid) const {
+            return ownsLeaves ? reinterpret_cast<const Leaf *>(tid)->value : tid;
+        }
+
         Epoche epoche{256};
 
     public:
@@ -60,21 +110,47 @@ namespace ART_OLC {
 
         Tree(LoadKeyFunction loadKey);
 
+        // Stores keys in self-contained leaves; lookups return the inserted values
+        Tree();
+
         Tree(const Tree &) = delete;
 
-        Tree(Tree &&t) : root(t.root), loadKey(t.loadKey) { }
+        Tree(Tree &&t) : root(t.root), loadKey(t.loadKey), ownsLeaves(t.ownsLeaves) { }
 
         ~Tree();
 
         ThreadInfo getThreadInfo();
 
+        // Recycles inner nodes through per-thread pools; call before the first insert
+        void setNodePool(bool enabled) { epoche.setNodePool(enabled); }
+
+        void getNodePoolStats(uint64_t allocations[], uint64_t hits[], uint64_t recycled[]) {
+            epoche.getNodePoolStats(allocations, hits, recycled);
+        }
+
         TID lookup(const Key &k, ThreadInfo &threadEpocheInfo) const;
 
         bool lookupRange(const Key &start, const Key &end, Key &continueKey, TID result[], std::size_t resultLen,
                          std::size_t &resultCount, ThreadInfo &threadEpocheInfo) const;
 
+        // Same as above but hands every value to fn instead of filling a buffer
+        bool lookupRange(const Key &start, const Key &end, Key &continueKey, ScanFunction fn, void *arg,
+                         std::size_t resultLen, std::size_t &resultCount, ThreadInfo &threadEpocheInfo) const;
+
         void insert(const Key &k, TID tid, ThreadInfo &epocheInfo);
 
+        /*
+         * bulkLoad() - Builds an empty tree from count keys in ascending order
+         *
+         * Subtrees are built with threadNum threads and get the node type that
+         * fits their fan-out right away. Duplicate keys keep the last TID.
+         * byteAt must agree with keyAt; it is used by the searches for the
+         * children of a node so that they do not build whole keys.
+         * Returns false if the tree is not empty
+         */
+        bool bulkLoad(std::size_t count, BulkKeyFunction keyAt, BulkByteFunction byteAt, void *arg,
+                      const TID tids[], int threadNum);
+
         void remove(const Key &k, TID tid, ThreadInfo &epocheInfo);
     };
 }
@@ -22,6 +22,29 @@ enum class PageType : uint8_t { BTreeInner=1, BTreeLeaf=2 };
 
 static const uint64_t pageSize=4*1024;
 
+// Per-thread counters of all trees; the adapter reads them after a phase.
+// Traversals only count point operations (insert and lookup)
+struct Stats {
+  uint64_t restarts;
+  uint64_t casFailures;
+  uint64_t splits;
+  uint64_t traversals;
+  uint64_t traversalNodes;
+};
+
+inline Stats &threadStats() {
+  static thread_local Stats stats{};
+  return stats;
+}
+
+// Counts an event in threadStats(); compiles to nothing unless the counters
+// are enabled with INDEX_COLLECT_STATISTICS
+#ifdef INDEX_COLLECT_STATISTICS
+#define OLC_COUNT(name) (threadStats().name++)
+#else
+#define OLC_COUNT(name) ((void)0)
+#endif
+
 struct OptLock {
   std::atomic<uint64_t> typeVersionLockObsolete{0b100};
 
@@ -52,6 +75,7 @@ struct OptLock {
     if (typeVersionLockObsolete.compare_exchange_strong(version, version + 0b10)) {
       version = version + 0b10;
     } else {
+      OLC_COUNT(casFailures);
       _mm_pause();
       needRestart = true;
     }
@@ -246,10 +270,13 @@ struct BTree {
   }
 
   void insert(Key k, Value v) {
+    OLC_COUNT(traversals);
     int restartCount = 0;
   restart:
-    if (restartCount++)
+    if (restartCount++) {
+      OLC_COUNT(restarts);
       yield(restartCount);
+    }
     bool needRestart = false;
 
     // Current node
@@ -283,6 +310,7 @@ struct BTree {
 	}
 	// Split
 	Key sep; BTreeInner<Key>* newInner = inner->split(sep);
+	OLC_COUNT(splits);
 	if (parent)
 	  parent->insert(sep,newInner);
 	else
@@ -302,6 +330,7 @@ struct BTree {
       parent = inner;
       versionParent = versionNode;
 
+      OLC_COUNT(traversalNodes);
       node = inner->children[inner->lowerBound(k)];
       inner->checkOrRestart(versionNode, needRestart);
       if (needRestart) goto restart;
@@ -329,6 +358,7 @@ struct BTree {
       }
       // Split
       Key sep; BTreeLeaf<Key,Value>* newLeaf = leaf->split(sep);
+      OLC_COUNT(splits);
       if (parent)
 	parent->insert(sep, newLeaf);
       else
@@ -356,10 +386,13 @@ struct BTree {
   }
 
   bool lookup(Key k, Value& result) {
+    OLC_COUNT(traversals);
     int restartCount = 0;
   restart:
-    if (restartCount++)
+    if (restartCount++) {
+      OLC_COUNT(restarts);
       yield(restartCount);
+    }
     bool needRestart = false;
 
     NodeBase* node = root;
@@ -381,6 +414,7 @@ struct BTree {
       parent = inner;
       versionParent = versionNode;
 
+      OLC_COUNT(traversalNodes);
       node = inner->children[inner->lowerBound(k)];
       inner->checkOrRestart(versionNode, needRestart);
       if (needRestart) goto restart;
@@ -408,8 +442,10 @@ struct BTree {
   uint64_t scan(Key k, int range, Value* output) {
     int restartCount = 0;
   restart:
-    if (restartCount++)
+    if (restartCount++) {
+      OLC_COUNT(restarts);
       yield(restartCount);
+    }
     bool needRestart = false;
 
     NodeBase* node = root;
@@ -46,9 +46,13 @@ const char *BwTreeBase::GCMetaData::COUNTER_NAME_LIST[] = {
 
       "MODIFY_ABORT",
       "READ_ABORT",
+      "CAS_FAILURE",
       
       "ADD_TO_GC",
       "SCAN_GC_CHAIN",
+      
+      "TRAVERSE",
+      "TRAVERSE_STEP",
     };
 #endif
 
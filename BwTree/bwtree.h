@@ -30,6 +30,7 @@
 #include <atomic>
 #include <cassert>
 #include <chrono>
+#include <mutex>
 #include <thread>
 #include <unordered_set>
 // offsetof() is defined here
@@ -75,6 +76,11 @@
 
 #define BWTREE_USE_DELTA_UPDATE
 
+// Whether each leaf adapts its consolidation threshold to the read/write
+// mix and CAS failures observed on it (see class NodeStat). Off by default;
+// build with ADAPTIVE_CONSOLIDATION=1 make to turn it on
+//#define BWTREE_ADAPTIVE_CONSOLIDATION
+
 // If we do not use mapping table, then must consolidate the index
 // also we do not call destructor
 #ifndef BWTREE_USE_MAPPING_TABLE
@@ -198,6 +204,22 @@ static_assert(INNER_DELTA_CHAIN_LENGTH_THRESHOLD >= 1 &&
               LEAF_DELTA_CHAIN_LENGTH_THRESHOLD >= 1,
               "Delta chain length must be greater than 0");
 
+// With adaptive consolidation the threshold of a leaf moves within these
+// bounds, starting from LEAF_DELTA_CHAIN_LENGTH_THRESHOLD
+static constexpr int LEAF_DELTA_CHAIN_LENGTH_MIN = 8;
+static constexpr int LEAF_DELTA_CHAIN_LENGTH_MAX = 64;
+
+static_assert(LEAF_DELTA_CHAIN_LENGTH_MIN >= 1 &&
+              LEAF_DELTA_CHAIN_LENGTH_MIN <= LEAF_DELTA_CHAIN_LENGTH_THRESHOLD &&
+              LEAF_DELTA_CHAIN_LENGTH_THRESHOLD <= LEAF_DELTA_CHAIN_LENGTH_MAX,
+              "Leaf delta chain threshold must be within its adaptive range");
+
+// One in this many leaf operations of a thread is sampled into the
+// statistics of that leaf; its threshold is revised every NODE_STAT_WINDOW
+// samples
+static constexpr uint32_t NODE_STAT_SAMPLE_RATE = 8;
+static constexpr uint32_t NODE_STAT_WINDOW = 64;
+
 // The following are split and merge thresholds. They must
 // be reasonable and if not then static assertion would fail
 
@@ -218,6 +240,55 @@ static_assert(LEAF_NODE_SIZE_UPPER_THRESHOLD >
               "Leaf node split threshold must be no smaller than 2 times"
               " of the merge threshold");
 
+/*
+ * struct BwTreeNodeSizing - Node size, delta chain and preallocation
+ *                           parameters of a BwTree instantiation
+ *
+ * The file scope constants above are the defaults. BwTree takes this as a
+ * template argument, and its class scope constants of the same names shadow
+ * the file scope ones, so differently tuned trees can live in one binary.
+ *
+ * The preallocated delta space of a base node holds *_PREALLOCATION_DELTAS
+ * delta records. It defaults to the consolidation threshold, which is the
+ * longest chain a node normally grows
+ */
+template <int InnerSizeUpper = INNER_NODE_SIZE_UPPER_THRESHOLD,
+          int InnerSizeLower = INNER_NODE_SIZE_LOWER_THRESHOLD,
+          int LeafSizeUpper = LEAF_NODE_SIZE_UPPER_THRESHOLD,
+          int LeafSizeLower = LEAF_NODE_SIZE_LOWER_THRESHOLD,
+          int InnerDeltaChainLength = INNER_DELTA_CHAIN_LENGTH_THRESHOLD,
+          int LeafDeltaChainLength = LEAF_DELTA_CHAIN_LENGTH_THRESHOLD,
+          int InnerPreallocationDeltas = InnerDeltaChainLength,
+          int LeafPreallocationDeltas = LeafDeltaChainLength>
+struct BwTreeNodeSizing {
+  static constexpr int INNER_NODE_SIZE_UPPER_THRESHOLD = InnerSizeUpper;
+  static constexpr int INNER_NODE_SIZE_LOWER_THRESHOLD = InnerSizeLower;
+  static constexpr int LEAF_NODE_SIZE_UPPER_THRESHOLD = LeafSizeUpper;
+  static constexpr int LEAF_NODE_SIZE_LOWER_THRESHOLD = LeafSizeLower;
+
+  static constexpr int INNER_DELTA_CHAIN_LENGTH_THRESHOLD = \
+    InnerDeltaChainLength;
+  static constexpr int LEAF_DELTA_CHAIN_LENGTH_THRESHOLD = \
+    LeafDeltaChainLength;
+
+  static constexpr int INNER_PREALLOCATION_DELTAS = InnerPreallocationDeltas;
+  static constexpr int LEAF_PREALLOCATION_DELTAS = LeafPreallocationDeltas;
+
+  static_assert(InnerSizeUpper > (InnerSizeLower * 2),
+                "Inner node split threshold must be no smaller than 2 times"
+                " of the merge threshold");
+  static_assert(LeafSizeUpper > (LeafSizeLower * 2),
+                "Leaf node split threshold must be no smaller than 2 times"
+                " of the merge threshold");
+  static_assert(InnerDeltaChainLength >= 1 && LeafDeltaChainLength >= 1,
+                "Delta chain length must be greater than 0");
+  static_assert(LeafDeltaChainLength >= LEAF_DELTA_CHAIN_LENGTH_MIN &&
+                LeafDeltaChainLength <= LEAF_DELTA_CHAIN_LENGTH_MAX,
+                "Leaf delta chain threshold must be within its adaptive range");
+  static_assert(InnerPreallocationDeltas >= 1 && LeafPreallocationDeltas >= 1,
+                "Preallocated space must hold at least one delta");
+};
+
 // This is the number of threads we support for new-style GC
 static constexpr int PREALLOCATE_THREAD_NUM = 1024;
 
@@ -228,7 +299,10 @@ static constexpr int PREALLOCATE_THREAD_NUM = 1024;
 // the thread-local storage for each thread
 // The driver program is responsible for clearing them after thread
 // finishes
+// These are turned on together with the counters of the other indexes
+#ifdef INDEX_COLLECT_STATISTICS
 #define BWTREE_COLLECT_STATISTICS
+#endif
 
 #ifdef BWTREE_COLLECT_STATISTICS
 #define INC_COUNTER(name, value) do { \
@@ -358,39 +432,56 @@ class BwTreeBase {
   // We invoke the GC procedure after this has been reached
   static constexpr size_t GC_NODE_COUNT_THREADHOLD = 1024;
   
+ public:
+  
+  // Number of garbage nodes buffered in one batch before it is sealed
+  static constexpr size_t GC_BATCH_SIZE = 64;
+  
   /*
-   * class GarbageNode - Garbage node used to represent delayed allocation
+   * class GarbageBatch - A fixed size array of garbage nodes
+   *
+   * Garbage nodes are appended to the current thread's open batch without
+   * any allocation. Once the batch is full it is sealed: we read the global
+   * epoch once and stamp it onto the whole batch, which is no earlier than
+   * the epoch any of its nodes was unlinked. Sealed batches are then either
+   * kept in the thread's own list, or handed off to the epoch thread if
+   * background GC is enabled. Empty batches are recycled by their owner
    *
    * Note that since we could not know the actual definition of BaseNode here,
    * all garbage pointer to BaseNode should be represented as void *, and are
    * casted to appropriate type manually
    */
-  class GarbageNode {
+  class GarbageBatch {
    public:
-    // The epoch that this node is unlinked
-    // This do not have to be exact - just make sure it is no earlier than the
-    // actual epoch it is unlinked from the data structure
+    // The epoch that the batch is sealed; all nodes inside are unlinked
+    // no later than this epoch
     uint64_t delete_epoch;
-    void *node_p;
-    GarbageNode *next_p;
+    
+    // Estimated number of bytes held by nodes in this batch
+    uint64_t byte_count;
+    
+    // Number of valid entries in node_list
+    size_t node_count;
+    
+    // GC ID of the thread that filled this batch; the batch is returned to
+    // this thread after it has been reclaimed
+    int owner_id;
+    
+    GarbageBatch *next_p;
+    
+    void *node_list[GC_BATCH_SIZE];
     
     /*
      * Constructor
      */
-    GarbageNode(uint64_t p_delete_epoch, void *p_node_p) :
-      delete_epoch{p_delete_epoch},
-      node_p{p_node_p},
-      next_p{nullptr}
-    {}
-    
-    GarbageNode() :
+    GarbageBatch(int p_owner_id) :
       delete_epoch{0UL},
-      node_p{nullptr},
+      byte_count{0UL},
+      node_count{0UL},
+      owner_id{p_owner_id},
       next_p{nullptr}
     {}
   };
-
- public:
   
   /*
    * class GCMetaData - Metadata for performing GC on per-thread basis
@@ -404,24 +495,49 @@ class BwTreeBase {
     // be recycled
     uint64_t last_active_epoch;
     
-    // We only need a pointer
-    GarbageNode header; 
+    // The batch currently being filled by this thread; nullptr if the
+    // thread has not retired any node since it was last emptied
+    GarbageBatch *open_p;
     
-    // This points to the last node in the garbage node linked list
-    // We always append new nodes to this pointer, and thus inside one
-    // node's context these garbage nodes are always sorted, from low
-    // epoch to high epoch. This facilitates memory reclaimation since we
-    // just start from the lowest epoch garbage and traverse the linked list
-    // until we see an epoch >= GC epoch
-    GarbageNode *last_p;
+    // This is the linked list of sealed batches waiting to be reclaimed
+    // by this thread. We always append new batches to last_p, and thus
+    // batches are sorted, from low epoch to high epoch. This facilitates
+    // memory reclaimation since we just start from the lowest epoch batch
+    // and traverse the linked list until we see an epoch >= GC epoch
+    GarbageBatch *first_p;
+    GarbageBatch *last_p;
     
-    // The number of nodes inside this GC context
+    // The number of nodes inside this GC context, including the open batch
+    // but not batches handed off to the epoch thread
     // We use this as a threshold to trigger GC
     uint64_t node_count;
     
+    // Empty batches owned by this thread. The epoch thread pushes batches
+    // it has reclaimed onto returned_p, which is taken as a whole by the
+    // owner once free_p runs out
+    GarbageBatch *free_p;
+    std::atomic<GarbageBatch *> returned_p;
+    
+    // Estimated bytes retired by this thread and reclaimed by this thread;
+    // the difference (minus what the epoch thread reclaimed) is the backlog
+    uint64_t retired_bytes;
+    uint64_t reclaimed_bytes;
+    
+    // Garbage nodes (i.e. delta chains) retired and reclaimed by this thread
+    uint64_t retired_nodes;
+    uint64_t reclaimed_nodes;
+    
+    // Time this thread spent inside PerformGC()
+    uint64_t gc_pause_count;
+    uint64_t gc_pause_ns;
+    uint64_t gc_pause_max_ns;
+
+    // Counts leaf operations of this thread to sample node statistics
+    uint32_t node_stat_tick;
+    
 #ifdef BWTREE_COLLECT_STATISTICS
     // The type of counter values
-    using CounterValueType = int;
+    using CounterValueType = uint64_t;
 
     static const char *COUNTER_NAME_LIST[];
 
@@ -443,10 +559,16 @@ class BwTreeBase {
       
       MODIFY_ABORT,
       READ_ABORT,
+      CAS_FAILURE,
       
       ADD_TO_GC,
       SCAN_GC_CHAIN,
       
+      // Descents that reached the leaf level and inner nodes navigated
+      // on the way, including those of aborted attempts
+      TRAVERSE,
+      TRAVERSE_STEP,
+      
       // This is the number of counters
       COUNTER_COUNT,
     };
@@ -460,9 +582,20 @@ class BwTreeBase {
      */
     GCMetaData() :
       last_active_epoch{0UL},
-      header{},
-      last_p{&header},
-      node_count{0UL} {
+      open_p{nullptr},
+      first_p{nullptr},
+      last_p{nullptr},
+      node_count{0UL},
+      free_p{nullptr},
+      returned_p{nullptr},
+      retired_bytes{0UL},
+      reclaimed_bytes{0UL},
+      retired_nodes{0UL},
+      reclaimed_nodes{0UL},
+      gc_pause_count{0UL},
+      gc_pause_ns{0UL},
+      gc_pause_max_ns{0UL},
+      node_stat_tick{0U} {
 #ifdef BWTREE_COLLECT_STATISTICS
       // Also initialize counters for statistical purpose
       // They are all initialized to 0
@@ -530,6 +663,61 @@ class BwTreeBase {
   // We need to make it atomic since multiple threads might try to modify it
   uint64_t epoch;
   
+  // Whether sealed garbage batches are handed off to the epoch thread
+  // instead of being reclaimed by worker threads
+  bool background_gc;
+  
+  // Sealed batches handed off by worker threads. The epoch thread takes
+  // the whole list at once so no ABA problem arises
+  std::atomic<GarbageBatch *> handoff_p;
+  
+  // Batches taken from handoff_p that are not yet safe to reclaim; only
+  // accessed by the epoch thread with gc_lock held
+  GarbageBatch *pending_p;
+  
+  // Bytes and nodes reclaimed and time spent by the epoch thread
+  std::atomic<uint64_t> background_reclaimed_bytes;
+  std::atomic<uint64_t> background_reclaimed_nodes;
+  std::atomic<uint64_t> background_gc_count;
+  std::atomic<uint64_t> background_gc_ns;
+  
+ public:
+ 
+  /*
+   * struct GCStats - GC work done while one thread local array was in use
+   */
+  struct GCStats {
+    // Time worker threads spent inside PerformGC()
+    uint64_t pause_count;
+    uint64_t pause_ns;
+    uint64_t pause_max_ns;
+    
+    // Rounds and time of the epoch thread
+    uint64_t background_count;
+    uint64_t background_ns;
+    
+    // Estimated bytes retired but not reclaimed when the array was dropped
+    uint64_t backlog_bytes;
+    
+    // Garbage nodes retired while the array was in use, those reclaimed
+    // by then, and those reclaimed when the array was dropped. The last two
+    // always add up to the first one
+    uint64_t retired_nodes;
+    uint64_t reclaimed_nodes;
+    uint64_t drained_nodes;
+  };
+  
+ private:
+ 
+  // Saved by UpdateThreadLocal() right before the array is rebuilt, since
+  // rebuilding reclaims all garbage and clears the counters
+  GCStats last_gc_stats;
+  
+ protected:
+  // This serializes background GC against changes to the thread local
+  // array, i.e. UpdateThreadLocal() and the destructor
+  std::mutex gc_lock;
+  
  public:
    
   /*
@@ -552,7 +740,8 @@ class BwTreeBase {
     
     // Manually call destructor
     for(size_t i = 0;i < thread_num;i++) {
-      assert((gc_metadata_p + i)->data.header.next_p == nullptr);
+      assert((gc_metadata_p + i)->data.first_p == nullptr);
+      assert((gc_metadata_p + i)->data.open_p == nullptr);
       
       (gc_metadata_p + i)->~PaddedGCMetadata();
     }
@@ -616,7 +805,16 @@ class BwTreeBase {
     gc_metadata_p{nullptr},
     original_p{nullptr},
     thread_num{total_thread_num.load()},
-    epoch{0UL} {
+    epoch{0UL},
+    background_gc{false},
+    handoff_p{nullptr},
+    pending_p{nullptr},
+    background_reclaimed_bytes{0UL},
+    background_reclaimed_nodes{0UL},
+    background_gc_count{0UL},
+    background_gc_ns{0UL},
+    last_gc_stats{},
+    gc_lock{} {
     
     // Allocate memory for thread local data structure
     PrepareThreadLocal();
@@ -781,6 +979,328 @@ class BwTreeBase {
     
     return min_epoch;
   }
+  
+  /*
+   * SetBackgroundGC() - Sets whether sealed garbage batches are reclaimed by
+   *                     the epoch thread rather than by worker threads
+   *
+   * This has no effect if the BwTree does not start its own GC thread, and
+   * should be called before worker threads start
+   */
+  void SetBackgroundGC(bool p_background_gc) {
+    background_gc = p_background_gc;
+    
+    return;
+  }
+  
+  inline bool IsBackgroundGC() const {
+    return background_gc;
+  }
+  
+  /*
+   * AllocateGarbageBatch() - Returns an empty batch for the current thread
+   *
+   * Batches reclaimed by the epoch thread are only taken back when the local
+   * free list runs out, so that the atomic exchange is amortized. A batch
+   * is allocated from the heap only when there is no batch to recycle
+   */
+  GarbageBatch *AllocateGarbageBatch(GCMetaData *metadata_p) {
+    if(metadata_p->free_p == nullptr) {
+      metadata_p->free_p = metadata_p->returned_p.exchange(nullptr);
+      if(metadata_p->free_p == nullptr) {
+        return new GarbageBatch{gc_id};
+      }
+    }
+    
+    GarbageBatch *batch_p = metadata_p->free_p;
+    metadata_p->free_p = batch_p->next_p;
+    
+    batch_p->byte_count = 0UL;
+    batch_p->node_count = 0UL;
+    batch_p->next_p = nullptr;
+    
+    return batch_p;
+  }
+  
+  /*
+   * RecycleGarbageBatch() - Puts a reclaimed batch back to the free list of
+   *                         its owner
+   *
+   * The owner's own free list is only accessed by the owner, so other threads
+   * push onto returned_p instead
+   */
+  void RecycleGarbageBatch(GarbageBatch *batch_p, bool is_owner) {
+    GCMetaData *metadata_p = GetGCMetaData(batch_p->owner_id);
+    
+    if(is_owner == true) {
+      batch_p->next_p = metadata_p->free_p;
+      metadata_p->free_p = batch_p;
+      
+      return;
+    }
+    
+    batch_p->next_p = metadata_p->returned_p.load();
+    while(metadata_p->returned_p.compare_exchange_weak(batch_p->next_p,
+                                                       batch_p) == false) {}
+    
+    return;
+  }
+  
+  /*
+   * SealGarbageBatch() - Stamps the open batch with the current epoch and
+   *                      moves it out of the open slot
+   *
+   * The epoch is read once per batch rather than once per node. This is
+   * conservative since every node in the batch was unlinked before now.
+   * With background GC the batch is pushed to the epoch thread; otherwise
+   * it is appended to the thread's own list, which stays sorted by epoch
+   */
+  void SealGarbageBatch(GCMetaData *metadata_p) {
+    GarbageBatch *batch_p = metadata_p->open_p;
+    assert(batch_p != nullptr);
+    
+    metadata_p->open_p = nullptr;
+    batch_p->delete_epoch = GetGlobalEpoch();
+    
+    if(background_gc == true) {
+      assert(metadata_p->node_count >= batch_p->node_count);
+      metadata_p->node_count -= batch_p->node_count;
+      
+      batch_p->next_p = handoff_p.load();
+      while(handoff_p.compare_exchange_weak(batch_p->next_p, 
+                                            batch_p) == false) {}
+      
+      return;
+    }
+    
+    if(metadata_p->last_p == nullptr) {
+      metadata_p->first_p = batch_p;
+    } else {
+      metadata_p->last_p->next_p = batch_p;
+    }
+    
+    metadata_p->last_p = batch_p;
+    
+    return;
+  }
+  
+  /*
+   * ReclaimHandoff() - Reclaims handed off batches whose epoch is older than
+   *                    all active threads
+   *
+   * The caller must hold gc_lock or otherwise be the only thread doing GC
+   */
+  template <typename FreeFunc>
+  void ReclaimHandoff(FreeFunc free_func) {
+    // Move newly handed off batches onto the pending list; the order does
+    // not matter since we always scan the whole pending list
+    GarbageBatch *batch_p = handoff_p.exchange(nullptr);
+    while(batch_p != nullptr) {
+      GarbageBatch *next_p = batch_p->next_p;
+      batch_p->next_p = pending_p;
+      pending_p = batch_p;
+      batch_p = next_p;
+    }
+    
+    if(pending_p == nullptr) {
+      return;
+    }
+    
+    auto start_time = std::chrono::steady_clock::now();
+    uint64_t min_epoch = SummarizeGCEpoch();
+    uint64_t reclaimed_bytes = 0UL;
+    uint64_t reclaimed_nodes = 0UL;
+    
+    GarbageBatch **prev_pp = &pending_p;
+    while(*prev_pp != nullptr) {
+      batch_p = *prev_pp;
+      if(batch_p->delete_epoch >= min_epoch) {
+        prev_pp = &batch_p->next_p;
+        
+        continue;
+      }
+      
+      *prev_pp = batch_p->next_p;
+      for(size_t i = 0;i < batch_p->node_count;i++) {
+        free_func(batch_p->node_list[i]);
+      }
+      
+      reclaimed_bytes += batch_p->byte_count;
+      reclaimed_nodes += batch_p->node_count;
+      RecycleGarbageBatch(batch_p, false);
+    }
+    
+    auto end_time = std::chrono::steady_clock::now();
+    
+    background_reclaimed_bytes.fetch_add(reclaimed_bytes);
+    background_reclaimed_nodes.fetch_add(reclaimed_nodes);
+    background_gc_count.fetch_add(1);
+    background_gc_ns.fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        end_time - start_time).count());
+    
+    return;
+  }
+  
+  /*
+   * PerformBackgroundGC() - Called by the epoch thread after advancing the
+   *                         epoch
+   */
+  template <typename FreeFunc>
+  void PerformBackgroundGC(FreeFunc free_func) {
+    std::lock_guard<std::mutex> guard{gc_lock};
+    
+    ReclaimHandoff(free_func);
+    
+    return;
+  }
+  
+  /*
+   * ReleaseGarbageBatches() - Frees empty batches owned by a thread
+   *
+   * This must be called under single threaded environment after all garbage
+   * has been reclaimed
+   */
+  void ReleaseGarbageBatches(int thread_id) {
+    GCMetaData *metadata_p = GetGCMetaData(thread_id);
+    
+    GarbageBatch *batch_p = metadata_p->free_p;
+    while(batch_p != nullptr) {
+      GarbageBatch *next_p = batch_p->next_p;
+      delete batch_p;
+      batch_p = next_p;
+    }
+    
+    batch_p = metadata_p->returned_p.exchange(nullptr);
+    while(batch_p != nullptr) {
+      GarbageBatch *next_p = batch_p->next_p;
+      delete batch_p;
+      batch_p = next_p;
+    }
+    
+    metadata_p->free_p = nullptr;
+    
+    return;
+  }
+  
+  /*
+   * GetGCBacklogBytes() - Returns the estimated bytes retired but not yet
+   *                       reclaimed
+   *
+   * Counters are reset when the thread local array is rebuilt
+   */
+  uint64_t GetGCBacklogBytes() {
+    uint64_t retired_bytes = 0UL;
+    uint64_t reclaimed_bytes = background_reclaimed_bytes.load();
+    
+    for(int i = 0;i < static_cast<int>(thread_num);i++) {
+      retired_bytes += GetGCMetaData(i)->retired_bytes;
+      reclaimed_bytes += GetGCMetaData(i)->reclaimed_bytes;
+    }
+    
+    // Byte counts are estimates, so do not let them wrap around
+    if(reclaimed_bytes >= retired_bytes) {
+      return 0UL;
+    }
+    
+    return retired_bytes - reclaimed_bytes;
+  }
+  
+  /*
+   * SaveGCStats() - Sums up the GC counters of the current thread local
+   *                 array into last_gc_stats
+   *
+   * This must be called under single threaded environment (apart from the
+   * epoch thread) before the array is rebuilt
+   */
+  void SaveGCStats() {
+    GCStats stats{};
+    for(size_t i = 0;i < thread_num;i++) {
+      const GCMetaData *metadata_p = GetGCMetaData(i);
+      stats.pause_count += metadata_p->gc_pause_count;
+      stats.pause_ns += metadata_p->gc_pause_ns;
+      stats.pause_max_ns = std::max(stats.pause_max_ns,
+                                    metadata_p->gc_pause_max_ns);
+    }
+    
+    stats.background_count = background_gc_count.load();
+    stats.background_ns = background_gc_ns.load();
+    stats.backlog_bytes = GetGCBacklogBytes();
+    stats.retired_nodes = GetRetiredNodes();
+    stats.reclaimed_nodes = GetReclaimedNodes();
+    
+    last_gc_stats = stats;
+    
+    return;
+  }
+  
+  /*
+   * SaveDrainedGCStats() - Records how many nodes were left to reclaim once
+   *                        all garbage of the array has been cleared
+   */
+  void SaveDrainedGCStats() {
+    last_gc_stats.drained_nodes = \
+      GetReclaimedNodes() - last_gc_stats.reclaimed_nodes;
+    
+    return;
+  }
+  
+  /*
+   * GetRetiredNodes() - Returns the number of garbage nodes retired by all
+   *                     threads of the current thread local array
+   */
+  uint64_t GetRetiredNodes() {
+    uint64_t retired_nodes = 0UL;
+    for(size_t i = 0;i < thread_num;i++) {
+      retired_nodes += GetGCMetaData(i)->retired_nodes;
+    }
+    
+    return retired_nodes;
+  }
+  
+  /*
+   * GetReclaimedNodes() - Returns the number of garbage nodes reclaimed by
+   *                       worker threads and the epoch thread since the
+   *                       current thread local array was built
+   */
+  uint64_t GetReclaimedNodes() {
+    uint64_t reclaimed_nodes = background_reclaimed_nodes.load();
+    for(size_t i = 0;i < thread_num;i++) {
+      reclaimed_nodes += GetGCMetaData(i)->reclaimed_nodes;
+    }
+    
+    return reclaimed_nodes;
+  }
+  
+  /*
+   * ResetBackgroundGCStats() - Clears the counters of the epoch thread, which
+   *                            are relative to the thread local array
+   */
+  void ResetBackgroundGCStats() {
+    background_reclaimed_bytes.store(0UL);
+    background_reclaimed_nodes.store(0UL);
+    background_gc_count.store(0UL);
+    background_gc_ns.store(0UL);
+    
+    return;
+  }
+  
+  /*
+   * GetLastGCStats() - Returns the GC counters saved when the thread local
+   *                    array was last rebuilt, i.e. those of the last phase
+   */
+  const GCStats &GetLastGCStats() const {
+    return last_gc_stats;
+  }
+  
+  /*
+   * GetBackgroundReclaimedNodes() - Returns the number of garbage nodes
+   *                                 reclaimed by the epoch thread since the
+   *                                 thread local array was built
+   */
+  uint64_t GetBackgroundReclaimedNodes() {
+    return background_reclaimed_nodes.load();
+  }
 };
 
 /*
@@ -832,7 +1352,8 @@ template <typename KeyType,
           typename KeyEqualityChecker = std::equal_to<KeyType>,
           typename KeyHashFunc = std::hash<KeyType>,
           typename ValueEqualityChecker = std::equal_to<ValueType>,
-          typename ValueHashFunc = std::hash<ValueType>>
+          typename ValueHashFunc = std::hash<ValueType>,
+          typename NodeSizing = BwTreeNodeSizing<>>
 class BwTree : public BwTreeBase {
  /*
   * Private & Public declaration
@@ -846,6 +1367,20 @@ class BwTree : public BwTreeBase {
   class EpochManager;
 
  public:
+  // Node sizing of this instantiation; these shadow the file scope defaults
+  static constexpr int INNER_NODE_SIZE_UPPER_THRESHOLD = \
+    NodeSizing::INNER_NODE_SIZE_UPPER_THRESHOLD;
+  static constexpr int INNER_NODE_SIZE_LOWER_THRESHOLD = \
+    NodeSizing::INNER_NODE_SIZE_LOWER_THRESHOLD;
+  static constexpr int LEAF_NODE_SIZE_UPPER_THRESHOLD = \
+    NodeSizing::LEAF_NODE_SIZE_UPPER_THRESHOLD;
+  static constexpr int LEAF_NODE_SIZE_LOWER_THRESHOLD = \
+    NodeSizing::LEAF_NODE_SIZE_LOWER_THRESHOLD;
+  static constexpr int INNER_DELTA_CHAIN_LENGTH_THRESHOLD = \
+    NodeSizing::INNER_DELTA_CHAIN_LENGTH_THRESHOLD;
+  static constexpr int LEAF_DELTA_CHAIN_LENGTH_THRESHOLD = \
+    NodeSizing::LEAF_DELTA_CHAIN_LENGTH_THRESHOLD;
+
   class BaseNode;
   class NodeSnapshot;
 
@@ -2648,11 +3183,11 @@ class BwTree : public BwTreeBase {
   // Otherwise preallocate 0 bytes
 #ifdef BWTREE_PREALLOCATION
   // This is the base type of inner nodes
-  using InnerBaseType = ElasticNode<INNER_DELTA_CHAIN_LENGTH_THRESHOLD *
+  using InnerBaseType = ElasticNode<NodeSizing::INNER_PREALLOCATION_DELTAS *
                                       sizeof(InnerDeltaNodeUnion),
                                     NodeID *>;
   // This is the base type of leaf nodes
-  using LeafBaseType = ElasticNode<LEAF_DELTA_CHAIN_LENGTH_THRESHOLD * 
+  using LeafBaseType = ElasticNode<NodeSizing::LEAF_PREALLOCATION_DELTAS * 
                                      sizeof(LeafDeltaNodeUnion),
                                    char[0]>;
 #else
@@ -2668,9 +3203,9 @@ class BwTree : public BwTreeBase {
 
 #ifdef BWTREE_PREALLOCATION
   static const size_t INNER_PREALLOCATION_SIZE = \
-    INNER_DELTA_CHAIN_LENGTH_THRESHOLD * sizeof(InnerDeltaNodeUnion);
+    NodeSizing::INNER_PREALLOCATION_DELTAS * sizeof(InnerDeltaNodeUnion);
   static const size_t LEAF_PREALLOCATION_SIZE = \
-    LEAF_DELTA_CHAIN_LENGTH_THRESHOLD * sizeof(LeafDeltaNodeUnion);
+    NodeSizing::LEAF_PREALLOCATION_DELTAS * sizeof(LeafDeltaNodeUnion);
 #else
   static const size_t INNER_PREALLOCATION_SIZE = 0UL;
   static const size_t LEAF_PREALLOCATION_SIZE = 0UL;
@@ -3416,6 +3951,10 @@ class BwTree : public BwTreeBase {
     bwt_printf("Destructor: Free tree nodes\n");
 
 #ifndef BWTREE_DO_NOT_DESTRUCT
+    // The epoch thread may still be reclaiming handed off garbage, so it
+    // must be stopped before we free them here
+    epoch_manager.StopThread();
+    
     // Clear all garbage nodes awaiting cleaning
     // First of all it should set all last active epoch counter to -1
     ClearThreadLocalGarbage();
@@ -3426,6 +3965,9 @@ class BwTree : public BwTreeBase {
     bwt_printf("Freed %lu tree nodes\n", node_count);
 #endif
     munmap(mapping_table, 1024 * 1024 * 1024);
+#ifdef BWTREE_ADAPTIVE_CONSOLIDATION
+    munmap(node_stat_table, MAPPING_TABLE_SIZE * sizeof(NodeStat));
+#endif
     return;
   }
   
@@ -3442,6 +3984,12 @@ class BwTree : public BwTreeBase {
     }
     
     for(size_t i = 0;i < GetThreadNum();i++) {
+      // Partially filled batches are sealed such that they are collected
+      // either below or together with handed off batches
+      if(GetGCMetaData(i)->open_p != nullptr) {
+        SealGarbageBatch(GetGCMetaData(i));
+      }
+      
       // Here all epoch counters have been set to 0xFFFFFFFFFFFFFFFF
       // so GC should always succeed
       PerformGC(i);
@@ -3451,6 +3999,15 @@ class BwTree : public BwTreeBase {
       assert(GetGCMetaData(i)->node_count == 0);
     }
     
+    // Batches handed off but not yet reclaimed by the epoch thread
+    ReclaimHandoff([this](void *node_p) {
+      epoch_manager.FreeEpochDeltaChain((const BaseNode *)node_p);
+    });
+    
+    for(size_t i = 0;i < GetThreadNum();i++) {
+      ReleaseGarbageBatches(i);
+    }
+    
     return;
   }
   
@@ -3466,8 +4023,16 @@ class BwTree : public BwTreeBase {
     bwt_printf("Updating thread-local array to length %lu......\n", 
                p_thread_num);
     
+    // The epoch thread must not scan the thread local array while it is
+    // being rebuilt
+    std::lock_guard<std::mutex> guard{gc_lock};
+    
+    // 0. Keeps the GC counters of the array, which are lost below
+    SaveGCStats();
+    
     // 1. Frees all pending memory chunks
     ClearThreadLocalGarbage(); 
+    SaveDrainedGCStats();
     // 2. Frees the thread local array
     DestroyThreadLocal();
     
@@ -3477,6 +4042,9 @@ class BwTree : public BwTreeBase {
     // Here all epoches are restored to 0
     PrepareThreadLocal();
     
+    // The epoch thread counters are relative to the new array as well
+    ResetBackgroundGCStats();
+    
     return;
   }
 
@@ -3856,6 +4424,183 @@ class BwTree : public BwTreeBase {
     return ret;
   }
 
+  /*
+   * BulkLoad() - Builds the tree bottom-up from key value pairs sorted by key
+   *
+   * Leaves and inner nodes are built as consolidated base nodes filled to
+   * fill_factor of the split threshold (evenly spread over each level) and
+   * installed directly into the mapping table, replacing the initial root
+   * and leaf. Leaves are built in parallel with thread_num threads. Equal
+   * keys are never split across leaves.
+   *
+   * The tree must be empty and must not be used by any other thread. If it
+   * is not empty, or the mapping table could not hold all nodes, this
+   * function returns false without modifying the tree
+   */
+  template <typename Iterator>
+  bool BulkLoad(Iterator begin,
+                Iterator end,
+                double fill_factor,
+                int thread_num = 1) {
+    const BaseNode *old_root_p = GetNode(root_id.load());
+    const BaseNode *old_leaf_p = GetNode(first_leaf_id);
+    if((old_root_p->GetType() != NodeType::InnerType) ||
+       (old_root_p->GetItemCount() != 1) ||
+       (old_leaf_p->GetType() != NodeType::LeafType) ||
+       (old_leaf_p->GetItemCount() != 0)) {
+      return false;
+    }
+
+    size_t item_count = static_cast<size_t>(end - begin);
+    if(item_count == 0) {
+      return true;
+    }
+
+    // Stay strictly between merge and split thresholds
+    int leaf_capacity = \
+      static_cast<int>(LEAF_NODE_SIZE_UPPER_THRESHOLD * fill_factor);
+    leaf_capacity = std::max(leaf_capacity,
+                             LEAF_NODE_SIZE_LOWER_THRESHOLD + 1);
+    leaf_capacity = std::min(leaf_capacity,
+                             LEAF_NODE_SIZE_UPPER_THRESHOLD - 1);
+    int inner_capacity = \
+      static_cast<int>(INNER_NODE_SIZE_UPPER_THRESHOLD * fill_factor);
+    inner_capacity = std::max(inner_capacity,
+                              INNER_NODE_SIZE_LOWER_THRESHOLD + 1);
+    inner_capacity = std::min(inner_capacity,
+                              INNER_NODE_SIZE_UPPER_THRESHOLD - 1);
+
+    // Leaf i covers [leaf_bounds[i], leaf_bounds[i + 1]); a boundary that
+    // would split a run of equal keys is moved past the run
+    size_t leaf_count = (item_count + leaf_capacity - 1) / leaf_capacity;
+    std::vector<size_t> leaf_bounds{0UL};
+    for(size_t i = 1;i < leaf_count;i++) {
+      size_t bound = std::max(item_count * i / leaf_count, leaf_bounds.back());
+      while((bound < item_count) &&
+            (bound > leaf_bounds.back()) &&
+            KeyCmpEqual(begin[bound].first, begin[bound - 1].first)) {
+        bound++;
+      }
+
+      if((bound > leaf_bounds.back()) && (bound < item_count)) {
+        leaf_bounds.push_back(bound);
+      }
+    }
+
+    leaf_bounds.push_back(item_count);
+    leaf_count = leaf_bounds.size() - 1;
+
+    // Count nodes on every level before taking any NodeID
+    size_t node_count = leaf_count;
+    for(size_t level_count = leaf_count;level_count > 1;) {
+      level_count = (level_count + inner_capacity - 1) / inner_capacity;
+      node_count += level_count;
+    }
+
+    if(next_unused_node_id.load() + node_count >= MAPPING_TABLE_SIZE) {
+      return false;
+    }
+
+    // Release the initial layout; the old root would otherwise free the
+    // first leaf ID, which the first new leaf reuses
+    mapping_table[first_leaf_id] = nullptr;
+    mapping_table[root_id.load()] = nullptr;
+    FreeNodeByPointer(old_root_p);
+    FreeNodeByPointer(old_leaf_p);
+
+    // The first leaf keeps FIRST_LEAF_NODE_ID since iterators start there
+    NodeID leaf_id_base = next_unused_node_id.fetch_add(leaf_count - 1);
+    auto get_leaf_id = [this, leaf_id_base](size_t i) {
+      return i == 0 ? first_leaf_id : (leaf_id_base + i - 1);
+    };
+
+    auto build_leaves = [this, begin, &leaf_bounds, &get_leaf_id, leaf_count] \
+                        (size_t start, size_t stop) {
+      for(size_t i = start;i < stop;i++) {
+        size_t lo = leaf_bounds[i];
+        size_t hi = leaf_bounds[i + 1];
+
+        KeyNodeIDPair low_key = \
+          (i == 0) ? std::make_pair(KeyType{}, INVALID_NODE_ID) : \
+                     std::make_pair(begin[lo].first, ~INVALID_NODE_ID);
+        KeyNodeIDPair high_key = \
+          (i + 1 == leaf_count) ? \
+            std::make_pair(KeyType{}, INVALID_NODE_ID) : \
+            std::make_pair(begin[hi].first, get_leaf_id(i + 1));
+
+        LeafNode *leaf_node_p = \
+          LeafNode::Get(0, static_cast<int>(hi - lo), low_key, high_key);
+        for(size_t j = lo;j < hi;j++) {
+          leaf_node_p->PushBack(begin[j]);
+        }
+
+        InstallNewNode(get_leaf_id(i), leaf_node_p);
+      }
+    };
+
+    size_t builder_count = thread_num < 1 ? 1UL : static_cast<size_t>(thread_num);
+    builder_count = std::min(builder_count, leaf_count);
+    std::vector<std::thread> thread_list{};
+    for(size_t i = 0;i < builder_count;i++) {
+      thread_list.emplace_back(build_leaves,
+                               leaf_count * i / builder_count,
+                               leaf_count * (i + 1) / builder_count);
+    }
+
+    for(std::thread &t : thread_list) {
+      t.join();
+    }
+
+    // Separators of the level below; the first one is the -Inf low key
+    std::vector<KeyNodeIDPair> child_list{};
+    child_list.reserve(leaf_count);
+    for(size_t i = 0;i < leaf_count;i++) {
+      child_list.push_back(
+        std::make_pair(i == 0 ? KeyType{} : begin[leaf_bounds[i]].first,
+                       get_leaf_id(i)));
+    }
+
+    // Build inner levels until one node is left, which becomes the root
+    // under the old root NodeID. There is always at least one inner level
+    while(1) {
+      size_t child_count = child_list.size();
+      size_t inner_count = (child_count + inner_capacity - 1) / inner_capacity;
+      NodeID inner_id_base = \
+        inner_count == 1 ? root_id.load() : \
+                           next_unused_node_id.fetch_add(inner_count);
+
+      std::vector<KeyNodeIDPair> parent_list{};
+      parent_list.reserve(inner_count);
+      for(size_t i = 0;i < inner_count;i++) {
+        size_t lo = child_count * i / inner_count;
+        size_t hi = child_count * (i + 1) / inner_count;
+
+        KeyNodeIDPair high_key = \
+          (i + 1 == inner_count) ? \
+            std::make_pair(KeyType{}, INVALID_NODE_ID) : \
+            std::make_pair(child_list[hi].first, inner_id_base + i + 1);
+
+        InnerNode *inner_node_p = \
+          InnerNode::Get(0, static_cast<int>(hi - lo), child_list[lo], high_key);
+        for(size_t j = lo;j < hi;j++) {
+          inner_node_p->WriteItem(static_cast<int>(j - lo), child_list[j]);
+        }
+
+        InstallNewNode(inner_id_base + i, inner_node_p);
+        parent_list.push_back(
+          std::make_pair(child_list[lo].first, inner_id_base + i));
+      }
+
+      if(inner_count == 1) {
+        break;
+      }
+
+      child_list.swap(parent_list);
+    }
+
+    return true;
+  }
+
   /*
    * InitNodeLayout() - Initialize the nodes required to start BwTree
    *
@@ -3962,6 +4707,15 @@ class BwTree : public BwTreeBase {
                         MAP_ANONYMOUS | MAP_PRIVATE,
                         -1, 0);
 
+#ifdef BWTREE_ADAPTIVE_CONSOLIDATION
+    // Anonymous pages are zero, which is the initial state of NodeStat
+    node_stat_table = (NodeStat *) \
+                      mmap(NULL, MAPPING_TABLE_SIZE * sizeof(NodeStat),
+                           PROT_READ | PROT_WRITE,
+                           MAP_ANONYMOUS | MAP_PRIVATE,
+                           -1, 0);
+#endif
+
     return;
   }
 
@@ -4008,7 +4762,12 @@ class BwTree : public BwTreeBase {
     debug_stop_mutex.unlock();
     #endif
 
-    return mapping_table[node_id].compare_exchange_strong(prev_p, node_p);
+    bool ret = mapping_table[node_id].compare_exchange_strong(prev_p, node_p);
+    if(ret == false) {
+      INC_COUNTER(CAS_FAILURE, 1);
+    }
+    
+    return ret;
   }
 
   /*
@@ -4120,6 +4879,7 @@ retry_traverse:
     bwt_printf("Successfully loading root node ID\n");
 
     while(1) {
+      INC_COUNTER(TRAVERSE_STEP, 1);
       NodeID child_node_id = NavigateInnerNode(context_p);
 
       // Navigate could abort since it might go to another NodeID
@@ -4153,6 +4913,7 @@ retry_traverse:
 
       if(snapshot_p->IsLeafLevel() == true) {
         bwt_printf("The next node is a leaf\n");
+        INC_COUNTER(TRAVERSE, 1);
 
         break;
       }
@@ -5397,8 +6158,163 @@ abort_traverse:
     return;
   }
 
+#ifdef BWTREE_UNIQUE_KEY
   /*
-   * NavigateLeafNode() - Check existence for a certain value
+   * NavigateLeafNode() - Find the single value of the search key on a
+   *                      logical leaf node
+   *
+   * This is the unique key counterpart of the value list version above. Since
+   * there is at most one value per key the first insert or update delta
+   * matching the search key decides the result, and a matching delete delta
+   * means the key is not present. No value set is built and nothing is
+   * allocated
+   *
+   * On return value_p points to the value inside the delta or base node, or
+   * is nullptr if the key does not exist. The pointer is only valid while
+   * the caller stays in the epoch
+   */
+  void NavigateLeafNode(Context *context_p, const ValueType *&value_p) {
+    value_p = nullptr;
+
+    NavigateSiblingChain(context_p);
+
+    if(context_p->abort_flag == true) {
+      return;
+    }
+
+    NodeSnapshot *snapshot_p = GetLatestNodeSnapshot(context_p);
+    const BaseNode *node_p = snapshot_p->node_p;
+
+    assert(snapshot_p->IsLeafLevel() == true);
+
+    const KeyType &search_key = context_p->search_key;
+
+    int start_index = 0;
+    int end_index = -1;
+
+    while(1) {
+      switch(node_p->GetType()) {
+        case NodeType::LeafType: {
+          const LeafNode *leaf_node_p = \
+            static_cast<const LeafNode *>(node_p);
+
+          auto start_it = leaf_node_p->Begin() + start_index;
+          auto end_it = ((end_index == -1) ? \
+                         leaf_node_p->End() : \
+                         leaf_node_p->Begin() + end_index);
+
+          auto it = std::lower_bound(start_it,
+                                     end_it,
+                                     std::make_pair(search_key, ValueType{}),
+                                     key_value_pair_cmp_obj);
+
+          if((it != leaf_node_p->End()) && \
+             (KeyCmpEqual(search_key, it->first))) {
+            value_p = &it->second;
+          }
+
+          return;
+        }
+        case NodeType::LeafInsertType: {
+          const LeafInsertNode *insert_node_p = \
+            static_cast<const LeafInsertNode *>(node_p);
+
+          if(KeyCmpEqual(search_key, insert_node_p->item.first)) {
+            value_p = &insert_node_p->item.second;
+
+            return;
+          } else if(KeyCmpGreater(search_key, insert_node_p->item.first)) {
+#ifdef BWTREE_SEARCH_SHORTCUT
+            start_index = insert_node_p->GetIndexPair().first;
+#endif
+          } else {
+#ifdef BWTREE_SEARCH_SHORTCUT
+            end_index = insert_node_p->GetIndexPair().first;
+#endif
+          }
+
+          node_p = insert_node_p->child_node_p;
+
+          break;
+        } // case LeafInsertType
+        case NodeType::LeafDeleteType: {
+          const LeafDeleteNode *delete_node_p = \
+            static_cast<const LeafDeleteNode *>(node_p);
+
+          if(KeyCmpEqual(search_key, delete_node_p->item.first)) {
+            return;
+          } else if(KeyCmpGreater(search_key, delete_node_p->item.first)) {
+#ifdef BWTREE_SEARCH_SHORTCUT
+            start_index = delete_node_p->GetIndexPair().first;
+#endif
+          } else {
+#ifdef BWTREE_SEARCH_SHORTCUT
+            end_index = delete_node_p->GetIndexPair().first;
+#endif
+          }
+
+          node_p = delete_node_p->child_node_p;
+
+          break;
+        } // case LeafDeleteType
+        case NodeType::LeafUpdateType: {
+          const LeafUpdateNode *update_node_p = \
+            static_cast<const LeafUpdateNode *>(node_p);
+
+          if(KeyCmpEqual(search_key, update_node_p->item.first)) {
+            value_p = &update_node_p->item.second;
+
+            return;
+          } else if(KeyCmpGreater(search_key, update_node_p->item.first)) {
+#ifdef BWTREE_SEARCH_SHORTCUT
+            start_index = update_node_p->GetIndexPair().first;
+#endif
+          } else {
+#ifdef BWTREE_SEARCH_SHORTCUT
+            end_index = update_node_p->GetIndexPair().first;
+#endif
+          }
+
+          node_p = update_node_p->child_node_p;
+
+          break;
+        } // case LeafUpdateType
+        case NodeType::LeafMergeType: {
+          const LeafMergeNode *merge_node_p = \
+            static_cast<const LeafMergeNode *>(node_p);
+
+          if(KeyCmpGreaterEqual(search_key, merge_node_p->delete_item.first)) {
+            node_p = merge_node_p->right_merge_p;
+          } else {
+            node_p = merge_node_p->child_node_p;
+          }
+
+          start_index = 0;
+          end_index = -1;
+
+          break;
+        } // case LeafMergeType
+        case NodeType::LeafSplitType: {
+          node_p = static_cast<const LeafSplitNode *>(node_p)->child_node_p;
+
+          break;
+        } // case LeafSplitType
+        default: {
+          bwt_printf("ERROR: Unknown leaf delta node type: %d\n",
+                     static_cast<int>(node_p->GetType()));
+
+          assert(false);
+        } // default
+      } // switch
+    } // while
+
+    assert(false);
+    return;
+  }
+#endif
+
+  /*
+   * NavigateLeafNode() - Check existence for a certain value
    *
    * Please note that this function is overloaded. This version is used for
    * insert/delete/update that only checks existence of values, rather than
@@ -6764,9 +7680,12 @@ abort_traverse:
   
   /*
    * TraverseReadOptimized() - Traverse the tree without handling any SMO
+   *
+   * The leaf level is handled by the NavigateLeafNode() overload that matches
+   * the output type, i.e. either a value list or a single value pointer
    */
-  void TraverseReadOptimized(Context *context_p,
-                             std::vector<ValueType> *value_list_p) {
+  template <typename OutputType>
+  void TraverseReadOptimized(Context *context_p, OutputType *output_p) {
 retry_traverse:
     assert(context_p->abort_flag == false);
     assert(context_p->current_level == -1);
@@ -6785,6 +7704,7 @@ retry_traverse:
     bwt_printf("Successfully loading root node ID (RO)\n");
 
     while(1) {
+      INC_COUNTER(TRAVERSE_STEP, 1);
       child_node_id = NavigateInnerNode(context_p);
 
       // Navigate could abort since it might go to another NodeID
@@ -6820,8 +7740,9 @@ retry_traverse:
 
       if(snapshot_p->IsLeafLevel() == true) {
         bwt_printf("The next node is a leaf (RO)\n");
+        INC_COUNTER(TRAVERSE, 1);
 
-        NavigateLeafNode(context_p, *value_list_p);
+        NavigateLeafNode(context_p, *output_p);
 
         if(context_p->abort_flag == true) {
           bwt_printf("NavigateLeafNode aborts (RO). ABORT\n");
@@ -6829,6 +7750,9 @@ retry_traverse:
           goto abort_traverse;
         }
 
+        // NavigateLeafNode() may have moved right along the sibling chain
+        SampleLeafAccess(GetLatestNodeSnapshot(context_p)->node_id, false);
+
         #ifdef BWTREE_DEBUG
         
         bwt_printf("Found leaf node (RO). Abort count = %d, level = %d\n",
@@ -7449,6 +8373,182 @@ before_switch:
     return;
   }
   
+#ifdef BWTREE_ADAPTIVE_CONSOLIDATION
+  /*
+   * class NodeStat - Access and contention statistics of a leaf NodeID
+   *
+   * reads, writes and conflicts only cover the current window and are reset
+   * whenever the threshold is revised. Reads and writes are sampled (see
+   * NODE_STAT_SAMPLE_RATE) while conflicts (failed delta or consolidation
+   * CAS) are always counted since they are rare and already expensive
+   *
+   * All counters are updated with relaxed atomics; they are hints, and a
+   * lost update only delays adaptation
+   */
+  class NodeStat {
+   public:
+    std::atomic<uint32_t> samples;
+    std::atomic<uint32_t> writes;
+    std::atomic<uint32_t> conflicts;
+
+    // Current consolidation threshold; 0 means it has not been revised yet
+    // and LEAF_DELTA_CHAIN_LENGTH_THRESHOLD applies
+    std::atomic<int32_t> threshold;
+
+    // Totals since the NodeID was first used
+    std::atomic<uint32_t> abort_total;
+    std::atomic<uint32_t> consolidate_total;
+    std::atomic<uint32_t> consolidate_fail_total;
+  };
+
+  /*
+   * GetNodeStat() - Returns the statistics of a NodeID
+   */
+  inline const NodeStat *GetNodeStat(NodeID node_id) const {
+    return &node_stat_table[node_id];
+  }
+
+  /*
+   * GetNodeIDBound() - Returns an upper bound of all NodeIDs in use
+   */
+  inline NodeID GetNodeIDBound() const {
+    return next_unused_node_id.load();
+  }
+#endif
+
+  /*
+   * GetLeafConsolidateThreshold() - Returns the delta chain length at which
+   *                                 the given leaf is consolidated
+   */
+  inline int GetLeafConsolidateThreshold(NodeID node_id) const {
+#ifdef BWTREE_ADAPTIVE_CONSOLIDATION
+    int threshold = \
+      node_stat_table[node_id].threshold.load(std::memory_order_relaxed);
+    if(threshold != 0) {
+      return threshold;
+    }
+#else
+    (void)node_id;
+#endif
+
+    return LEAF_DELTA_CHAIN_LENGTH_THRESHOLD;
+  }
+
+  /*
+   * SampleLeafAccess() - Count a read or a successful write on a leaf
+   *
+   * Only one in NODE_STAT_SAMPLE_RATE calls of a thread reaches the node's
+   * counters, so hot leaves do not turn into a shared cache line hot spot.
+   * The thread that completes a window revises the threshold
+   */
+  inline void SampleLeafAccess(NodeID node_id, bool is_write) {
+#ifdef BWTREE_ADAPTIVE_CONSOLIDATION
+    uint32_t tick = ++GetCurrentGCMetaData()->node_stat_tick;
+    if((tick % NODE_STAT_SAMPLE_RATE) != 0) {
+      return;
+    }
+
+    NodeStat *stat_p = &node_stat_table[node_id];
+
+    if(is_write == true) {
+      stat_p->writes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint32_t samples = \
+      stat_p->samples.fetch_add(1, std::memory_order_relaxed) + 1;
+    if(samples == NODE_STAT_WINDOW) {
+      ReviseLeafThreshold(stat_p);
+    }
+#else
+    (void)node_id;
+    (void)is_write;
+#endif
+
+    return;
+  }
+
+  /*
+   * RecordLeafConflict() - Count a failed delta CAS on a leaf
+   */
+  inline void RecordLeafConflict(NodeID node_id) {
+#ifdef BWTREE_ADAPTIVE_CONSOLIDATION
+    NodeStat *stat_p = &node_stat_table[node_id];
+
+    stat_p->conflicts.fetch_add(1, std::memory_order_relaxed);
+    stat_p->abort_total.fetch_add(1, std::memory_order_relaxed);
+#else
+    (void)node_id;
+#endif
+
+    return;
+  }
+
+  /*
+   * RecordLeafConsolidation() - Count a leaf consolidation attempt
+   *
+   * A failed consolidation CAS also counts as a conflict since the copy of
+   * the whole leaf was wasted
+   */
+  inline void RecordLeafConsolidation(NodeID node_id, bool success) {
+#ifdef BWTREE_ADAPTIVE_CONSOLIDATION
+    NodeStat *stat_p = &node_stat_table[node_id];
+
+    if(success == true) {
+      stat_p->consolidate_total.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      stat_p->conflicts.fetch_add(1, std::memory_order_relaxed);
+      stat_p->consolidate_fail_total.fetch_add(1, std::memory_order_relaxed);
+    }
+#else
+    (void)node_id;
+    (void)success;
+#endif
+
+    return;
+  }
+
+#ifdef BWTREE_ADAPTIVE_CONSOLIDATION
+  /*
+   * ReviseLeafThreshold() - Adjust the consolidation threshold of a leaf
+   *                         using the window that has just completed
+   *
+   * (1) If CAS failures are frequent compared with writes the leaf is hot
+   *     and contended, and consolidations there are mostly wasted work, so
+   *     the threshold is doubled to consolidate less often
+   * (2) Otherwise if the leaf is read mostly then long chains only slow
+   *     down readers (which never consolidate), so the threshold is halved
+   * (3) Otherwise it moves halfway back to the default
+   */
+  void ReviseLeafThreshold(NodeStat *stat_p) {
+    uint32_t writes = stat_p->writes.exchange(0, std::memory_order_relaxed);
+    uint32_t conflicts = \
+      stat_p->conflicts.exchange(0, std::memory_order_relaxed);
+    stat_p->samples.store(0, std::memory_order_relaxed);
+
+    uint32_t reads = NODE_STAT_WINDOW - std::min(writes, NODE_STAT_WINDOW);
+
+    int threshold = stat_p->threshold.load(std::memory_order_relaxed);
+    if(threshold == 0) {
+      threshold = LEAF_DELTA_CHAIN_LENGTH_THRESHOLD;
+    }
+
+    // Writes are sampled and conflicts are not; more than one conflict per
+    // eight writes is considered contended
+    if((conflicts > 0) && \
+       (conflicts * 8 >= writes * NODE_STAT_SAMPLE_RATE)) {
+      threshold = std::min(threshold * 2, LEAF_DELTA_CHAIN_LENGTH_MAX);
+    } else if(reads >= writes * 4) {
+      threshold = std::max(threshold / 2, LEAF_DELTA_CHAIN_LENGTH_MIN);
+    } else {
+      threshold += (LEAF_DELTA_CHAIN_LENGTH_THRESHOLD - threshold) / 2;
+    }
+
+    stat_p->threshold.store(threshold, std::memory_order_relaxed);
+
+    return;
+  }
+#endif
+
   /*
    * ConsolidateLeafNode() - Consolidates a leaf delta chian unconditionally
    *
@@ -7463,6 +8563,8 @@ before_switch:
                                     leaf_node_p,
                                     snapshot_p->node_p);
 
+    RecordLeafConsolidation(snapshot_p->node_id, ret);
+
     if(ret == true) {
       epoch_manager.AddGarbageNode(snapshot_p->node_p);
 
@@ -7562,7 +8664,7 @@ before_switch:
     int depth = node_p->GetDepth();
 
     if(snapshot_p->IsLeafLevel() == true) {
-      if(depth < LEAF_DELTA_CHAIN_LENGTH_THRESHOLD) {
+      if(depth < GetLeafConsolidateThreshold(snapshot_p->node_id)) {
         return;
       }
     } else {
@@ -8560,6 +9662,8 @@ before_switch:
       if(ret == true) {
         bwt_printf("Leaf Insert delta CAS succeed\n");
 
+        SampleLeafAccess(node_id, true);
+
         // If install is a success then just break from the loop
         // and return
         break;
@@ -8567,6 +9671,7 @@ before_switch:
         bwt_printf("Leaf insert delta CAS failed\n");
 
         INC_COUNTER(MODIFY_ABORT, 1);
+        RecordLeafConflict(node_id);
         insert_node_p->~LeafInsertNode();
       }
 
@@ -8698,10 +9803,13 @@ before_switch:
                                         update_node_p,
                                         node_p);
         if(ret == true) {
+          SampleLeafAccess(node_id, true);
+
           break;
         } else {
           update_node_p->~LeafUpdateNode();
           INC_COUNTER(MODIFY_ABORT, 1);
+          RecordLeafConflict(node_id);
         }
       } else {
         new_key = true; 
@@ -8718,10 +9826,13 @@ before_switch:
                                         insert_node_p,
                                         node_p);
         if(ret == true) {
+          SampleLeafAccess(node_id, true);
+
           break;
         } else {
           insert_node_p->~LeafInsertNode();
           INC_COUNTER(MODIFY_ABORT, 1);
+          RecordLeafConflict(node_id);
         }
       }
     }
@@ -8897,6 +10008,8 @@ before_switch:
       if(ret == true) {
         bwt_printf("Leaf Delete delta CAS succeed\n");
 
+        SampleLeafAccess(node_id, true);
+
         // If install is a success then just break from the loop
         // and return
         break;
@@ -8905,6 +10018,7 @@ before_switch:
         
         delete_node_p->~LeafDeleteNode();
         INC_COUNTER(MODIFY_ABORT, 1);
+        RecordLeafConflict(node_id);
       }
 
       // We reach here only because CAS failed
@@ -8941,6 +10055,37 @@ before_switch:
     return;
   }
 
+#ifdef BWTREE_UNIQUE_KEY
+  /*
+   * GetSingleValue() - Copy the value of a unique key into value
+   *
+   * This does not build a value list and therefore does not allocate. The
+   * return value indicates whether the key exists; value is left untouched
+   * if it does not
+   */
+  bool GetSingleValue(const KeyType &search_key, ValueType &value) {
+    bwt_printf("GetSingleValue()\n");
+
+    INC_COUNTER(READ, 1);
+
+    EpochNode *epoch_node_p = epoch_manager.JoinEpoch();
+
+    Context context{search_key};
+    const ValueType *value_p = nullptr;
+    TraverseReadOptimized(&context, &value_p);
+
+    // The value lives inside a node so copy it before leaving the epoch
+    bool found = (value_p != nullptr);
+    if(found == true) {
+      value = *value_p;
+    }
+
+    epoch_manager.LeaveEpoch(epoch_node_p);
+
+    return found;
+  }
+#endif
+
 #ifndef BWTREE_USE_MAPPING_TABLE
   /*
    * GetValueNoMappingTable() - This function gets value for a given index without
@@ -9118,6 +10263,11 @@ before_switch:
   std::array<FakeAtomic<const BaseNode *>, MAPPING_TABLE_SIZE> mapping_table;
 #endif
 
+#ifdef BWTREE_ADAPTIVE_CONSOLIDATION
+  // Per NodeID statistics, indexed the same way as the mapping table
+  NodeStat *node_stat_table;
+#endif
+
   // This list holds free NodeID which was removed by remove delta
   // We recycle NodeID in epoch manager
   AtomicStack<NodeID, MAPPING_TABLE_SIZE> free_node_id_list;
@@ -9281,27 +10431,7 @@ before_switch:
       // check this flag everytime it does cleaning since otherwise
       // the un-thread-safe function ClearEpoch() would be ran
       // by more than 1 threads
-      exited_flag.store(true);
-
-      // If thread pointer is nullptr then we know the GC thread
-      // is not started. In this case do not wait for the thread, and just
-      // call destructor
-      //
-      // NOTE: The destructor routine is not thread-safe, so if an external
-      // GC thread is being used then that thread should check for
-      // exited_flag everytime it wants to do GC
-      //
-      // If the external thread calls ThreadFunc() then it is safe
-      if(thread_p != nullptr) {
-        bwt_printf("Waiting for thread\n");
-        
-        thread_p->join();
-
-        // Free memory
-        delete thread_p;
-        
-        bwt_printf("Thread stops\n");
-      }
+      StopThread();
 
       // So that in the following function the comparison
       // would always fail, until we have cleaned all epoch nodes
@@ -9871,6 +11001,13 @@ try_join_again:
       while(exited_flag.load() == false) {
         //printf("Start new epoch cycle\n");
         PerformGarbageCollection();
+        
+        // Reclaim batches handed off by worker threads in the new epoch
+        if(tree_p->IsBackgroundGC() == true) {
+          tree_p->PerformBackgroundGC([this](void *node_p) {
+            FreeEpochDeltaChain((const BaseNode *)node_p);
+          });
+        }
 
         // Sleep for 50 ms
         std::chrono::milliseconds duration(GC_INTERVAL);
@@ -9894,6 +11031,40 @@ try_join_again:
       return;
     }
 
+    /*
+     * StopThread() - Sets exit flag and waits for the cleaner thread
+     *
+     * This is called by the destructor, and also by BwTree's destructor
+     * before it frees garbage the cleaner thread might be reclaiming. It is
+     * safe to call more than once
+     */
+    void StopThread() {
+      exited_flag.store(true);
+
+      // If thread pointer is nullptr then we know the GC thread
+      // is not started. In this case do not wait for the thread, and just
+      // call destructor
+      //
+      // NOTE: The destructor routine is not thread-safe, so if an external
+      // GC thread is being used then that thread should check for
+      // exited_flag everytime it wants to do GC
+      //
+      // If the external thread calls ThreadFunc() then it is safe
+      if(thread_p != nullptr) {
+        bwt_printf("Waiting for thread\n");
+        
+        thread_p->join();
+
+        // Free memory
+        delete thread_p;
+        thread_p = nullptr;
+        
+        bwt_printf("Thread stops\n");
+      }
+
+      return;
+    }
+
   }; // Epoch manager
 
   /*
@@ -9936,6 +11107,296 @@ try_join_again:
     return ForwardIterator{};
   }
 
+  /*
+   * Scan() - Call func on up to count key value pairs whose key is greater
+   *          than or equal to start_key, in key order
+   *
+   * Unlike the iterator this does not copy every visited leaf into an
+   * IteratorContext. A leaf without deltas is read in place, and a leaf with
+   * deltas only merges those deltas that fall inside the scanned range. func
+   * is called as func(const KeyValuePair &) while the thread is inside an
+   * epoch, so it must not keep references to the pair after returning
+   *
+   * Each leaf is read atomically w.r.t. its own delta chain; like the
+   * iterator there is no snapshot isolation across leaves. The return value
+   * is the number of pairs passed to func
+   */
+  template <typename ScanFunc>
+  size_t Scan(const KeyType &start_key, size_t count, ScanFunc &&func) {
+    size_t scanned = 0;
+
+    // Key to resume from on the next leaf; starts with the search key and
+    // then becomes the high key of the leaf just scanned
+    KeyType next_key = start_key;
+
+    while(scanned < count) {
+      EpochNode *epoch_node_p = epoch_manager.JoinEpoch();
+
+      // Same traversal as the iterator: stops on the leaf delta chain
+      // covering next_key after helping along any SMO on the way
+      Context context{next_key};
+      Traverse(&context, nullptr, nullptr);
+
+      NodeSnapshot *snapshot_p = GetLatestNodeSnapshot(&context);
+      assert(snapshot_p->node_p->IsOnLeafDeltaChain() == true);
+
+      scanned += ScanLeafNode(snapshot_p, next_key, count - scanned, func);
+
+      // The high key lives inside the node so copy it before leaving
+      // the epoch
+      const KeyNodeIDPair &high_key_pair = snapshot_p->node_p->GetHighKeyPair();
+      bool is_last_leaf = (high_key_pair.second == INVALID_NODE_ID);
+      if(is_last_leaf == false) {
+        next_key = high_key_pair.first;
+      }
+
+      epoch_manager.LeaveEpoch(epoch_node_p);
+
+      if(is_last_leaf == true) {
+        break;
+      }
+    }
+
+    return scanned;
+  }
+
+  /*
+   * Scan() - Copy up to count key value pairs whose key >= start_key into
+   *          buffer_p, which must have room for count elements
+   */
+  size_t Scan(const KeyType &start_key,
+              size_t count,
+              KeyValuePair *buffer_p) {
+    return Scan(start_key, count, [&buffer_p](const KeyValuePair &kvp) {
+      *buffer_p++ = kvp;
+    });
+  }
+
+  /*
+   * ScanLeafNode() - Call func on at most limit items of a logical leaf node
+   *                  that are >= start_key and < high key
+   *
+   * If the delta chain is empty the base node is scanned in place. Otherwise
+   * the deltas in [start_key, high key) are sorted into a small set (the
+   * same one consolidation uses, bounded by the chain depth) and merged with
+   * the base node starting from the lower bound of start_key, so items
+   * before start_key or beyond limit are never touched
+   *
+   * Chains containing a merge delta hold two base nodes and are rare enough
+   * that we just consolidate them into a temporary leaf
+   */
+  template <typename ScanFunc>
+  size_t ScanLeafNode(NodeSnapshot *snapshot_p,
+                      const KeyType &start_key,
+                      size_t limit,
+                      ScanFunc &func) {
+    const BaseNode *node_p = snapshot_p->node_p;
+    const KeyNodeIDPair &high_key_pair = node_p->GetHighKeyPair();
+    size_t scanned = 0;
+
+    // Fast path: consolidated leaf, read it in place
+    if(node_p->GetType() == NodeType::LeafType) {
+      const LeafNode *leaf_node_p = static_cast<const LeafNode *>(node_p);
+      const KeyValuePair *it = \
+        std::lower_bound(leaf_node_p->Begin(),
+                         leaf_node_p->End(),
+                         std::make_pair(start_key, ValueType{}),
+                         key_value_pair_cmp_obj);
+
+      while((it != leaf_node_p->End()) && (scanned < limit)) {
+        func(*it);
+
+        it++;
+        scanned++;
+      }
+
+      return scanned;
+    }
+
+    const int delta_change_num = node_p->GetDepth();
+    const LeafItemIdentifier *delta_set_data_p[delta_change_num * 2];
+
+#ifndef BWTREE_UNIQUE_KEY
+    LeafItemBloomFilter delta_set{delta_set_data_p,
+                                  key_value_pair_eq_obj,
+                                  key_value_pair_hash_obj};
+#else
+    LeafItemBloomFilter delta_set{delta_set_data_p,
+                                  key_eq_obj,
+                                  key_hash_obj};
+#endif
+
+    const LeafDataNode *sss_data_p[delta_change_num];
+
+    // Same ordering as in CollectAllValuesOnLeaf(): by key, then by the
+    // index on the base node
+    auto f1 = [this](const LeafDataNode *ldn1, const LeafDataNode *ldn2) {
+      if(this->key_cmp_obj(ldn1->item.first, ldn2->item.first)) {
+        return true;
+      } else if(this->key_eq_obj(ldn1->item.first, ldn2->item.first)) {
+        return ldn1->GetIndexPair().first < ldn2->GetIndexPair().first;
+      } else {
+        return false;
+      }
+    };
+
+    auto f2 = [](const LeafDataNode *, const LeafDataNode *) {
+      assert(false);
+      return false;
+    };
+
+    SortedSmallSet<const LeafDataNode *, decltype(f1), decltype(f2)> \
+      sss{sss_data_p, f1, f2};
+
+    // Only deltas inside [start_key, high key) take part in the merge. Older
+    // deltas on the same key are on the same side of the range, so skipping
+    // them does not break deduplication
+    auto in_range = [this, &start_key, &high_key_pair](const KeyType &key) {
+      return (KeyCmpGreaterEqual(key, start_key) == true) && \
+             ((high_key_pair.second == INVALID_NODE_ID) || \
+              (KeyCmpLess(key, high_key_pair.first) == true));
+    };
+
+    while(node_p->GetType() != NodeType::LeafType) {
+      switch(node_p->GetType()) {
+        case NodeType::LeafInsertType:
+        case NodeType::LeafDeleteType:
+        case NodeType::LeafUpdateType: {
+          const LeafDataNode *data_node_p = \
+            static_cast<const LeafDataNode *>(node_p);
+
+          if(in_range(data_node_p->item.first) == true) {
+#ifndef BWTREE_UNIQUE_KEY
+            if(delta_set.Exists(data_node_p->item) == false) {
+              delta_set.Insert(data_node_p->item);
+
+              sss.InsertNoDedup(data_node_p);
+            }
+
+            // An update also hides its old item from older deltas
+            if(node_p->GetType() == NodeType::LeafUpdateType) {
+              const LeafUpdateNode *update_node_p = \
+                static_cast<const LeafUpdateNode *>(node_p);
+
+              if(delta_set.Exists(update_node_p->old_item) == false) {
+                delta_set.Insert(update_node_p->old_item);
+              }
+            }
+#else
+            if(delta_set.Exists(data_node_p->item.first) == false) {
+              delta_set.Insert(data_node_p->item.first);
+
+              sss.InsertNoDedup(data_node_p);
+            }
+#endif
+          }
+
+          node_p = data_node_p->child_node_p;
+
+          break;
+        }
+        case NodeType::LeafSplitType: {
+          node_p = static_cast<const LeafSplitNode *>(node_p)->child_node_p;
+
+          break;
+        }
+        case NodeType::LeafMergeType: {
+          LeafNode *leaf_node_p = CollectAllValuesOnLeaf(snapshot_p);
+
+          const KeyValuePair *it = \
+            std::lower_bound(leaf_node_p->Begin(),
+                             leaf_node_p->End(),
+                             std::make_pair(start_key, ValueType{}),
+                             key_value_pair_cmp_obj);
+
+          while((it != leaf_node_p->End()) && (scanned < limit)) {
+            func(*it);
+
+            it++;
+            scanned++;
+          }
+
+          FreeNodeByPointer(leaf_node_p);
+
+          return scanned;
+        }
+        default: {
+          bwt_printf("ERROR: Unknown leaf delta node type: %d\n",
+                     static_cast<int>(node_p->GetType()));
+
+          assert(false);
+        }
+      } // switch
+    } // while
+
+    const LeafNode *leaf_node_p = static_cast<const LeafNode *>(node_p);
+
+    // The base node may still hold items that were split off; those are
+    // beyond the high key of the chain and must not be scanned
+    int copy_index = \
+      static_cast<int>(std::lower_bound(leaf_node_p->Begin(),
+                                        leaf_node_p->End(),
+                                        std::make_pair(start_key, ValueType{}),
+                                        key_value_pair_cmp_obj) - \
+                       leaf_node_p->Begin());
+    int copy_end_index = leaf_node_p->GetSize();
+    if(high_key_pair.second != INVALID_NODE_ID) {
+      copy_end_index = \
+        static_cast<int>(std::lower_bound(leaf_node_p->Begin(),
+                                          leaf_node_p->End(),
+                                          std::make_pair(high_key_pair.first,
+                                                         ValueType{}),
+                                          key_value_pair_cmp_obj) - \
+                         leaf_node_p->Begin());
+    }
+
+    while(scanned < limit) {
+      // Index on the base node before which the next deltas are placed
+      int delta_index = copy_end_index;
+      if(sss.IsEmpty() == false) {
+        delta_index = sss.GetFront()->GetIndexPair().first;
+      }
+
+      assert(delta_index >= copy_index);
+      assert(delta_index <= copy_end_index);
+
+      while((copy_index < delta_index) && (scanned < limit)) {
+        func(*(leaf_node_p->Begin() + copy_index));
+
+        copy_index++;
+        scanned++;
+      }
+
+      if((sss.IsEmpty() == true) || (scanned == limit)) {
+        break;
+      }
+
+      // Drain all deltas on this index; the base item at the index is
+      // skipped if any of them overwrites it
+      bool item_overwritten = false;
+      while((sss.IsEmpty() == false) && \
+            (sss.GetFront()->GetIndexPair().first == delta_index)) {
+        const LeafDataNode *data_node_p = sss.PopFront();
+
+        item_overwritten = (item_overwritten || \
+                            data_node_p->GetIndexPair().second);
+
+        if((data_node_p->GetType() != NodeType::LeafDeleteType) && \
+           (scanned < limit)) {
+          func(data_node_p->item);
+
+          scanned++;
+        }
+      }
+
+      if(item_overwritten == true) {
+        copy_index++;
+      }
+    }
+
+    return scanned;
+  }
+
   /*
    * Iterators
    */
@@ -10782,6 +12243,45 @@ try_join_again:
     }
   }; // ForwardIterator
   
+  /*
+   * GetRetiredSize() - Estimates the number of bytes freed together with
+   *                    a garbage node
+   *
+   * Garbage nodes are usually the head of a delta chain, and the whole chain
+   * is freed with it. We do not walk the chain here but estimate its size from
+   * the head node's metadata. With preallocation, delta nodes live inside the
+   * base node's chunk, so the chain is as large as the chunk
+   */
+  size_t GetRetiredSize(const BaseNode *node_p) {
+    if(node_p->IsRemoveNode() == true) {
+      return sizeof(LeafDeltaNodeUnion);
+    }
+    
+    const NodeMetaData &metadata = node_p->GetNodeMetaData();
+    
+    if(node_p->IsOnLeafDeltaChain() == true) {
+#ifdef BWTREE_PREALLOCATION
+      size_t delta_size = LEAF_PREALLOCATION_SIZE;
+#else
+      size_t delta_size = metadata.depth * sizeof(LeafDeltaNodeUnion);
+#endif
+      
+      return sizeof(LeafNode) + \
+             metadata.item_count * sizeof(KeyValuePair) + \
+             delta_size;
+    }
+    
+#ifdef BWTREE_PREALLOCATION
+    size_t delta_size = INNER_PREALLOCATION_SIZE;
+#else
+    size_t delta_size = metadata.depth * sizeof(InnerDeltaNodeUnion);
+#endif
+    
+    return sizeof(InnerNode) + \
+           metadata.item_count * sizeof(KeyNodeIDPair) + \
+           delta_size;
+  }
+  
   /*
    * AddGarbageNode() - Adds a garbage node into the thread-local GC context
    *
@@ -10790,27 +12290,44 @@ try_join_again:
    *
    * This is always called by the thread owning thread local data, so we
    * do not have to worry about thread identity issues
+   *
+   * The node is appended to the thread's open batch; the epoch is read and
+   * GC is considered only once per GC_BATCH_SIZE nodes when the batch is full
    */
   void AddGarbageNode(const BaseNode *node_p) {
     INC_COUNTER(ADD_TO_GC, 1);
-
-    GarbageNode *garbage_node_p = \
-      new GarbageNode{GetGlobalEpoch(), (void *)(node_p)};
-    assert(garbage_node_p != nullptr);
     
-    // Link this new node to the end of the linked list
-    // and then update last_p
-    GetCurrentGCMetaData()->last_p->next_p = garbage_node_p;
-    GetCurrentGCMetaData()->last_p = garbage_node_p;
+    GCMetaData *metadata_p = GetCurrentGCMetaData();
+    if(metadata_p->open_p == nullptr) {
+      metadata_p->open_p = AllocateGarbageBatch(metadata_p);
+    }
+    
+    GarbageBatch *batch_p = metadata_p->open_p;
+    size_t byte_count = GetRetiredSize(node_p);
+    
+    batch_p->node_list[batch_p->node_count++] = (void *)(node_p);
+    batch_p->byte_count += byte_count;
     
     // Update the counter 
-    GetCurrentGCMetaData()->node_count++;
+    metadata_p->retired_bytes += byte_count;
+    metadata_p->retired_nodes++;
+    metadata_p->node_count++;
+    
+    if(batch_p->node_count < GC_BATCH_SIZE) {
+      return;
+    }
+    
+    SealGarbageBatch(metadata_p);
     
     // It is possible that we could not free enough number of nodes to
     // make it less than this threshold
     // So it is important to let the epoch counter be constantly increased
     // to guarantee progress
-    if(GetCurrentGCMetaData()->node_count > GC_NODE_COUNT_THREADHOLD) {
+    if(metadata_p->node_count > GC_NODE_COUNT_THREADHOLD) {
+      // Counted here since PerformGC() is also called by the destructor,
+      // which may not own a GC ID
+      INC_COUNTER(SCAN_GC_CHAIN, 1);
+      
       // Use current thread's gc id to perform GC
       PerformGC(gc_id);
     }
@@ -10819,8 +12336,8 @@ try_join_again:
   }
   
   /*
-   * PerformGC() - This function performs GC on the current thread's garbage 
-   *               chain using the call back function
+   * PerformGC() - This function performs GC on the current thread's sealed 
+   *               batches using the call back function
    *
    * Note that this function only collects for the current thread. Therefore
    * this function does not have to be atomic since its 
@@ -10830,41 +12347,55 @@ try_join_again:
    * GetCurrentGCMetaData()
    */
   void PerformGC(int thread_id) {
-    INC_COUNTER(SCAN_GC_CHAIN, 1);
+    auto start_time = std::chrono::steady_clock::now();
 
     // First of all get the minimum epoch of all active threads
-    // This is the upper bound for deleted epoch in garbage node
+    // This is the upper bound for deleted epoch in garbage batch
     uint64_t min_epoch = SummarizeGCEpoch();
     
-    // This is the pointer we use to perform GC
-    // Note that we only fetch the metadata using the current thread-local id
-    GarbageNode *header_p = &GetGCMetaData(thread_id)->header; 
-    GarbageNode *first_p = header_p->next_p;
+    // Note that we only fetch the metadata using the given thread id
+    GCMetaData *metadata_p = GetGCMetaData(thread_id);
+    GarbageBatch *batch_p = metadata_p->first_p;
     
     // Then traverse the linked list
     // Only reclaim memory when the deleted epoch < min epoch
-    while(first_p != nullptr && \
-          first_p->delete_epoch < min_epoch) {
-      // First unlink the current node from the linked list
+    while(batch_p != nullptr && \
+          batch_p->delete_epoch < min_epoch) {
+      // First unlink the current batch from the linked list
       // This could set it to nullptr
-      header_p->next_p = first_p->next_p;
+      metadata_p->first_p = batch_p->next_p;
       
       // Then free memory
-      epoch_manager.FreeEpochDeltaChain((const BaseNode *)first_p->node_p);
+      for(size_t i = 0;i < batch_p->node_count;i++) {
+        epoch_manager.FreeEpochDeltaChain(
+          (const BaseNode *)batch_p->node_list[i]);
+      }
       
-      delete first_p;
-      assert(GetGCMetaData(thread_id)->node_count != 0UL);
-      GetGCMetaData(thread_id)->node_count--;
+      assert(metadata_p->node_count >= batch_p->node_count);
+      metadata_p->node_count -= batch_p->node_count;
+      metadata_p->reclaimed_bytes += batch_p->byte_count;
+      metadata_p->reclaimed_nodes += batch_p->node_count;
       
-      first_p = header_p->next_p;
+      RecycleGarbageBatch(batch_p, true);
+      
+      batch_p = metadata_p->first_p;
     }
     
-    // If we have freed all nodes in the linked list we should 
-    // reset last_p to the header
-    if(first_p == nullptr) {
-      GetGCMetaData(thread_id)->last_p = header_p;
+    // If we have freed all batches in the linked list we should 
+    // reset last_p
+    if(batch_p == nullptr) {
+      metadata_p->last_p = nullptr;
     }
     
+    uint64_t pause_ns = \
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_time).count();
+    
+    metadata_p->gc_pause_count++;
+    metadata_p->gc_pause_ns += pause_ns;
+    metadata_p->gc_pause_max_ns = std::max(metadata_p->gc_pause_max_ns,
+                                           pause_ns);
+    
     return;
   }
 
@@ -2,6 +2,7 @@
 #define BTREE_SLOWER_LAYOUT
 
 #include <iostream>
+#include <chrono>
 #include "indexkey.h"
 #include "ARTOLC/Tree.h"
 #ifndef BTREE_SLOWER_LAYOUT
@@ -19,6 +20,8 @@
 #include "./nohotspot-skiplist/background.h"
 #include "./nohotspot-skiplist/nohotspot_ops.h"
 
+#include "./rotate-skiplist-cpp/rotate-skiplist.h"
+
 
 #ifndef _INDEX_H
 #define _INDEX_H
@@ -26,6 +29,180 @@
 using namespace wangziqi2013;
 using namespace bwtree;
 
+/*
+ * ParallelSort() - Stable sort with thread_num threads
+ *
+ * The range is cut into thread_num runs which are sorted in parallel and
+ * then merged pairwise, also in parallel, until one run is left. Used to
+ * sort the input of bulk loads
+ */
+template <typename Iterator, typename Compare>
+void ParallelSort(Iterator begin, Iterator end, Compare cmp, int thread_num) {
+  size_t item_count = static_cast<size_t>(end - begin);
+  size_t run_count = thread_num < 1 ? 1UL : static_cast<size_t>(thread_num);
+  if(run_count > item_count) {
+    run_count = item_count == 0 ? 1UL : item_count;
+  }
+
+  // Run i covers [bounds[i], bounds[i + 1])
+  std::vector<size_t> bounds{};
+  for(size_t i = 0;i <= run_count;i++) {
+    bounds.push_back(item_count * i / run_count);
+  }
+
+  std::vector<std::thread> thread_list{};
+  for(size_t i = 0;i < run_count;i++) {
+    thread_list.emplace_back([begin, &bounds, cmp, i]() {
+      std::stable_sort(begin + bounds[i], begin + bounds[i + 1], cmp);
+    });
+  }
+
+  for(std::thread &t : thread_list) {
+    t.join();
+  }
+
+  while(bounds.size() > 2) {
+    std::vector<size_t> next_bounds{};
+    thread_list.clear();
+
+    size_t i = 0;
+    for(;i + 2 < bounds.size();i += 2) {
+      next_bounds.push_back(bounds[i]);
+      thread_list.emplace_back([begin, &bounds, cmp, i]() {
+        std::inplace_merge(begin + bounds[i],
+                           begin + bounds[i + 1],
+                           begin + bounds[i + 2],
+                           cmp);
+      });
+    }
+
+    // An odd run out is carried into the next round as it is
+    if(i + 1 < bounds.size()) {
+      next_bounds.push_back(bounds[i]);
+    }
+
+    next_bounds.push_back(bounds.back());
+
+    for(std::thread &t : thread_list) {
+      t.join();
+    }
+
+    bounds.swap(next_bounds);
+  }
+
+  return;
+}
+
+/*
+ * class IndexStats - Named contention and maintenance counters of an index
+ *
+ * Counters an index does not maintain stay untracked and are printed as n/a
+ * rather than 0, so that indexes can be compared without guessing. Counters
+ * bumped on every operation (restarts, splits, traversals, ...) are only
+ * maintained when built with INDEX_COLLECT_STATISTICS
+ */
+class IndexStats {
+ public:
+  enum Counter {
+    // Operations that gave up and retried (OLC restarts, BwTree aborts)
+    RESTART = 0,
+    CAS_FAILURE,
+    NODE_SPLIT,
+    NODE_MERGE,
+    NODE_CONSOLIDATION,
+    EPOCH_ADVANCE,
+    RETIRED_NODE,
+    FREED_NODE,
+    // Root to leaf descents and the inner nodes they visited, including the
+    // ones visited again after a restart. OLC trees only count point
+    // operations; BwTree and Masstree also count the descents of scans
+    TRAVERSAL,
+    TRAVERSAL_STEP,
+
+    COUNTER_COUNT,
+  };
+
+  uint64_t counters[COUNTER_COUNT];
+  // Bit i is set if counters[i] is maintained by the index
+  uint32_t tracked;
+
+  static const char *GetName(int counter) {
+    static const char *name_list[COUNTER_COUNT] = {
+      "restart",
+      "cas_failure",
+      "split",
+      "merge",
+      "consolidation",
+      "epoch_advance",
+      "retired_node",
+      "freed_node",
+      "traversal",
+      "traversal_step",
+    };
+
+    return name_list[counter];
+  }
+
+  inline bool IsTracked(int counter) const {
+    return (tracked & (1U << counter)) != 0;
+  }
+
+  inline void Add(Counter counter, uint64_t value) {
+    counters[counter] += value;
+    tracked |= (1U << counter);
+  }
+
+  void Merge(const IndexStats &other) {
+    for(int i = 0;i < COUNTER_COUNT;i++) {
+      counters[i] += other.counters[i];
+    }
+    tracked |= other.tracked;
+  }
+
+  // other must be an earlier snapshot of the same counters
+  void Subtract(const IndexStats &other) {
+    for(int i = 0;i < COUNTER_COUNT;i++) {
+      counters[i] -= other.counters[i];
+    }
+  }
+
+  double GetAverageDepth() const {
+    if(counters[TRAVERSAL] == 0) {
+      return 0.0;
+    }
+
+    return (double)counters[TRAVERSAL_STEP] / counters[TRAVERSAL];
+  }
+
+  void Print() const {
+    fprintf(stderr, "Index counters:");
+    for(int i = 0;i < COUNTER_COUNT;i++) {
+      if(IsTracked(i) == true) {
+        fprintf(stderr, " %s = %lu;", GetName(i), counters[i]);
+      } else {
+        fprintf(stderr, " %s = n/a;", GetName(i));
+      }
+    }
+
+    if(IsTracked(TRAVERSAL) == true) {
+      fprintf(stderr, " avg. depth = %.2f\n", GetAverageDepth());
+    } else {
+      fprintf(stderr, " avg. depth = n/a\n");
+    }
+  }
+};
+
+/*
+ * struct PaddedIndexStats - Counters of one worker on cache lines of its own
+ */
+struct PaddedIndexStats {
+  union {
+    IndexStats stats;
+    char padding[(sizeof(IndexStats) + CACHE_LINE_SIZE - 1) & \
+                 ~(CACHE_LINE_SIZE - 1)];
+  };
+};
+
 template<typename KeyType, class KeyComparator>
 class Index
 {
@@ -46,10 +223,20 @@ class Index
   virtual int64_t getMemory() const = 0;
 
   // This initializes the thread pool
+  // Adapters that need per-thread context (e.g. Masstree threadinfo)
+  // create it here and bind it to the calling thread in AssignGCID()
   virtual void UpdateThreadLocal(size_t thread_num) = 0;
   virtual void AssignGCID(size_t thread_id) = 0;
   virtual void UnregisterThread(size_t thread_id) = 0;
   
+  // Builds the index from the load phase keys in one step (in the main
+  // thread, using up to thread_num threads) instead of inserting them.
+  // Returns false if the index does not support it
+  virtual bool BulkLoad(const std::vector<KeyType> &,
+                        const std::vector<uint64_t> &,
+                        double,
+                        int) { return false; }
+
   // After insert phase perform this action
   // By default it is empty
   // This will be called in the main thread
@@ -60,8 +247,28 @@ class Index
   virtual void CollectStatisticalCounter(int) {}
   virtual size_t GetIndexSize() { return 0UL; }
 
+  // Prints memory reclamation state after a phase; called in the main
+  // thread after all workers have joined
+  virtual void PrintGCStats() {}
+
+  // Adds the counters of the calling thread, accumulated since it first
+  // used the index. Each worker calls this when it starts and when it is
+  // done, and StartThreads() keeps the difference
+  virtual void CollectThreadStats(IndexStats *) {}
+
+  // Adds the counters that are not kept per thread; called in the main
+  // thread before the workers start and after they have joined
+  virtual void CollectGlobalStats(IndexStats *) {}
+
+  // Returns the counters of the last phase run by StartThreads()
+  IndexStats GetStats() const { return stats; }
+  void SetStats(const IndexStats &p_stats) { stats = p_stats; }
+
   // Destructor must also be virtual
   virtual ~Index() {}
+
+ private:
+  IndexStats stats{};
 };
 
 /////////////////////////////////////////////////////////////////////
@@ -69,10 +276,28 @@ class Index
 /////////////////////////////////////////////////////////////////////
 
 extern thread_local long skiplist_steps;
+extern thread_local long skiplist_ops;
 extern std::atomic<long> skiplist_total_steps;
 
+// Every this many operations a worker publishes its steps to the
+// background threads, which sample steps per op over time
+static constexpr long SKIPLIST_STEP_REPORT_OPS = 4096;
+
+/////////////////////////////////////////////////////////////////////
+// Masstree
+/////////////////////////////////////////////////////////////////////
+
+// A Masstree worker quiesces (and advances the global epoch) every
+// masstree_rcu_ops operations, or if masstree_rcu_us is non-zero,
+// every masstree_rcu_us microseconds instead
+extern uint64_t masstree_rcu_ops;
+extern uint64_t masstree_rcu_us;
+
+// With time based quiescing the clock is only read this often
+static constexpr uint64_t MASSTREE_RCU_CLOCK_OPS = 64;
+
 template<typename KeyType, class KeyComparator>
-class BTreeRTMIndex : public Index<KeyType, KeyComparator>
+class BTreeRTMIndex final : public Index<KeyType, KeyComparator>
 {
  public:
   ~BTreeRTMIndex() {
@@ -103,7 +328,8 @@ class BTreeRTMIndex : public Index<KeyType, KeyComparator>
   }
 
   void incKey(uint64_t& key) { key++; };
-  void incKey(GenericKey<31>& key) { key.data[strlen(key.data)-1]++; };
+  template<std::size_t keySize>
+  void incKey(GenericKey<keySize>& key) { key.data[strlen(key.data)-1]++; };
 
   uint64_t scan(KeyType key, int range, threadinfo *ti) {
     return 0;
@@ -124,7 +350,7 @@ class BTreeRTMIndex : public Index<KeyType, KeyComparator>
 };
 
 template<typename KeyType, class KeyComparator>
-class SkipListIndex : public Index<KeyType, KeyComparator> {
+class SkipListIndex final : public Index<KeyType, KeyComparator> {
  public:
   set_t *set;
  public:
@@ -156,8 +382,28 @@ class SkipListIndex : public Index<KeyType, KeyComparator> {
     return;
   }
 
+  /*
+   * ReportSteps() - Moves the thread-local steps into the global counter
+   *                 and publishes them to the background threads
+   */
+  inline void ReportSteps() {
+    bg_add_steps(skiplist_steps, skiplist_ops);
+    skiplist_total_steps.fetch_add(skiplist_steps);
+    thread_reported_steps += skiplist_steps;
+    thread_reported_ops += skiplist_ops;
+    skiplist_steps = 0L;
+    skiplist_ops = 0L;
+  }
+
+  inline void CountOp() {
+    if(++skiplist_ops == SKIPLIST_STEP_REPORT_OPS) {
+      ReportSteps();
+    }
+  }
+
   bool insert(KeyType key, uint64_t value, threadinfo *ti) {
     sl_insert(&skiplist_steps, set, key, &value);
+    CountOp();
     (void)ti;
     return true;
   }
@@ -168,6 +414,7 @@ class SkipListIndex : public Index<KeyType, KeyComparator> {
     // the key is stored. We just call push_back() with an arbitraty
     // number to compensate for lacking a value
     sl_contains(&skiplist_steps, set, key);
+    CountOp();
     (void)v; (void)ti;
     v->clear();
     v->push_back(0);
@@ -179,12 +426,14 @@ class SkipListIndex : public Index<KeyType, KeyComparator> {
     // the internals of the skiplist, we can make it one atomic step
     sl_delete(&skiplist_steps, set, key);
     sl_insert(&skiplist_steps, set, key, &value);
+    CountOp();
     (void)ti;
     return true;
   }
 
   uint64_t scan(KeyType key, int range, threadinfo *ti) {
     sl_scan(&skiplist_steps, set, key, range);
+    CountOp();
     (void)ti;
     return 0UL;
   }
@@ -205,22 +454,143 @@ class SkipListIndex : public Index<KeyType, KeyComparator> {
   void AssignGCID(size_t thread_id) { 
     (void)thread_id; 
     skiplist_steps = 0L; 
+    skiplist_ops = 0L;
   }
 
   // Before thread exits we aggregate the steps into the global counter
   void UnregisterThread(size_t thread_id) { 
     (void)thread_id; 
-    skiplist_total_steps.fetch_add(skiplist_steps);
+    ReportSteps();
+    return;
+  }
+
+  // Only the search path is counted; every operation (scans included) is
+  // one traversal and every node visited on the way is a step
+  void CollectThreadStats(IndexStats *stats) {
+    stats->Add(IndexStats::TRAVERSAL, thread_reported_ops + skiplist_ops);
+    stats->Add(IndexStats::TRAVERSAL_STEP,
+               thread_reported_steps + skiplist_steps);
+  }
+
+ private:
+  // What the calling thread has moved out of skiplist_steps and
+  // skiplist_ops so far
+  static thread_local uint64_t thread_reported_steps;
+  static thread_local uint64_t thread_reported_ops;
+};
+
+template<typename KeyType, class KeyComparator>
+thread_local uint64_t
+SkipListIndex<KeyType, KeyComparator>::thread_reported_steps = 0UL;
+
+template<typename KeyType, class KeyComparator>
+thread_local uint64_t
+SkipListIndex<KeyType, KeyComparator>::thread_reported_ops = 0UL;
+
+/////////////////////////////////////////////////////////////////////
+// Rotate skiplist
+/////////////////////////////////////////////////////////////////////
+
+template<typename KeyType,
+         class KeyComparator,
+         class KeyEqualityChecker=std::equal_to<KeyType>>
+class RotateSkiplistIndex final : public Index<KeyType, KeyComparator> {
+ public:
+  using IndexType = rotate_skiplist::RotateSkiplist<KeyType,
+                                                    uint64_t,
+                                                    KeyComparator,
+                                                    KeyEqualityChecker>;
+
+  IndexType *idx;
+ public:
+  /*
+   * Constructor - This also starts the background thread
+   */
+  RotateSkiplistIndex(uint64_t kt) {
+    (void)kt;
+    idx = new IndexType{};
     return;
   }
+
+  ~RotateSkiplistIndex() {
+    delete idx;
+  }
+
+  bool insert(KeyType key, uint64_t value, threadinfo *ti) {
+    (void)ti;
+    return idx->Insert(key, value);
+  }
+
+  uint64_t find(KeyType key, std::vector<uint64_t> *v, threadinfo *ti) {
+    (void)ti;
+    uint64_t value;
+    v->clear();
+    if(idx->GetValue(key, &value) == true) {
+      v->push_back(value);
+    }
+
+    return 0UL;
+  }
+
+  bool upsert(KeyType key, uint64_t value, threadinfo *ti) {
+    (void)ti;
+    idx->Upsert(key, value);
+    return true;
+  }
+
+  uint64_t scan(KeyType key, int range, threadinfo *ti) {
+    (void)ti;
+    std::vector<uint64_t> v{};
+    v.reserve(range);
+    return idx->Scan(key, static_cast<size_t>(range), &v);
+  }
+
+  int64_t getMemory() const {
+    return 0L;
+  }
+
+  size_t GetIndexSize() {
+    return idx->GetSize();
+  }
+
+  // Thread states are claimed on first access and released on thread exit
+  void UpdateThreadLocal(size_t thread_num) { (void)thread_num; }
+  void AssignGCID(size_t thread_id) { (void)thread_id; }
+  void UnregisterThread(size_t thread_id) { (void)thread_id; }
+
+  // Thread states outlive their threads, so the counters accumulate over
+  // every thread that has owned the same state object
+  void CollectThreadStats(IndexStats *stats) {
+#ifdef INDEX_COLLECT_STATISTICS
+    const rotate_skiplist::ThreadState *thread_state_p = \
+      rotate_skiplist::ThreadState::GetCurrent();
+    stats->Add(IndexStats::RESTART, thread_state_p->retry_count);
+    stats->Add(IndexStats::CAS_FAILURE, thread_state_p->cas_failure_count);
+    stats->Add(IndexStats::RETIRED_NODE, thread_state_p->retired_count);
+    stats->Add(IndexStats::TRAVERSAL, thread_state_p->traversal_count);
+    stats->Add(IndexStats::TRAVERSAL_STEP,
+               thread_state_p->traversal_step_count);
+#else
+    (void)stats;
+#endif
+  }
+
+  void CollectGlobalStats(IndexStats *stats) {
+    stats->Add(IndexStats::EPOCH_ADVANCE,
+               rotate_skiplist::GCGlobalState::Get()->epoch_advance_count);
+  }
 };
 
 /////////////////////////////////////////////////////////////////////
 // ARTOLC
 /////////////////////////////////////////////////////////////////////
 
+// If set, ART recycles inner nodes through per-thread pools instead of
+// returning them to the allocator
+extern bool art_node_pool;
+
 template<typename KeyType, class KeyComparator>
-class ArtOLCIndex : public Index<KeyType, KeyComparator>
+class ArtOLCIndex final : public Index<KeyType, KeyComparator>
 {
  public:
 
@@ -232,8 +602,16 @@ class ArtOLCIndex : public Index<KeyType, KeyComparator>
   void AssignGCID(size_t thread_id) {}
   void UnregisterThread(size_t thread_id) {}
 
-  void setKey(Key& k, uint64_t key) { k.setInt(key); }
-  void setKey(Key& k, GenericKey<31> key) { k.set(key.data,31); }
+  static void setKey(Key& k, uint64_t key) { k.setInt(key); }
+  template<std::size_t keySize>
+  static void setKey(Key& k, const GenericKey<keySize> &key) { k.set(key.data,keySize); }
+  template<std::size_t prefixSize>
+  static void setKey(Key& k, const VarKey<prefixSize> &key) {
+    // The trailing NUL keeps keys prefix free, as ART requires
+    k.setKeyLen(key.getLength() + 1);
+    key.copyTo(reinterpret_cast<char*>(k.data));
+    k.data[key.getLength()] = 0;
+  }
 
   bool insert(KeyType key, uint64_t value, threadinfo *ti) {
     auto t = idx->getThreadInfo();
@@ -276,27 +654,135 @@ class ArtOLCIndex : public Index<KeyType, KeyComparator>
   void merge() {
   }
 
+  /*
+   * BulkLoad() - Sorts the keys in parallel and builds the tree top-down
+   *
+   * ART nodes are sized by their fan-out, so the fill factor is ignored
+   */
+  bool BulkLoad(const std::vector<KeyType> &keys,
+                const std::vector<uint64_t> &values,
+                double fill_factor,
+                int thread_num) {
+    (void)fill_factor;
+
+    // Positions are sorted instead of the keys themselves; a stable order
+    // keeps the last value of duplicate keys, as repeated inserts would
+    std::vector<size_t> order(keys.size());
+    for(size_t i = 0;i < order.size();i++) {
+      order[i] = i;
+    }
+    auto cmp = [&keys](size_t a, size_t b) {
+      return KeyComparator{}(keys[a], keys[b]);
+    };
+    ParallelSort(order.begin(), order.end(), cmp, thread_num);
+
+    std::vector<TID> tids(order.size());
+    for(size_t i = 0;i < order.size();i++) {
+      tids[i] = values[order[i]];
+    }
+
+    BulkKeys bulk_keys{&keys, &order};
+    return idx->bulkLoad(order.size(),
+                         bulkKey,
+                         bulkByte,
+                         &bulk_keys,
+                         tids.data(),
+                         thread_num);
+  }
+
+  /*
+   * PrintGCStats() - Prints inner node allocations and how many of them
+   *                  were served from the node pools
+   */
+  void PrintGCStats() {
+    static const char *node_names[] = {"N4", "N16", "N48", "N256"};
+    uint64_t allocations[ART::NodePool::sizeClasses];
+    uint64_t hits[ART::NodePool::sizeClasses];
+    uint64_t recycled[ART::NodePool::sizeClasses];
+    idx->getNodePoolStats(allocations, hits, recycled);
+
+    for(size_t i = 0;i < ART::NodePool::sizeClasses;i++) {
+      fprintf(stderr, "ART %s allocations = %lu; pool hits = %lu (%.1f%%); recycled = %lu\n",
+              node_names[i], allocations[i], hits[i],
+              allocations[i] ? 100.0 * hits[i] / allocations[i] : 0.0,
+              recycled[i]);
+    }
+  }
+
+  // Lock upgrades are not counted apart from the restarts they cause
+  void CollectThreadStats(IndexStats *stats) {
+    auto t = idx->getThreadInfo();
+    stats->Add(IndexStats::RETIRED_NODE, t.getRetiredCount());
+    stats->Add(IndexStats::FREED_NODE, t.getFreedCount());
+
+#ifdef INDEX_COLLECT_STATISTICS
+    const ART::OpStats &op_stats = t.getOpStats();
+    stats->Add(IndexStats::RESTART, op_stats.restarts);
+    stats->Add(IndexStats::NODE_SPLIT, op_stats.splits);
+    stats->Add(IndexStats::NODE_MERGE, op_stats.merges);
+    stats->Add(IndexStats::EPOCH_ADVANCE, op_stats.epocheAdvances);
+    stats->Add(IndexStats::TRAVERSAL, op_stats.traversals);
+    stats->Add(IndexStats::TRAVERSAL_STEP, op_stats.traversalNodes);
+#endif
+  }
+
   ArtOLCIndex(uint64_t kt) {
+    // Leaves carry their own copy of the key, so values can be arbitrary
+    // payloads and key checks never dereference them
+    idx = new ART_OLC::Tree();
+    idx->setNodePool(art_node_pool);
     if (sizeof(KeyType)==8) {
-      idx = new ART_OLC::Tree([](TID tid, Key &key) { key.setInt(*reinterpret_cast<uint64_t*>(tid)); });
       maxKey.setInt(~0ull);
     } else {
-      idx = new ART_OLC::Tree([](TID tid, Key &key) { key.set(reinterpret_cast<char*>(tid),31); });
-      uint8_t m[] = {0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
-		     0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
-		     0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
-		     0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF};
-      maxKey.set((char*)m,31);
+      // As wide as the key; this is above every printable string key
+      std::string m(sizeof(KeyType), (char)0xFF);
+      maxKey.set(m.data(),m.size());
     }
   }
 
  private:
+  // Sorted view of the keys handed to ART_OLC::Tree::bulkLoad()
+  struct BulkKeys {
+    const std::vector<KeyType> *keys;
+    const std::vector<size_t> *order;
+  };
+
+  static void bulkKey(std::size_t i, Key &k, void *arg) {
+    const BulkKeys *bulk_keys = static_cast<const BulkKeys *>(arg);
+    setKey(k, (*bulk_keys->keys)[(*bulk_keys->order)[i]]);
+  }
+
+  // Byte depth of the key setKey() would build, without building it
+  static uint8_t keyByte(uint64_t key, uint32_t depth) {
+    return static_cast<uint8_t>(key >> (56 - 8 * depth));
+  }
+  template<std::size_t keySize>
+  static uint8_t keyByte(const GenericKey<keySize> &key, uint32_t depth) {
+    return static_cast<uint8_t>(key.data[depth]);
+  }
+  template<std::size_t prefixSize>
+  static uint8_t keyByte(const VarKey<prefixSize> &key, uint32_t depth) {
+    // The prefix is zero padded, like the trailing NUL
+    if(depth < prefixSize) {
+      return static_cast<uint8_t>(key.prefix[depth]);
+    }
+    if(depth < key.getLength()) {
+      return static_cast<uint8_t>(key.suffix[depth - prefixSize]);
+    }
+    return 0;
+  }
+
+  static uint8_t bulkByte(std::size_t i, uint32_t depth, void *arg) {
+    const BulkKeys *bulk_keys = static_cast<const BulkKeys *>(arg);
+    return keyByte((*bulk_keys->keys)[(*bulk_keys->order)[i]], depth);
+  }
+
   Key maxKey;
   ART_OLC::Tree *idx;
 };
 
 template<typename KeyType, class KeyComparator>
-class BTreeOLCIndex : public Index<KeyType, KeyComparator>
+class BTreeOLCIndex final : public Index<KeyType, KeyComparator>
 {
  public:
 
@@ -326,7 +812,17 @@ class BTreeOLCIndex : public Index<KeyType, KeyComparator>
   }
 
   void incKey(uint64_t& key) { key++; };
-  void incKey(GenericKey<31>& key) { key.data[strlen(key.data)-1]++; };
+  template<std::size_t keySize>
+  void incKey(GenericKey<keySize>& key) { key.data[strlen(key.data)-1]++; };
+  template<std::size_t prefixSize>
+  void incKey(VarKey<prefixSize>& key) {
+    // The next larger key is the key followed by a NUL; it only has to live
+    // until the next scan() call
+    static thread_local char buf[VarKey<prefixSize>::MAX_LENGTH + 1];
+    size_t len = key.copyTo(buf);
+    buf[len] = '\0';
+    key.setFromData(buf, len + 1, true);
+  }
 
   uint64_t scan(KeyType key, int range, threadinfo *ti) {
     uint64_t results[range];
@@ -350,6 +846,20 @@ class BTreeOLCIndex : public Index<KeyType, KeyComparator>
     return 0;
   }
 
+  // Nodes are never merged or freed, so only OLC counters are tracked
+  void CollectThreadStats(IndexStats *stats) {
+#ifdef INDEX_COLLECT_STATISTICS
+    const btreeolc::Stats &thread_stats = btreeolc::threadStats();
+    stats->Add(IndexStats::RESTART, thread_stats.restarts);
+    stats->Add(IndexStats::CAS_FAILURE, thread_stats.casFailures);
+    stats->Add(IndexStats::NODE_SPLIT, thread_stats.splits);
+    stats->Add(IndexStats::TRAVERSAL, thread_stats.traversals);
+    stats->Add(IndexStats::TRAVERSAL_STEP, thread_stats.traversalNodes);
+#else
+    (void)stats;
+#endif
+  }
+
   void merge() {}
 
   BTreeOLCIndex(uint64_t kt) {}
@@ -359,14 +869,39 @@ class BTreeOLCIndex : public Index<KeyType, KeyComparator>
   btreeolc::BTree<KeyType,uint64_t> idx;
 };
 
+/////////////////////////////////////////////////////////////////////
+// BwTree
+/////////////////////////////////////////////////////////////////////
+
+// If set, BwTree scans go through the ForwardIterator, which consolidates
+// every visited leaf, instead of BwTree::Scan(); used to compare the two
+extern bool bwtree_iterator_scan;
+
+// If set, BwTree worker threads hand sealed garbage batches off to the
+// epoch thread instead of reclaiming them inline
+extern bool bwtree_background_gc;
+
+// Alternative node sizings instantiated by getInstance(); the default one
+// is BwTreeNodeSizing<> (see bwtree.h)
+using BwTreeSmallNodeSizing = BwTreeNodeSizing<32, 8, 64, 16, 2, 16>;
+using BwTreeLargeNodeSizing = BwTreeNodeSizing<128, 32, 256, 64, 4, 32>;
+
 template<typename KeyType, 
          typename KeyComparator,
          typename KeyEqualityChecker=std::equal_to<KeyType>,
-         typename KeyHashFunc=std::hash<KeyType>>
-class BwTreeIndex : public Index<KeyType, KeyComparator>
+         typename KeyHashFunc=std::hash<KeyType>,
+         typename NodeSizing=BwTreeNodeSizing<>>
+class BwTreeIndex final : public Index<KeyType, KeyComparator>
 {
  public:
-  using index_type = BwTree<KeyType, uint64_t, KeyComparator, KeyEqualityChecker, KeyHashFunc>;
+  using index_type = BwTree<KeyType,
+                            uint64_t,
+                            KeyComparator,
+                            KeyEqualityChecker,
+                            KeyHashFunc,
+                            std::equal_to<uint64_t>,
+                            std::hash<uint64_t>,
+                            NodeSizing>;
   using BaseNode = typename index_type::BaseNode;
 
   BwTreeIndex(uint64_t kt) {
@@ -374,7 +909,15 @@ class BwTreeIndex : public Index<KeyType, KeyComparator>
     assert(index_p != nullptr);
     (void)kt;
 
-    // Print the size of preallocated storage
+    index_p->SetBackgroundGC(bwtree_background_gc);
+
+    // Print the node sizing and the size of preallocated storage
+    fprintf(stderr,
+            "Inner node size = [%d, %d]; Leaf node size = [%d, %d]\n",
+            (int)index_type::INNER_NODE_SIZE_LOWER_THRESHOLD,
+            (int)index_type::INNER_NODE_SIZE_UPPER_THRESHOLD,
+            (int)index_type::LEAF_NODE_SIZE_LOWER_THRESHOLD,
+            (int)index_type::LEAF_NODE_SIZE_UPPER_THRESHOLD);
     fprintf(stderr, "Inner prealloc size = %lu; Leaf prealloc size = %lu\n",
             index_type::INNER_PREALLOCATION_SIZE,
             index_type::LEAF_PREALLOCATION_SIZE);
@@ -391,7 +934,7 @@ class BwTreeIndex : public Index<KeyType, KeyComparator>
   void CollectStatisticalCounter(int thread_num) {
     static constexpr int counter_count = \
       BwTreeBase::GCMetaData::CounterType::COUNTER_COUNT;
-    int counters[counter_count];
+    uint64_t counters[counter_count];
     
     // Aggregate on the array of counters
     memset(counters, 0x00, sizeof(counters));
@@ -405,14 +948,97 @@ class BwTreeIndex : public Index<KeyType, KeyComparator>
     fprintf(stderr, "Statistical counters:\n");
     for(int j = 0;j < counter_count;j++) {
       fprintf(stderr,
-              "    counter %s = %d\n",
+              "    counter %s = %lu\n",
               BwTreeBase::GCMetaData::COUNTER_NAME_LIST[j],
               counters[j]);
     }
+
+#ifdef BWTREE_ADAPTIVE_CONSOLIDATION
+    PrintNodeStatistics();
+#endif
     
     return;
   }
 #endif
+
+#ifdef BWTREE_ADAPTIVE_CONSOLIDATION
+  /*
+   * PrintNodeStatistics() - Summarize per leaf CAS aborts, consolidations
+   *                         and adaptive thresholds
+   *
+   * Only NodeIDs that ever saw an abort or a consolidation are counted. The
+   * leaves with the most aborts are listed individually
+   */
+  void PrintNodeStatistics() {
+    static constexpr int top_count = 5;
+    using NodeStat = typename index_type::NodeStat;
+
+    size_t node_num = 0, revised_num = 0;
+    uint64_t abort_total = 0, consolidate_total = 0, consolidate_fail_total = 0;
+    int threshold_min = LEAF_DELTA_CHAIN_LENGTH_MAX;
+    int threshold_max = 0;
+    uint64_t threshold_sum = 0;
+    std::vector<std::pair<uint32_t, NodeID>> top_list{};
+
+    NodeID node_id_end = index_p->GetNodeIDBound();
+    for(NodeID node_id = 1;node_id < node_id_end;node_id++) {
+      const NodeStat *stat_p = index_p->GetNodeStat(node_id);
+      uint32_t aborts = stat_p->abort_total.load();
+      uint32_t consolidates = stat_p->consolidate_total.load();
+      uint32_t consolidate_fails = stat_p->consolidate_fail_total.load();
+      if(aborts == 0 && consolidates == 0 && consolidate_fails == 0) {
+        continue;
+      }
+
+      node_num++;
+      abort_total += aborts;
+      consolidate_total += consolidates;
+      consolidate_fail_total += consolidate_fails;
+
+      int threshold = index_p->GetLeafConsolidateThreshold(node_id);
+      if(stat_p->threshold.load() != 0) {
+        revised_num++;
+      }
+
+      threshold_min = std::min(threshold_min, threshold);
+      threshold_max = std::max(threshold_max, threshold);
+      threshold_sum += threshold;
+
+      top_list.push_back(std::make_pair(aborts, node_id));
+    }
+
+    fprintf(stderr, "Leaf node statistics (%lu nodes, %lu adapted):\n",
+            node_num, revised_num);
+    if(node_num == 0) {
+      return;
+    }
+
+    fprintf(stderr,
+            "    aborts = %lu; consolidations = %lu; failed consolidations = %lu\n",
+            abort_total, consolidate_total, consolidate_fail_total);
+    fprintf(stderr,
+            "    consolidation threshold min = %d; avg = %.2f; max = %d\n",
+            threshold_min, (double)threshold_sum / node_num, threshold_max);
+
+    size_t list_size = std::min(top_list.size(), (size_t)top_count);
+    std::partial_sort(top_list.begin(),
+                      top_list.begin() + list_size,
+                      top_list.end(),
+                      std::greater<std::pair<uint32_t, NodeID>>{});
+    for(size_t i = 0;i < list_size && top_list[i].first != 0;i++) {
+      const NodeStat *stat_p = index_p->GetNodeStat(top_list[i].second);
+      fprintf(stderr,
+              "    node %lu: aborts = %u; consolidations = %u (%u failed); threshold = %d\n",
+              top_list[i].second,
+              top_list[i].first,
+              stat_p->consolidate_total.load(),
+              stat_p->consolidate_fail_total.load(),
+              index_p->GetLeafConsolidateThreshold(top_list[i].second));
+    }
+
+    return;
+  }
+#endif
   
   void AfterLoadCallback() {
     int inner_depth_total = 0,
@@ -484,6 +1110,111 @@ class BwTreeIndex : public Index<KeyType, KeyComparator>
     return;
   }
   
+  /*
+   * BulkLoad() - Sorts the keys in parallel and builds consolidated nodes
+   *              bottom-up
+   */
+  bool BulkLoad(const std::vector<KeyType> &keys,
+                const std::vector<uint64_t> &values,
+                double fill_factor,
+                int thread_num) {
+    std::vector<std::pair<KeyType, uint64_t>> kv_list{};
+    kv_list.reserve(keys.size());
+    for(size_t i = 0;i < keys.size();i++) {
+      kv_list.push_back(std::make_pair(keys[i], values[i]));
+    }
+
+    typedef std::pair<KeyType, uint64_t> KeyValuePair;
+    auto cmp = [](const KeyValuePair &a, const KeyValuePair &b) {
+      return KeyComparator{}(a.first, b.first);
+    };
+    ParallelSort(kv_list.begin(), kv_list.end(), cmp, thread_num);
+    return index_p->BulkLoad(kv_list.begin(),
+                             kv_list.end(),
+                             fill_factor,
+                             thread_num);
+  }
+
+  /*
+   * PrintGCStats() - Prints the time worker threads spent reclaiming garbage
+   *                  and the bytes still waiting for an epoch, and checks
+   *                  that every retired node was reclaimed
+   *
+   * StartThreads() rebuilds the thread local array after the workers join,
+   * so these are the counters BwTree saved right before that
+   */
+  void PrintGCStats() {
+    const BwTreeBase::GCStats &stats = index_p->GetLastGCStats();
+
+    fprintf(stderr, "BwTree GC pauses = %lu; total = %.3f ms; max = %.3f ms\n",
+            stats.pause_count,
+            stats.pause_ns / 1000000.0,
+            stats.pause_max_ns / 1000000.0);
+
+    if(index_p->IsBackgroundGC() == true) {
+      fprintf(stderr, "BwTree background GC rounds = %lu; total = %.3f ms\n",
+              stats.background_count, stats.background_ns / 1000000.0);
+    }
+
+    fprintf(stderr, "BwTree GC backlog = %lu bytes\n", stats.backlog_bytes);
+    fprintf(stderr, "BwTree GC retired = %lu nodes; reclaimed = %lu; "
+                    "drained after the phase = %lu\n",
+            stats.retired_nodes, stats.reclaimed_nodes, stats.drained_nodes);
+
+    // Every retired node must have been freed exactly once by the time the
+    // thread local array is dropped
+    if(stats.reclaimed_nodes + stats.drained_nodes != stats.retired_nodes) {
+      fprintf(stderr, "BwTree GC counters are inconsistent: %lu retired "
+                      "but %lu reclaimed\n",
+              stats.retired_nodes,
+              stats.reclaimed_nodes + stats.drained_nodes);
+      exit(1);
+    }
+  }
+
+  /*
+   * CollectThreadStats() - Reads the GC context of the calling thread
+   *
+   * The thread local array is rebuilt before every phase, so these only
+   * cover the current phase. Restarts are the aborts of modifying and read
+   * traversals, and every descent counts as a traversal, including those
+   * of scans and of retries after a failed CAS
+   */
+  void CollectThreadStats(IndexStats *stats) {
+    using GCMetaData = BwTreeBase::GCMetaData;
+    const GCMetaData *metadata_p = index_p->GetCurrentGCMetaData();
+
+#ifdef BWTREE_COLLECT_STATISTICS
+    const GCMetaData::CounterValueType *counters = metadata_p->counters;
+    stats->Add(IndexStats::RESTART,
+               counters[GCMetaData::MODIFY_ABORT] +
+               counters[GCMetaData::READ_ABORT]);
+    stats->Add(IndexStats::CAS_FAILURE, counters[GCMetaData::CAS_FAILURE]);
+    stats->Add(IndexStats::NODE_SPLIT,
+               counters[GCMetaData::LEAF_SPLIT] +
+               counters[GCMetaData::INNER_SPLIT]);
+    stats->Add(IndexStats::NODE_MERGE,
+               counters[GCMetaData::LEAF_MERGE] +
+               counters[GCMetaData::INNER_MERGE]);
+    stats->Add(IndexStats::NODE_CONSOLIDATION,
+               counters[GCMetaData::LEAF_CONSOLIDATE] +
+               counters[GCMetaData::INNER_CONSOLIDATE]);
+    stats->Add(IndexStats::TRAVERSAL, counters[GCMetaData::TRAVERSE]);
+    stats->Add(IndexStats::TRAVERSAL_STEP,
+               counters[GCMetaData::TRAVERSE_STEP]);
+#endif
+
+    stats->Add(IndexStats::RETIRED_NODE, metadata_p->retired_nodes);
+    stats->Add(IndexStats::FREED_NODE, metadata_p->reclaimed_nodes);
+  }
+
+  // The epoch is only advanced by the epoch thread, which also reclaims
+  // handed off garbage if background GC is enabled
+  void CollectGlobalStats(IndexStats *stats) {
+    stats->Add(IndexStats::EPOCH_ADVANCE, index_p->GetGlobalEpoch());
+    stats->Add(IndexStats::FREED_NODE, index_p->GetBackgroundReclaimedNodes());
+  }
+
   void UpdateThreadLocal(size_t thread_num) { 
     index_p->UpdateThreadLocal(thread_num); 
   }
@@ -501,7 +1232,15 @@ class BwTreeIndex : public Index<KeyType, KeyComparator>
   }
 
   uint64_t find(KeyType key, std::vector<uint64_t> *v, threadinfo *) {
+#ifdef BWTREE_UNIQUE_KEY
+    // Unique keys have at most one value so skip building the value list
+    uint64_t value;
+    if(index_p->GetSingleValue(key, value) == true) {
+      v->push_back(value);
+    }
+#else
     index_p->GetValue(key, *v);
+#endif
 
     return 0UL;
   }
@@ -531,6 +1270,24 @@ class BwTreeIndex : public Index<KeyType, KeyComparator>
   }
 
   uint64_t scan(KeyType key, int range, threadinfo *) {
+    if(bwtree_iterator_scan == true) {
+      return IteratorScan(key, range);
+    }
+
+    uint64_t sum = 0;
+    index_p->Scan(key,
+                  static_cast<size_t>(range),
+                  [&sum](const std::pair<KeyType, uint64_t> &kvp) {
+      sum += kvp.second;
+    });
+
+    return sum;
+  }
+
+  /*
+   * IteratorScan() - Scan using the ForwardIterator
+   */
+  uint64_t IteratorScan(KeyType key, int range) {
     auto it = index_p->Begin(key);
 
     if(it.IsEnd() == true) {
@@ -556,20 +1313,68 @@ class BwTreeIndex : public Index<KeyType, KeyComparator>
   }
 
  private:
-  BwTree<KeyType, uint64_t, KeyComparator, KeyEqualityChecker, KeyHashFunc> *index_p;
+  index_type *index_p;
 
 };
 
 
-template<typename KeyType, class KeyComparator>
-class MassTreeIndex : public Index<KeyType, KeyComparator>
+/*
+ * class MassTreeIndex - Masstree adapter
+ *
+ * With InlineValue the 8-byte payload is stored in the leaf value slot
+ * (inline_value_table) instead of a row object allocated per key
+ */
+template<typename KeyType, class KeyComparator, bool InlineValue = false>
+class MassTreeIndex final : public Index<KeyType, KeyComparator>
 {
  public:
 
-  typedef mt_index<Masstree::default_table> MapType;
+  typedef typename std::conditional<InlineValue,
+                                    Masstree::inline_value_table,
+                                    Masstree::default_table>::type TableType;
+  typedef mt_index<TableType> MapType;
+  using InlineTag = std::integral_constant<bool, InlineValue>;
+
+  // Per-worker RCU state; padded so workers do not share cache lines
+  struct ThreadSlot {
+    union {
+      struct {
+        threadinfo *ti;
+        uint64_t op_count;
+        uint64_t last_quiesce_us;
+        uint64_t quiesce_count;
+      };
+      char padding[CACHE_LINE_SIZE];
+    };
+  };
+
+  // Sums scanned payloads for either value layout
+  struct PayloadSumVisitor {
+    uint64_t sum = 0UL;
+
+    inline void operator()(Str, const row_type *row) {
+      sum += *(const uint64_t *)row->col(0).s;
+    }
+
+    inline void operator()(Str, uint64_t value) {
+      sum += value;
+    }
+  };
 
   ~MassTreeIndex() {
+    // Tree teardown goes through the main threadinfo. Every limbo list
+    // must be drained before any pool is freed, since limbo entries of
+    // one thread may point into pool memory of another
     delete idx;
+    for(ThreadSlot &slot : slots) {
+      slot.ti->rcu_drain();
+    }
+
+    for(ThreadSlot &slot : slots) {
+      threadinfo::destroy(slot.ti);
+    }
+
+    threadinfo::destroy(main_ti);
   }
 
   inline void swap_endian(uint64_t &i) {
@@ -579,36 +1384,84 @@ class MassTreeIndex : public Index<KeyType, KeyComparator>
     i = __bswap_64(i);
   }
 
-  inline void swap_endian(GenericKey<31> &) {
+  template<std::size_t keySize>
+  inline void swap_endian(GenericKey<keySize> &) {
     return;
   }
-  
-  void UpdateThreadLocal(size_t thread_num) {}
-  void AssignGCID(size_t thread_id) {}
-  void UnregisterThread(size_t thread_id) {}
+
+  template<std::size_t prefixSize>
+  inline void swap_endian(VarKey<prefixSize> &) {
+    return;
+  }
+
+  // Masstree takes keys as byte strings
+  template<typename T>
+  static inline Str KeyString(const T &key) {
+    return Str((const char*)&key, sizeof(T));
+  }
+
+  // The string is only valid until the next call on the same thread;
+  // Masstree copies keys it keeps
+  template<std::size_t prefixSize>
+  static inline Str KeyString(const VarKey<prefixSize> &key) {
+    static thread_local char buf[VarKey<prefixSize>::MAX_LENGTH];
+    return Str(buf, key.copyTo(buf));
+  }
+
+  /*
+   * UpdateThreadLocal() - Makes sure there is a threadinfo for every
+   *                       worker; they are kept and reused across phases
+   */
+  void UpdateThreadLocal(size_t thread_num) {
+    while(slots.size() < thread_num) {
+      ThreadSlot slot{};
+      slot.ti = threadinfo::make(threadinfo::TI_PROCESS, (int)slots.size());
+      slots.push_back(slot);
+    }
+  }
+
+  void AssignGCID(size_t thread_id) {
+    if(thread_id >= slots.size()) {
+      return;
+    }
+
+    local_slot_p = &slots[thread_id];
+    local_slot_p->last_quiesce_us = NowUs();
+    local_slot_p->ti->rcu_start();
+  }
+
+  void UnregisterThread(size_t) {
+    if(local_slot_p == nullptr) {
+      return;
+    }
+
+    Quiesce(local_slot_p);
+    local_slot_p->ti->rcu_stop();
+    local_slot_p = nullptr;
+  }
 
   bool insert(KeyType key, uint64_t value, threadinfo *ti) {
     swap_endian(key);
-    idx->put((const char*)&key, sizeof(KeyType), (const char*)&value, 8, ti);
+    Put(key, value, GetThreadInfo(ti), InlineTag{});
+    CountOp();
 
     return true;
   }
 
   uint64_t find(KeyType key, std::vector<uint64_t> *v, threadinfo *ti) {
-    Str val;
     swap_endian(key);
-    idx->get((const char*)&key, sizeof(KeyType), val, ti);
 
     v->clear();
-    if (val.s)
-      v->push_back(*(uint64_t *)val.s);
+    Get(key, v, GetThreadInfo(ti), InlineTag{});
+    CountOp();
 
     return 0;
   }
 
   bool upsert(KeyType key, uint64_t value, threadinfo *ti) {
     swap_endian(key);
-    idx->put((const char*)&key, sizeof(KeyType), (const char*)&value, 8, ti);
+    Put(key, value, GetThreadInfo(ti), InlineTag{});
+    CountOp();
     return true;
   }
 
@@ -625,33 +1478,186 @@ class MassTreeIndex : public Index<KeyType, KeyComparator>
   //   return 0UL;
   // }
 
+  /*
+   * scan() - Visits up to range entries and returns the sum of their
+   *          payloads. Only used as a sink by the drivers; it is not
+   *          comparable to what the other indexes return
+   */
   uint64_t scan(KeyType key, int range, threadinfo *ti) {
-    Str results[range];
-
     swap_endian(key);
-    int key_len = sizeof(KeyType);
 
-    int resultCount = idx->get_next_n(results, (char *)&key, &key_len, range, ti);
-    //printf("scan: requested: %d, actual: %d\n", range, resultCount);
-    return resultCount;
+    PayloadSumVisitor visitor;
+    Str k = KeyString(key);
+    idx->scan_visit(k.s, k.len, range, visitor, GetThreadInfo(ti));
+    CountOp();
+    return visitor.sum;
   }
 
   int64_t getMemory() const {
     return 0;
   }
 
+  /*
+   * PrintGCStats() - Prints the epoch and what is still waiting in limbo
+   */
+  void PrintGCStats() {
+    uint64_t quiesce_count = 0UL;
+    size_t limbo_entries = main_ti->limbo_count();
+    uint64_t limbo_bytes = main_ti->limbo;
+    for(ThreadSlot &slot : slots) {
+      quiesce_count += slot.quiesce_count;
+      limbo_entries += slot.ti->limbo_count();
+      limbo_bytes += slot.ti->limbo;
+    }
+
+    fprintf(stderr, "Masstree epoch = %lu; quiesces = %lu\n",
+            (uint64_t)globalepoch, quiesce_count);
+    fprintf(stderr, "Masstree limbo entries = %lu; limbo group bytes = %lu\n",
+            limbo_entries, limbo_bytes);
+  }
+
+  /*
+   * CollectThreadStats() - Reads the threadinfo counters of the calling
+   *                        worker
+   *
+   * Masstree locks nodes instead of installing them with CAS, so CAS
+   * failures are not tracked. Everything that ever entered limbo was
+   * either freed or is still there
+   */
+  void CollectThreadStats(IndexStats *stats) {
+    ThreadSlot *slot_p = local_slot_p;
+    if(slot_p == nullptr) {
+      return;
+    }
+
+    threadinfo *ti = slot_p->ti;
+    stats->Add(IndexStats::EPOCH_ADVANCE, slot_p->quiesce_count);
+    stats->Add(IndexStats::RETIRED_NODE,
+               ti->counter(tc_gc) + ti->limbo_count());
+    stats->Add(IndexStats::FREED_NODE, ti->counter(tc_gc));
+
+    // Only these are marked by threadinfo, see threadcounter_mask
+#ifdef INDEX_COLLECT_STATISTICS
+    stats->Add(IndexStats::RESTART,
+               ti->counter(tc_root_retry) +
+               ti->counter(tc_internode_retry) +
+               ti->counter(tc_leaf_retry));
+    stats->Add(IndexStats::NODE_SPLIT,
+               ti->counter(tc_split_leaf) +
+               ti->counter(tc_split_internode));
+    stats->Add(IndexStats::NODE_MERGE, ti->counter(tc_remove_leaf));
+    stats->Add(IndexStats::TRAVERSAL, ti->counter(tc_reach_leaf));
+    stats->Add(IndexStats::TRAVERSAL_STEP, ti->counter(tc_reach_internode));
+#endif
+  }
+
   MassTreeIndex(uint64_t kt) {
     idx = new MapType{};
 
-    threadinfo *main_ti = threadinfo::make(threadinfo::TI_MAIN, -1);
+    main_ti = threadinfo::make(threadinfo::TI_MAIN, -1);
     idx->setup(main_ti);
 
     return;
   }
 
+ private:
+  // Row based table: the payload is copied into a row_type value
+  inline void Put(KeyType &key, uint64_t value, threadinfo *ti,
+                  std::false_type) {
+    Str k = KeyString(key);
+    idx->put(k.s, k.len, (const char*)&value, 8, ti);
+  }
+
+  inline void Get(KeyType &key, std::vector<uint64_t> *v, threadinfo *ti,
+                  std::false_type) {
+    Str val;
+    Str k = KeyString(key);
+    idx->get(k.s, k.len, val, ti);
+    if (val.s)
+      v->push_back(*(uint64_t *)val.s);
+  }
+
+  // Inline table: the payload is the leaf value itself
+  inline void Put(KeyType &key, uint64_t value, threadinfo *ti,
+                  std::true_type) {
+    idx->put_inline(KeyString(key), value, ti);
+  }
+
+  inline void Get(KeyType &key, std::vector<uint64_t> *v, threadinfo *ti,
+                  std::true_type) {
+    uint64_t value;
+    if (idx->get_inline(KeyString(key), value, ti))
+      v->push_back(value);
+  }
+
+  static inline uint64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /*
+   * GetThreadInfo() - Returns the threadinfo bound in AssignGCID(), or
+   *                   the one passed by a caller that was not registered
+   */
+  inline threadinfo *GetThreadInfo(threadinfo *ti) {
+    if(local_slot_p != nullptr) {
+      return local_slot_p->ti;
+    }
+
+    return ti != nullptr ? ti : main_ti;
+  }
+
+  /*
+   * Quiesce() - Advances the global epoch and frees what it allows
+   *
+   * Nothing else advances globalepoch, so without this limbo would never
+   * drain
+   */
+  inline void Quiesce(ThreadSlot *slot_p) {
+    __sync_fetch_and_add(&globalepoch, 1);
+    slot_p->ti->rcu_quiesce();
+    slot_p->quiesce_count++;
+  }
+
+  /*
+   * CountOp() - Quiesces on the configured op count or time cadence
+   */
+  inline void CountOp() {
+    ThreadSlot *slot_p = local_slot_p;
+    if(slot_p == nullptr) {
+      return;
+    }
+
+    slot_p->op_count++;
+    if(masstree_rcu_us != 0) {
+      if(slot_p->op_count % MASSTREE_RCU_CLOCK_OPS != 0) {
+        return;
+      }
+
+      uint64_t now = NowUs();
+      if(now - slot_p->last_quiesce_us < masstree_rcu_us) {
+        return;
+      }
+
+      slot_p->last_quiesce_us = now;
+    } else if(slot_p->op_count % masstree_rcu_ops != 0) {
+      return;
+    }
+
+    Quiesce(slot_p);
+  }
+
   MapType *idx;
+  threadinfo *main_ti;
+  std::vector<ThreadSlot> slots;
+
+  static thread_local ThreadSlot *local_slot_p;
 };
 
+template<typename KeyType, class KeyComparator, bool InlineValue>
+thread_local typename MassTreeIndex<KeyType, KeyComparator, InlineValue>::ThreadSlot *
+MassTreeIndex<KeyType, KeyComparator, InlineValue>::local_slot_p = nullptr;
+
 #endif
 
 
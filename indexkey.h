@@ -2,9 +2,98 @@
 #ifndef _INDEX_KEY_H
 #define _INDEX_KEY_H
 
+#include <cstdint>
 #include <cstring>
 #include <string>
 
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+/*
+ * GenericKeyCompare() - memcmp() of two key buffers of keySize bytes
+ *
+ * Keys are zero padded after the NUL, so this orders them like strcmp()
+ * without looking for the NUL. Blocks of 32 (AVX2) and 16 (SSE2) bytes find
+ * the first differing byte with cmpeq + movemask; the remainder is compared
+ * as big endian 64-bit words. Since keySize is a constant all the loops
+ * unroll, and only the block sizes that fit the key are generated
+ */
+template <std::size_t keySize>
+inline int GenericKeyCompare(const char *lhs, const char *rhs) {
+  std::size_t offset = 0;
+
+#ifdef __AVX2__
+  for(;offset + 32 <= keySize;offset += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lhs + offset));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rhs + offset));
+    uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+    if(mask != 0) {
+      std::size_t i = offset + __builtin_ctz(mask);
+      return (int)(unsigned char)lhs[i] - (int)(unsigned char)rhs[i];
+    }
+  }
+#endif
+
+#ifdef __SSE2__
+  for(;offset + 16 <= keySize;offset += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs + offset));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs + offset));
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b))) ^ 0xFFFFU;
+    if(mask != 0) {
+      std::size_t i = offset + __builtin_ctz(mask);
+      return (int)(unsigned char)lhs[i] - (int)(unsigned char)rhs[i];
+    }
+  }
+#endif
+
+  for(;offset < keySize;offset += sizeof(uint64_t)) {
+    uint64_t a = 0UL, b = 0UL;
+    std::size_t len = keySize - offset < sizeof(uint64_t) ? \
+                        keySize - offset : sizeof(uint64_t);
+    memcpy(&a, lhs + offset, len);
+    memcpy(&b, rhs + offset, len);
+    if(a != b) {
+      a = __builtin_bswap64(a);
+      b = __builtin_bswap64(b);
+      return a < b ? -1 : 1;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * GenericKeyEqual() - Whether two key buffers of keySize bytes are equal
+ */
+template <std::size_t keySize>
+inline bool GenericKeyEqual(const char *lhs, const char *rhs) {
+  std::size_t offset = 0;
+
+#ifdef __SSE2__
+  for(;offset + 16 <= keySize;offset += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs + offset));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs + offset));
+    if(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF) {
+      return false;
+    }
+  }
+#endif
+
+  for(;offset < keySize;offset += sizeof(uint64_t)) {
+    uint64_t a = 0UL, b = 0UL;
+    std::size_t len = keySize - offset < sizeof(uint64_t) ? \
+                        keySize - offset : sizeof(uint64_t);
+    memcpy(&a, lhs + offset, len);
+    memcpy(&b, rhs + offset, len);
+    if(a != b) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 template <std::size_t keySize>
 class GenericKey {
 public:
@@ -33,13 +122,14 @@ public:
     return *this;
   }
 
-  inline bool operator<(const GenericKey<keySize> &other) { return strcmp(data, other.data) < 0; }
-  inline bool operator>(const GenericKey<keySize> &other) { return strcmp(data, other.data) > 0; }
-  inline bool operator==(const GenericKey<keySize> &other) { return strcmp(data, other.data) == 0; }
+  // The buffer is always zero padded, so these need not look for the NUL
+  inline bool operator<(const GenericKey<keySize> &other) const { return GenericKeyCompare<keySize>(data, other.data) < 0; }
+  inline bool operator>(const GenericKey<keySize> &other) const { return GenericKeyCompare<keySize>(data, other.data) > 0; }
+  inline bool operator==(const GenericKey<keySize> &other) const { return GenericKeyEqual<keySize>(data, other.data); }
   // Derived operators
-  inline bool operator!=(const GenericKey<keySize> &other) { return !(*this == other); }
-  inline bool operator<=(const GenericKey<keySize> &other) { return !(*this > other); }
-  inline bool operator>=(const GenericKey<keySize> &other) { return !(*this < other); }
+  inline bool operator!=(const GenericKey<keySize> &other) const { return !(*this == other); }
+  inline bool operator<=(const GenericKey<keySize> &other) const { return !(*this > other); }
+  inline bool operator>=(const GenericKey<keySize> &other) const { return !(*this < other); }
 };
 
 template <std::size_t keySize>
@@ -48,8 +138,7 @@ public:
   GenericComparator() {}
 
   inline bool operator()(const GenericKey<keySize> &lhs, const GenericKey<keySize> &rhs) const {
-    int diff = strcmp(lhs.data, rhs.data);
-    return diff < 0;
+    return GenericKeyCompare<keySize>(lhs.data, rhs.data) < 0;
   }
 };
 
@@ -59,19 +148,280 @@ public:
   GenericEqualityChecker() {}
 
   inline bool operator()(const GenericKey<keySize> &lhs, const GenericKey<keySize> &rhs) const {
-    int diff = strcmp(lhs.data, rhs.data);
-    return diff == 0;
+    return GenericKeyEqual<keySize>(lhs.data, rhs.data);
   }
 };
 
+/*
+ * Fmix64() - MurmurHash3's 64-bit finalizer
+ *
+ * Makes every input bit affect every output bit, so that hashes built from
+ * word-at-a-time mixing also spread over the low bits
+ */
+inline uint64_t Fmix64(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDUL;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53UL;
+  hash ^= hash >> 33;
+
+  return hash;
+}
+
 template <std::size_t keySize>
 class GenericHasher {
 public:
   GenericHasher() {}
 
+  /*
+   * operator() - Hashes the key up to (not including) the first NUL
+   *
+   * The key is read 8 bytes at a time; a word containing the NUL has the
+   * bytes from the NUL on masked off, so keys that are equal under strcmp()
+   * hash to the same value whatever follows the NUL. The result is finalized
+   * with Fmix64() since BwTree's bloom filter uses the low bits
+   */
   inline size_t operator()(const GenericKey<keySize> &lhs) const {
-    (void)lhs;
-    return 0UL;
+    static constexpr uint64_t ONES = 0x0101010101010101UL;
+    static constexpr uint64_t HIGHS = 0x8080808080808080UL;
+    static constexpr uint64_t MULTIPLIER = 0x9E3779B97F4A7C15UL;
+
+    uint64_t hash = keySize;
+    for(std::size_t offset = 0;offset < keySize;offset += sizeof(uint64_t)) {
+      uint64_t word = 0UL;
+      if(offset + sizeof(uint64_t) <= keySize) {
+        memcpy(&word, lhs.data + offset, sizeof(uint64_t));
+      } else {
+        memcpy(&word, lhs.data + offset, keySize - offset);
+      }
+
+      // Nonzero iff the word has a zero byte; the lowest set bit marks the
+      // first one, which is the NUL on little endian machines
+      uint64_t zero_mask = (word - ONES) & ~word & HIGHS;
+      if(zero_mask != 0UL) {
+        word &= (zero_mask ^ (zero_mask - 1)) >> 8;
+        hash = (hash ^ word) * MULTIPLIER;
+        break;
+      }
+
+      hash = (hash ^ word) * MULTIPLIER;
+    }
+
+    return Fmix64(hash);
+  }
+};
+
+/*
+ * class VarKey - Variable length key with an inline prefix
+ *
+ * The first prefixSize bytes are stored inline and zero padded; they are
+ * compared as big endian integers, so most comparisons never look further.
+ * The remaining bytes live in a per-thread arena that is never freed, which
+ * is fine since keys are loaded once and live until the process exits.
+ * The object is trivially copyable, so it could be memcpy'ed by the indexes
+ * like GenericKey. Keys may not contain NUL bytes (see ArtOLCIndex)
+ */
+template <std::size_t prefixSize = 16>
+class VarKey {
+  static_assert(prefixSize == 8 || prefixSize == 16,
+                "VarKey prefix must be 8 or 16 bytes");
+public:
+  static constexpr std::size_t PREFIX_SIZE = prefixSize;
+  
+  // Longest key that setFromString() accepts; longer keys are truncated
+  static constexpr std::size_t MAX_LENGTH = 1024;
+  
+  // Size of one arena chunk for suffixes
+  static constexpr std::size_t ARENA_CHUNK_SIZE = 1024 * 1024;
+
+  char prefix[prefixSize];
+  uint32_t length;
+  // Bytes [prefixSize, length); nullptr if the key fits in the prefix
+  const char *suffix;
+public:
+  VarKey(int) { clear(); }
+  VarKey() { clear(); }
+
+  inline void clear() {
+    memset(prefix, 0x00, prefixSize);
+    length = 0;
+    suffix = nullptr;
+  }
+
+  inline void setFromString(std::string key) {
+    if(key.size() > MAX_LENGTH) {
+      key.resize(MAX_LENGTH);
+    }
+
+    setFromData(key.data(), key.size(), false);
+  }
+
+  /*
+   * setFromData() - Sets the key to the given bytes
+   *
+   * If borrow is true the suffix points into the caller's buffer which must
+   * outlive the key; otherwise the suffix is copied into the arena
+   */
+  inline void setFromData(const char *data, std::size_t len, bool borrow) {
+    clear();
+    length = static_cast<uint32_t>(len);
+    if(len <= prefixSize) {
+      memcpy(prefix, data, len);
+      return;
+    }
+
+    memcpy(prefix, data, prefixSize);
+    if(borrow == true) {
+      suffix = data + prefixSize;
+    } else {
+      suffix = AllocateSuffix(data + prefixSize, len - prefixSize);
+    }
+  }
+
+  inline std::size_t getLength() const { return length; }
+
+  /*
+   * copyTo() - Copies the key into a buffer of at least getLength() bytes
+   *            and returns the length
+   */
+  inline std::size_t copyTo(char *buf) const {
+    if(length <= prefixSize) {
+      memcpy(buf, prefix, length);
+    } else {
+      memcpy(buf, prefix, prefixSize);
+      memcpy(buf + prefixSize, suffix, length - prefixSize);
+    }
+
+    return length;
+  }
+
+  /*
+   * compare() - Lexicographic comparison, like memcmp() with a shorter key
+   *             ordered before a longer key it is a prefix of
+   *
+   * Zero padding in the prefix compares equal to any NUL it is compared
+   * against, so a tie there falls back to the lengths
+   */
+  inline int compare(const VarKey &other) const {
+    for(std::size_t i = 0;i < prefixSize;i += sizeof(uint64_t)) {
+      uint64_t lhs = loadWord(prefix + i);
+      uint64_t rhs = loadWord(other.prefix + i);
+      if(lhs != rhs) {
+        return lhs < rhs ? -1 : 1;
+      }
+    }
+
+    if(length > prefixSize && other.length > prefixSize) {
+      uint32_t min_length = length < other.length ? length : other.length;
+      int diff = memcmp(suffix, other.suffix, min_length - prefixSize);
+      if(diff != 0) {
+        return diff;
+      }
+    }
+
+    return (int)(length > other.length) - (int)(length < other.length);
+  }
+
+  inline bool equals(const VarKey &other) const {
+    if(length != other.length || memcmp(prefix, other.prefix, prefixSize) != 0) {
+      return false;
+    }
+
+    return length <= prefixSize || \
+           memcmp(suffix, other.suffix, length - prefixSize) == 0;
+  }
+
+  inline bool operator<(const VarKey &other) const { return compare(other) < 0; }
+  inline bool operator>(const VarKey &other) const { return compare(other) > 0; }
+  inline bool operator==(const VarKey &other) const { return equals(other); }
+  // Derived operators
+  inline bool operator!=(const VarKey &other) const { return !equals(other); }
+  inline bool operator<=(const VarKey &other) const { return compare(other) <= 0; }
+  inline bool operator>=(const VarKey &other) const { return compare(other) >= 0; }
+
+private:
+  static inline uint64_t loadWord(const char *p) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(uint64_t));
+    return __builtin_bswap64(word);
+  }
+
+  /*
+   * AllocateSuffix() - Copies bytes into the calling thread's arena
+   */
+  static const char *AllocateSuffix(const char *data, std::size_t len) {
+    static thread_local char *chunk_p = nullptr;
+    static thread_local std::size_t chunk_used = ARENA_CHUNK_SIZE;
+
+    if(chunk_used + len > ARENA_CHUNK_SIZE) {
+      chunk_p = new char[ARENA_CHUNK_SIZE];
+      chunk_used = 0;
+    }
+
+    char *p = chunk_p + chunk_used;
+    memcpy(p, data, len);
+    chunk_used += len;
+
+    return p;
+  }
+};
+
+template <std::size_t prefixSize>
+class VarKeyComparator {
+public:
+  VarKeyComparator() {}
+
+  inline bool operator()(const VarKey<prefixSize> &lhs, const VarKey<prefixSize> &rhs) const {
+    return lhs.compare(rhs) < 0;
+  }
+};
+
+template <std::size_t prefixSize>
+class VarKeyEqualityChecker {
+public:
+  VarKeyEqualityChecker() {}
+
+  inline bool operator()(const VarKey<prefixSize> &lhs, const VarKey<prefixSize> &rhs) const {
+    return lhs.equals(rhs);
+  }
+};
+
+template <std::size_t prefixSize>
+class VarKeyHasher {
+public:
+  VarKeyHasher() {}
+
+  /*
+   * operator() - Hashes the prefix words and then the suffix bytes, and
+   *              finalizes with Fmix64()
+   */
+  inline size_t operator()(const VarKey<prefixSize> &lhs) const {
+    static constexpr uint64_t MULTIPLIER = 0x9E3779B97F4A7C15UL;
+
+    uint64_t hash = lhs.length;
+    for(std::size_t i = 0;i < prefixSize;i += sizeof(uint64_t)) {
+      uint64_t word;
+      memcpy(&word, lhs.prefix + i, sizeof(uint64_t));
+      hash = (hash ^ word) * MULTIPLIER;
+    }
+
+    if(lhs.length > prefixSize) {
+      std::size_t suffix_length = lhs.length - prefixSize;
+      std::size_t i = 0;
+      for(;i + sizeof(uint64_t) <= suffix_length;i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, lhs.suffix + i, sizeof(uint64_t));
+        hash = (hash ^ word) * MULTIPLIER;
+      }
+
+      if(i < suffix_length) {
+        uint64_t word = 0UL;
+        memcpy(&word, lhs.suffix + i, suffix_length - i);
+        hash = (hash ^ word) * MULTIPLIER;
+      }
+    }
+
+    return Fmix64(hash);
   }
 };
 
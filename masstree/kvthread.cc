@@ -132,6 +132,64 @@ threadinfo *threadinfo::make(int purpose, int index) {
     return ti;
 }
 
+void threadinfo::destroy(threadinfo *ti) {
+    ti->rcu_drain();
+    ti->deallocate_ti();
+
+    limbo_group *lg = ti->limbo_head_;
+    while (lg) {
+        limbo_group *next = lg->next_;
+        ti->deallocate(lg, sizeof(limbo_group), memtag_limbo);
+        lg = next;
+    }
+
+    for (threadinfo **pp = &allthreads; *pp; pp = &(*pp)->next_)
+        if (*pp == ti) {
+            *pp = ti->next_;
+            break;
+        }
+
+    ti->pool_ptrs_.~vector();
+    free(ti);
+}
+
+void threadinfo::rcu_drain()
+{
+    std::vector<limbo_element> pending;
+    while (1) {
+        pending.clear();
+        for (limbo_group *lg = limbo_head_; lg; lg = lg->next_) {
+            pending.insert(pending.end(), lg->e_ + lg->head_,
+                           lg->e_ + lg->tail_);
+            lg->head_ = lg->tail_ = 0;
+            if (lg == limbo_tail_)
+                break;
+        }
+        if (pending.empty())
+            break;
+
+        // Groups are empty now, so callbacks may safely enqueue more
+        limbo_tail_ = limbo_head_;
+        limbo_epoch_ = 0;
+        for (size_t i = 0; i < pending.size(); ++i) {
+            free_rcu(pending[i].ptr_, pending[i].freetype_);
+            mark(tc_gc);
+        }
+    }
+    limbo_epoch_ = 0;
+}
+
+size_t threadinfo::limbo_count() const
+{
+    size_t count = 0;
+    for (const limbo_group *lg = limbo_head_; lg; lg = lg->next_) {
+        count += lg->tail_ - lg->head_;
+        if (lg == limbo_tail_)
+            break;
+    }
+    return count;
+}
+
 void threadinfo::refill_rcu()
 {
     if (limbo_head_ == limbo_tail_ && !limbo_tail_->next_
@@ -171,9 +171,28 @@ struct limbo_group {
     }
 };
 
+// Counters read by the microbenchmark's MassTreeIndex; marking any other
+// counter compiles to nothing. tc_gc is only marked when RCU garbage is
+// freed. The others are marked on every operation, so they are only kept
+// with INDEX_COLLECT_STATISTICS
+static_assert(int(tc_max) <= 64, "threadcounter_mask has 64 bits");
+static constexpr uint64_t threadcounter_mask = (uint64_t(1) << tc_gc)
+#ifdef INDEX_COLLECT_STATISTICS
+    | (uint64_t(1) << tc_root_retry)
+    | (uint64_t(1) << tc_internode_retry)
+    | (uint64_t(1) << tc_leaf_retry)
+    | (uint64_t(1) << tc_split_leaf)
+    | (uint64_t(1) << tc_split_internode)
+    | (uint64_t(1) << tc_remove_leaf)
+    | (uint64_t(1) << tc_reach_leaf)
+    | (uint64_t(1) << tc_reach_internode)
+#endif
+    ;
+
 template <int N> struct has_threadcounter {
     static bool test(threadcounter ci) {
-        return unsigned(ci) < unsigned(N);
+        return unsigned(ci) < unsigned(N)
+            && ((threadcounter_mask >> unsigned(ci)) & 1);
     }
 };
 template <> struct has_threadcounter<0> {
@@ -206,7 +225,11 @@ class threadinfo {
     uint64_t limbo;
 
     static threadinfo *make(int purpose, int index);
-    // XXX destructor
+    // Releases a threadinfo created by make(): drains its limbo list,
+    // frees its pools and limbo groups and unlinks it from allthreads.
+    // Not thread safe; no other thread may be running make() or
+    // destroy(), or using the tree this threadinfo touched.
+    static void destroy(threadinfo *ti);
     static pthread_key_t key;
 
     // thread information
@@ -473,6 +496,13 @@ class threadinfo {
   }
 
     // RCU
+    // Frees every pending limbo entry regardless of epoch, including
+    // entries that callbacks enqueue while running. Only safe once no
+    // other thread can reach the freed memory.
+    void rcu_drain();
+    // Number of entries waiting in limbo
+    size_t limbo_count() const;
+
     void rcu_start() {
         if (gc_epoch_ != globalepoch)
             gc_epoch_ = globalepoch;
@@ -535,8 +565,7 @@ class threadinfo {
     limbo_group *limbo_tail_;
     mutable kvtimestamp_t ts_;
 
-    //enum { ncounters = (int) tc_max };
-    enum { ncounters = 0 };
+    enum { ncounters = (int) tc_max };
     uint64_t counters_[ncounters];
 
     void* (*thread_func_)(threadinfo*);
@@ -171,6 +171,7 @@ bool tcursor<P>::remove_leaf(leaf_type* leaf, node_type* root,
 
     // mark leaf deleted, RCU-free
     leaf->mark_deleted();
+    ti.mark(tc_remove_leaf);
     //leaf->deallocate_rcu(ti);
 
     // Ensure node that becomes responsible for our keys has its node_ts_ kept
@@ -272,6 +273,15 @@ void tcursor<P>::collapse(internode_type* p, ikey_type ikey,
     }
 }
 
+// Row values are freed with the tree; an inline value has nothing to free
+template <typename V, typename TI>
+inline void destroy_leaf_value(V* value, TI& ti) {
+    value->deallocate_rcu(ti);
+}
+template <typename TI>
+inline void destroy_leaf_value(uint64_t, TI&) {
+}
+
 template <typename P>
 struct destroy_rcu_callback : public P::threadinfo_type::rcu_callback {
     typedef typename P::threadinfo_type threadinfo;
@@ -340,7 +350,7 @@ void destroy_rcu_callback<P>::operator()(threadinfo& ti) {
                 if (l->is_layer(p))
                     enqueue(l->lv_[p].layer(), tailp);
 		else
-		  (l->lv_[p].value())->deallocate_rcu(ti);
+		  destroy_leaf_value(l->lv_[p].value(), ti);
             }
 	    //std::cout << "destroying--LEAF\n";
             l->deallocate(ti);
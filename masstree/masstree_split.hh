@@ -187,6 +187,7 @@ node_base<P>* tcursor<P>::finish_split(threadinfo& ti)
     ikey_type xikey[2];
     int split_type = n_->split_into(static_cast<leaf_type *>(child),
                                     ki_, ka_, xikey[0], ti);
+    ti.mark(tc_split_leaf);
     bool sense = false;
 
     while (1) {
@@ -215,6 +216,7 @@ node_base<P>* tcursor<P>::finish_split(threadinfo& ti)
                 next_child->mark_nonroot();
                 kp = p->split_into(next_child, kp, xikey[sense],
                                    child, xikey[!sense], split_type);
+                ti.mark(tc_split_internode);
             }
 
             if (kp >= 0) {
@@ -606,6 +606,7 @@ inline leaf<P>* node_base<P>::reach_leaf(const key_type& ka,
     const node_base<P> *n[2];
     typename node_base<P>::nodeversion_type v[2];
     bool sense;
+    ti.mark(tc_reach_leaf);
 
     // Get a non-stale root.
     // Detect staleness by checking whether n has ever split.
@@ -624,6 +625,7 @@ inline leaf<P>* node_base<P>::reach_leaf(const key_type& ka,
     // Loop over internal nodes.
     while (!v[sense].isleaf()) {
         const internode<P> *in = static_cast<const internode<P> *>(n[sense]);
+        ti.mark(tc_reach_internode);
         in->prefetch();
         int kp = internode<P>::bound_type::upper(ka, *in);
         n[!sense] = in->child_[kp];
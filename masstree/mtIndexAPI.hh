@@ -72,18 +72,16 @@
 template <typename T>
 class mt_index {
 public:
-  mt_index() {}
+  mt_index() : table_(NULL), ti_(NULL) {}
+  // Tears the tree down through the threadinfo passed to setup(). The
+  // caller must have stopped all other threads using the tree; their
+  // threadinfos are still owned (and destroyed) by the caller
   ~mt_index() {
-/*
+    if (table_ == NULL)
+      return;
     table_->destroy(*ti_);
+    ti_->rcu_drain();
     delete table_;
-    ti_->rcu_clean();
-    ti_->deallocate_ti();
-    free(ti_);
-    if (cur_key_)
-      free(cur_key_);
-*/    
-    return;
   }
 
   //#####################################################################################
@@ -96,6 +94,7 @@ public:
   }
 
   inline void setup(threadinfo *ti) {
+    ti_ = ti;
     table_ = new T;
     table_->initialize(*ti);
 
@@ -231,8 +230,67 @@ public:
     return count;
   }
 
+  //#################################################################################
+  // Scan with visitor (ordered; no result buffer, the visitor is inlined
+  // into the traversal and called as visitor(key, value) for each entry
+  // where value is the table's value_type)
+  //#################################################################################
+  template <typename F>
+  struct visitor_scanner {
+    F &visitor;
+    int range;
+
+    visitor_scanner(F &visitor, int range)
+      : visitor(visitor), range(range) {
+    }
+
+    template <typename SS2, typename K2>
+    void visit_leaf(const SS2&, const K2&, threadinfo&) {}
+    template <typename V>
+    bool visit_value(Str key, V value, threadinfo&) {
+        visitor(key, value);
+        return --range > 0;
+    }
+  };
+  template <typename F>
+  int scan_visit(const char *key, int keylen, int range, F &visitor, threadinfo *ti) {
+    if (range == 0)
+      return 0;
+
+    visitor_scanner<F> s(visitor, range);
+    return table_->table().scan(Str(key, keylen), true, s, *ti);
+  }
+
+  //#################################################################################
+  // Inline value (only for tables whose value_type is uint64_t, e.g.
+  // inline_value_table; the payload lives in the leaf, no row is built)
+  //#################################################################################
+  inline void put_inline(const Str &key, uint64_t value, threadinfo *ti) {
+    typename T::cursor_type lp(table_->table(), key);
+    lp.find_insert(*ti);
+    lp.value() = value;
+    lp.finish(1, *ti);
+  }
+
+  void put_inline(const char *key, int keylen, uint64_t value, threadinfo *ti) {
+    put_inline(Str(key, keylen), value, ti);
+  }
+
+  inline bool get_inline(const Str &key, uint64_t &value, threadinfo *ti) {
+    typename T::unlocked_cursor_type lp(table_->table(), key);
+    bool found = lp.find_unlocked(*ti);
+    if (found)
+      value = lp.value();
+    return found;
+  }
+
+  bool get_inline(const char *key, int keylen, uint64_t &value, threadinfo *ti) {
+    return get_inline(Str(key, keylen), value, ti);
+  }
+
 private:
   T *table_;
+  threadinfo *ti_;
   query<row_type> q_[1];
   loginfo::query_times qtimes_;
 };
@@ -49,6 +49,12 @@ enum threadcounter {
     // end tc_stable constants
     tc_internode_lock,
     tc_leaf_lock,
+    tc_split_leaf,
+    tc_split_internode,
+    tc_remove_leaf,
+    // reach_leaf() descents and the internodes they passed
+    tc_reach_leaf,
+    tc_reach_internode,
     tc_max
 };
 
@@ -420,5 +420,6 @@ void query_table<P>::print(FILE *f, int indent) const {
 
 template class basic_table<default_table::param_type>;
 template class query_table<default_table::param_type>;
+template class basic_table<inline_value_table::param_type>;
 
 }
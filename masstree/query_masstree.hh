@@ -92,5 +92,14 @@ struct default_query_table_params : public nodeparams<15, 15> {
 
 typedef query_table<default_query_table_params> default_table;
 
+// Leaf value slots hold the 8-byte payload itself instead of a row
+struct inline_value_table_params : public nodeparams<15, 15> {
+    typedef uint64_t value_type;
+    typedef value_print<value_type> value_print_type;
+    typedef ::threadinfo threadinfo_type;
+};
+
+typedef query_table<inline_value_table_params> inline_value_table;
+
 } // namespace Masstree
 #endif
@@ -0,0 +1,385 @@
+
+#ifndef _MEM_MONITOR_H
+#define _MEM_MONITOR_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "perf_counter.h"
+
+/*
+ * mem_monitor.h - Memory traffic and NUMA monitors that do not need root
+ *
+ * PCM (--mem, --numa) programs uncore and offcore MSRs, which is only
+ * possible as root. Otherwise the driver uses these monitors instead:
+ *
+ *   - Memory traffic is estimated from last level cache misses, each of
+ *     which moves one cache line from or to DRAM
+ *   - Local and remote DRAM accesses are read from the generalized "node"
+ *     cache events, which the kernel maps to the offcore response events
+ *     where the PMU has them
+ *
+ * Both are counted per worker thread by perf_monitor::ThreadCounters. If the
+ * PMU is not available page faults and migrations are counted instead. The
+ * NUMA monitor also compares /proc/self/numa_maps and the numastat of every
+ * node before and after the phase, which does not depend on the PMU at all
+ */
+namespace mem_monitor {
+
+using perf_monitor::EventDesc;
+using perf_monitor::CacheEvent;
+
+static constexpr uint64_t CACHE_LINE_BYTES = 64;
+static constexpr int MAX_NODE_COUNT = 64;
+
+// Indices into the event lists below
+enum {
+  LLC_READ_MISS = 0,
+  LLC_WRITE_MISS,
+};
+
+enum {
+  NODE_READ_ACCESS = 0,
+  NODE_READ_MISS,
+  NODE_WRITE_ACCESS,
+  NODE_WRITE_MISS,
+};
+
+static const EventDesc memory_hardware_event_list[] = {
+  {PERF_TYPE_HW_CACHE,
+   CacheEvent(PERF_COUNT_HW_CACHE_LL,
+              PERF_COUNT_HW_CACHE_OP_READ,
+              PERF_COUNT_HW_CACHE_RESULT_MISS),
+   "llc_read_misses"},
+  {PERF_TYPE_HW_CACHE,
+   CacheEvent(PERF_COUNT_HW_CACHE_LL,
+              PERF_COUNT_HW_CACHE_OP_WRITE,
+              PERF_COUNT_HW_CACHE_RESULT_MISS),
+   "llc_write_misses"},
+};
+
+static const EventDesc memory_software_event_list[] = {
+  {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN, "minor_faults"},
+  {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ, "major_faults"},
+};
+
+// A node access misses if it is served by a remote node
+static const EventDesc numa_hardware_event_list[] = {
+  {PERF_TYPE_HW_CACHE,
+   CacheEvent(PERF_COUNT_HW_CACHE_NODE,
+              PERF_COUNT_HW_CACHE_OP_READ,
+              PERF_COUNT_HW_CACHE_RESULT_ACCESS),
+   "node_read_accesses"},
+  {PERF_TYPE_HW_CACHE,
+   CacheEvent(PERF_COUNT_HW_CACHE_NODE,
+              PERF_COUNT_HW_CACHE_OP_READ,
+              PERF_COUNT_HW_CACHE_RESULT_MISS),
+   "node_read_misses"},
+  {PERF_TYPE_HW_CACHE,
+   CacheEvent(PERF_COUNT_HW_CACHE_NODE,
+              PERF_COUNT_HW_CACHE_OP_WRITE,
+              PERF_COUNT_HW_CACHE_RESULT_ACCESS),
+   "node_write_accesses"},
+  {PERF_TYPE_HW_CACHE,
+   CacheEvent(PERF_COUNT_HW_CACHE_NODE,
+              PERF_COUNT_HW_CACHE_OP_WRITE,
+              PERF_COUNT_HW_CACHE_RESULT_MISS),
+   "node_write_misses"},
+};
+
+static const EventDesc numa_software_event_list[] = {
+  {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS, "cpu_migrations"},
+};
+
+/*
+ * struct NodeSnapshot - NUMA state of the system and of this process
+ */
+struct NodeSnapshot {
+  // One past the highest node found
+  int node_count;
+  bool present[MAX_NODE_COUNT];
+
+  // From /sys/devices/system/node/nodeX/numastat; these are pages allocated
+  // by all processes since boot
+  uint64_t numa_hit[MAX_NODE_COUNT];
+  uint64_t numa_miss[MAX_NODE_COUNT];
+  uint64_t local_node[MAX_NODE_COUNT];
+  uint64_t other_node[MAX_NODE_COUNT];
+
+  // From /proc/self/numa_maps: memory of this process on each node
+  uint64_t mapped_kb[MAX_NODE_COUNT];
+};
+
+/*
+ * ReadNUMAStat() - Reads the allocation counters of every node
+ */
+inline void ReadNUMAStat(NodeSnapshot *snapshot_p) {
+  char path[128];
+  char name[64];
+  unsigned long value;
+
+  for(int node = 0;node < MAX_NODE_COUNT;node++) {
+    snprintf(path,
+             sizeof(path),
+             "/sys/devices/system/node/node%d/numastat",
+             node);
+    FILE *fp = fopen(path, "r");
+    if(fp == nullptr) {
+      continue;
+    }
+
+    snapshot_p->present[node] = true;
+    snapshot_p->node_count = node + 1;
+    while(fscanf(fp, "%63s %lu", name, &value) == 2) {
+      if(strcmp(name, "numa_hit") == 0) {
+        snapshot_p->numa_hit[node] = value;
+      } else if(strcmp(name, "numa_miss") == 0) {
+        snapshot_p->numa_miss[node] = value;
+      } else if(strcmp(name, "local_node") == 0) {
+        snapshot_p->local_node[node] = value;
+      } else if(strcmp(name, "other_node") == 0) {
+        snapshot_p->other_node[node] = value;
+      }
+    }
+
+    fclose(fp);
+  }
+
+  return;
+}
+
+/*
+ * ReadNUMAMaps() - Sums up the pages of every mapping of this process by
+ *                  the node they are on
+ *
+ * Each line lists the pages on node X as "NX=pages" followed by the page
+ * size as "kernelpagesize_kB=size"
+ */
+inline void ReadNUMAMaps(NodeSnapshot *snapshot_p) {
+  FILE *fp = fopen("/proc/self/numa_maps", "r");
+  if(fp == nullptr) {
+    return;
+  }
+
+  char *line = nullptr;
+  size_t line_size = 0;
+  uint64_t page_list[MAX_NODE_COUNT];
+  while(getline(&line, &line_size, fp) != -1) {
+    memset(page_list, 0, sizeof(page_list));
+    uint64_t page_kb = 4;
+
+    char *save_p = nullptr;
+    for(char *token = strtok_r(line, " \n", &save_p);
+        token != nullptr;
+        token = strtok_r(nullptr, " \n", &save_p)) {
+      int node;
+      unsigned long value;
+      if(sscanf(token, "N%d=%lu", &node, &value) == 2) {
+        if(node >= 0 && node < MAX_NODE_COUNT) {
+          page_list[node] += value;
+        }
+      } else if(sscanf(token, "kernelpagesize_kB=%lu", &value) == 1) {
+        page_kb = value;
+      }
+    }
+
+    for(int node = 0;node < MAX_NODE_COUNT;node++) {
+      snapshot_p->mapped_kb[node] += page_list[node] * page_kb;
+    }
+  }
+
+  free(line);
+  fclose(fp);
+
+  return;
+}
+
+/*
+ * struct PhaseState - What the monitors remember from the start of a phase
+ */
+struct PhaseState {
+  std::chrono::steady_clock::time_point memory_start_time;
+  NodeSnapshot numa_start;
+};
+
+inline PhaseState &GetPhaseState() {
+  static PhaseState phase_state{};
+  return phase_state;
+}
+
+/*
+ * InitMemoryMonitor() - Chooses the events; call this once before the first
+ *                       phase
+ */
+inline void InitMemoryMonitor() {
+  perf_monitor::SelectEvents(
+    perf_monitor::MEMORY_MONITOR,
+    memory_hardware_event_list,
+    (int)(sizeof(memory_hardware_event_list) / sizeof(EventDesc)),
+    memory_software_event_list,
+    (int)(sizeof(memory_software_event_list) / sizeof(EventDesc)));
+
+  return;
+}
+
+inline void StartMemoryMonitor() {
+  perf_monitor::ResetTotals(perf_monitor::MEMORY_MONITOR);
+  GetPhaseState().memory_start_time = std::chrono::steady_clock::now();
+
+  return;
+}
+
+/*
+ * EndMemoryMonitor() - Prints the estimated traffic of the phase
+ */
+inline void EndMemoryMonitor() {
+  const perf_monitor::MonitorState &state = \
+    perf_monitor::GetState(perf_monitor::MEMORY_MONITOR);
+  if(state.enabled == false) {
+    return;
+  }
+
+  std::chrono::duration<double> duration = \
+    std::chrono::steady_clock::now() - GetPhaseState().memory_start_time;
+  double seconds = duration.count();
+
+  uint64_t value;
+  if(state.hardware == true) {
+    fprintf(stderr, "Memory traffic (estimated from LLC misses):");
+    static const char *direction_list[] = {"read", "write"};
+    for(int i = LLC_READ_MISS;i <= LLC_WRITE_MISS;i++) {
+      if(perf_monitor::GetTotal(perf_monitor::MEMORY_MONITOR, i, &value)) {
+        double mb = (double)(value * CACHE_LINE_BYTES) / (1024.0 * 1024.0);
+        fprintf(stderr,
+                " %s = %.2f MB (%.2f MB/s);",
+                direction_list[i],
+                mb,
+                mb / seconds);
+      } else {
+        fprintf(stderr, " %s = n/a;", direction_list[i]);
+      }
+    }
+  } else {
+    // Without a PMU only first touches of pages are visible
+    fprintf(stderr, "Memory traffic not measurable; page faults:");
+    for(int i = 0;i < state.event_count;i++) {
+      if(perf_monitor::GetTotal(perf_monitor::MEMORY_MONITOR, i, &value)) {
+        fprintf(stderr, " %s = %lu;", state.event_list[i].name, value);
+      } else {
+        fprintf(stderr, " %s = n/a;", state.event_list[i].name);
+      }
+    }
+  }
+
+  fprintf(stderr, "\n");
+
+  return;
+}
+
+/*
+ * InitNUMAMonitor() - Chooses the events; call this once before the first
+ *                     phase
+ */
+inline void InitNUMAMonitor() {
+  perf_monitor::SelectEvents(
+    perf_monitor::NUMA_MONITOR,
+    numa_hardware_event_list,
+    (int)(sizeof(numa_hardware_event_list) / sizeof(EventDesc)),
+    numa_software_event_list,
+    (int)(sizeof(numa_software_event_list) / sizeof(EventDesc)));
+
+  NodeSnapshot snapshot{};
+  ReadNUMAStat(&snapshot);
+  if(snapshot.node_count == 0) {
+    fprintf(stderr, "  No NUMA node found in sysfs\n");
+  }
+
+  return;
+}
+
+inline void StartNUMAMonitor() {
+  perf_monitor::ResetTotals(perf_monitor::NUMA_MONITOR);
+
+  NodeSnapshot &start = GetPhaseState().numa_start;
+  memset(&start, 0, sizeof(start));
+  ReadNUMAStat(&start);
+  ReadNUMAMaps(&start);
+
+  return;
+}
+
+/*
+ * EndNUMAMonitor() - Prints local and remote DRAM accesses of the phase, and
+ *                    for each node the pages allocated during the phase
+ */
+inline void EndNUMAMonitor() {
+  NodeSnapshot end;
+  memset(&end, 0, sizeof(end));
+  ReadNUMAStat(&end);
+  ReadNUMAMaps(&end);
+
+  const NodeSnapshot &start = GetPhaseState().numa_start;
+
+  uint64_t access, miss;
+  const perf_monitor::MonitorState &state = \
+    perf_monitor::GetState(perf_monitor::NUMA_MONITOR);
+  if(state.enabled == true && state.hardware == true) {
+    fprintf(stderr, "DRAM accesses:");
+    static const char *op_list[] = {"read", "write"};
+    for(int op = 0;op < 2;op++) {
+      if(perf_monitor::GetTotal(perf_monitor::NUMA_MONITOR,
+                                NODE_READ_ACCESS + op * 2,
+                                &access) && \
+         perf_monitor::GetTotal(perf_monitor::NUMA_MONITOR,
+                                NODE_READ_MISS + op * 2,
+                                &miss)) {
+        fprintf(stderr,
+                " %s local = %lu, remote = %lu;",
+                op_list[op],
+                (access > miss) ? access - miss : 0UL,
+                miss);
+      } else {
+        fprintf(stderr, " %s = n/a;", op_list[op]);
+      }
+    }
+
+    fprintf(stderr, "\n");
+  } else if(state.enabled == true) {
+    uint64_t migration_count;
+    if(perf_monitor::GetTotal(perf_monitor::NUMA_MONITOR,
+                              0,
+                              &migration_count)) {
+      fprintf(stderr,
+              "DRAM accesses not measurable; cpu migrations = %lu\n",
+              migration_count);
+    }
+  }
+
+  // The numastat counters are in pages
+  for(int node = 0;node < end.node_count;node++) {
+    if(end.present[node] == false) {
+      continue;
+    }
+
+    fprintf(stderr,
+            "Node %d: numa_hit = %lu; numa_miss = %lu; local_node = %lu; "
+            "other_node = %lu; process memory = %.2f MB (%+.2f MB)\n",
+            node,
+            end.numa_hit[node] - start.numa_hit[node],
+            end.numa_miss[node] - start.numa_miss[node],
+            end.local_node[node] - start.local_node[node],
+            end.other_node[node] - start.other_node[node],
+            end.mapped_kb[node] / 1024.0,
+            ((double)end.mapped_kb[node] - (double)start.mapped_kb[node]) / \
+              1024.0);
+  }
+
+  return;
+}
+
+} // namespace mem_monitor
+
+#endif
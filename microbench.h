@@ -7,7 +7,6 @@
 #include <utility>
 #include <time.h>
 #include <sys/time.h>
-#include <papi.h>
 
 #include "allocatortracker.h"
 
@@ -17,7 +16,4 @@
 #define INIT_LIMIT 50000000
 #define LIMIT 10000000
 
-//#define PAPI_IPC 1
-//#define PAPI_CACHE 1
-
 #endif
@@ -53,6 +53,19 @@ can interrupt other threads trying to traverse the list, as the background
 thread may cause cache invalidations in other threads and cause costly
 reads from memory to occur.
 
+When the list grows quickly (e.g. a bulk load by many worker threads)
+a single maintenance thread cannot keep up and traversals degrade
+towards linear scans of the node level. The maintenance can therefore
+be split across several background threads (see bg_set_threads()).
+Each loop partitions the list by key range, using evenly spaced tall
+nodes of one index level as boundaries. Every thread then traverses,
+deletes and raises only inside its own range, and links new index items
+only behind index nodes of its own range, so that no two threads ever
+write the same pointer. Levels above the partition level, and adding or
+removing whole levels, are still handled by thread 0 alone. The sleep
+time between loops adapts to the number of node-level raises of the
+previous loop, which approximates how far the index is lagging behind.
+
 */
 
 #include <stdlib.h>
@@ -60,6 +73,7 @@ reads from memory to occur.
 #include <assert.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <sys/time.h>
 
 #include "background.h"
 #include "skiplist.h"
@@ -70,11 +84,26 @@ reads from memory to occur.
 /* - Private variables - */
 
 static set_t *set;	        /* the set to maintain */
-static pthread_t bg_thread;	/* background thread */
 
 /* Uncomment to collect background stats - reduces performance */
 /* #define BG_STATS */
 
+/* upper bound on the number of background threads */
+#define BG_MAX_THREADS 64
+
+/* a level must have this many index items per thread to be split */
+#define BG_PART_MIN_ITEMS 4
+
+/* node-level raises per loop above which we consider ourselves behind */
+#define BG_BACKLOG_THRESHOLD 64
+
+/* upper bound of the adaptive sleep time (in us) */
+#define BG_MAX_SLEEP_TIME 10000
+
+/* index height samples kept, and minimum distance between them (in s) */
+#define BG_MAX_SAMPLES 512
+#define BG_SAMPLE_INTERVAL 0.25
+
 typedef struct bg_stats bg_stats_t;
 static struct bg_stats {
         int raises;
@@ -83,6 +112,52 @@ static struct bg_stats {
         int delete_succeeds;
 } bg_stats;
 
+/*
+ * A partition is a key range [starts[0]->node->key, hi) of the skip list
+ * that one background thread maintains exclusively. starts[i] is the
+ * first index node of the partition at level i; all partitions except the
+ * first begin at the tower of a tall node, so that every index node a
+ * thread links a new item after lies inside its own range.
+ */
+typedef struct bg_part bg_part_t;
+struct bg_part {
+        inode_t *starts[MAX_LEVELS];
+        sl_key_t hi;            /* exclusive upper bound */
+        int has_hi;             /* 0 for the last partition */
+        int non_deleted;
+        int tall_deleted;
+        int nraised;            /* number of node-level raises */
+        int raised[MAX_LEVELS]; /* [0] = node level, [i + 1] = ilevel i */
+        CACHE_PAD(0);
+};
+
+typedef struct bg_sample bg_sample_t;
+struct bg_sample {
+        double time;            /* seconds since bg_start() */
+        int height;             /* number of index levels */
+        int parts;              /* partitions used by the loop */
+        int nodes;              /* non-deleted nodes at the node level */
+        int nraised;            /* node-level raises in the loop */
+        int sleep_time;         /* sleep chosen for the next loop */
+        double steps_per_op;    /* since the previous sample */
+};
+
+static pthread_t bg_threads[BG_MAX_THREADS];
+static bg_part_t bg_parts[BG_MAX_THREADS];
+
+/* unbounded, for the levels above the partition level */
+static bg_part_t bg_whole;
+static pthread_barrier_t bg_barrier;
+
+/* number of threads for the next bg_start(), and for the running one */
+static int bg_num_threads = 1;
+static int bg_nthreads;
+
+/* the plan for the current loop, written by thread 0 only */
+static int bg_nparts;
+static int bg_plevels;          /* index levels raised in parallel */
+static int bg_exit;
+
 /* to keep track of background state */
 static int bg_finished;
 static int bg_running;
@@ -91,150 +166,345 @@ static int bg_running;
 static int bg_non_deleted;
 static int bg_tall_deleted;
 
-/* the amount of time the bg thread sleeps for each iteration */
+/* node-level raises of the last loop, i.e. the pending-raise backlog */
+static int bg_nraised;
+
+/* the minimum and the current amount of time the bg thread sleeps */
 static int bg_sleep_time;
+static int bg_cur_sleep;
+
+/* published by the worker threads through bg_add_steps() */
+static volatile AO_t bg_total_steps;
+static volatile AO_t bg_total_ops;
+
+/* ring buffer of index height samples */
+static pthread_mutex_t bg_sample_lock = PTHREAD_MUTEX_INITIALIZER;
+static bg_sample_t bg_samples[BG_MAX_SAMPLES];
+static int bg_sample_count;
+static double bg_start_time;
+static double bg_last_sample;
+static long bg_last_steps;
+static long bg_last_ops;
 
 /* - Private Functions - */
 
 static void* bg_loop(void *args);
-static void bg_trav_nodes(ptst_t *ptst);
+static void bg_plan(inode_t **inodes);
+static void bg_finish_loop(inode_t **inodes, ptst_t *ptst);
+static void bg_trav_nodes(bg_part_t *part, ptst_t *ptst);
 static void bg_lower_ilevel(inode_t *new_low, ptst_t *ptst);
-static int bg_raise_nlevel(inode_t *inode, ptst_t *ptst);
-static int bg_raise_ilevel(inode_t *iprev,inode_t *iprev_tall,
-                           int height, ptst_t *ptst);
+static int bg_raise_nlevel(bg_part_t *part, ptst_t *ptst);
+static int bg_raise_ilevel(bg_part_t *part, inode_t *iprev,
+                           inode_t *iprev_tall, int height, ptst_t *ptst);
+static void bg_sample(void);
+
+/**
+ * bg_now - wall clock time in seconds
+ */
+static double bg_now(void)
+{
+        struct timeval tv;
+
+        gettimeofday(&tv, NULL);
+        return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/**
+ * bg_in_range - whether @node falls inside the range of @part
+ * @part: the partition
+ * @node: the node to check
+ */
+static inline int bg_in_range(bg_part_t *part, node_t *node)
+{
+        return !part->has_hi || node->key < part->hi;
+}
 
 /**
  * bg_loop - loop for maintaining index levels
- * @args: void* args as per pthread_create requirements
+ * @args: the id of this background thread, cast to void*
  *
  * Returns a void* value as per pthread_create requirements.
- * Note: Do this loop forever while the program is running.
+ * Note: Do this loop forever while the program is running. Thread 0
+ * plans each loop and performs the steps that change the shape of the
+ * whole index (adding and removing levels); all threads then maintain
+ * their own partition in lock step, separated by barriers.
  */
 static void* bg_loop(void *args)
 {
-        inode_t *inode;
-        inode_t *inew;
+        long id = (long)args;
         inode_t *inodes[MAX_LEVELS];
-        int raised = 0; /* keep track of if we raised index level */
-        int threshold;  /* for testing if we should lower index level */
-        int i;
+        bg_part_t *part = &bg_parts[id];
+        int i, nparts, plevels;
         struct sl_ptst *ptst;
 
         assert(NULL != set);
 
         while (1) {
-                if (bg_finished)
+                if (0 == id) {
+                        if (bg_finished) {
+                                bg_exit = 1;
+                        } else {
+                                usleep(bg_cur_sleep);
+                                bg_plan(inodes);
+                        }
+                }
+
+                pthread_barrier_wait(&bg_barrier);
+                if (bg_exit)
                         break;
 
-                usleep(bg_sleep_time);
+                /* thread 0 may plan the next loop before we finish */
+                nparts = bg_nparts;
+                plevels = bg_plevels;
 
                 #ifdef USE_GC
                 ptst = ptst_critical_enter();
                 #endif
 
-                for (i = 0; i < MAX_LEVELS; i++)
-                        inodes[i] = NULL;
+                /* traverse the node level and do physical deletes */
+                if (id < nparts)
+                        bg_trav_nodes(part, ptst);
 
-                #ifdef BG_STATS
-                ++bg_stats.loops;
+                /* raise bottom level nodes */
+                if (id < nparts)
+                        part->raised[0] = bg_raise_nlevel(part, ptst);
+
+                pthread_barrier_wait(&bg_barrier);
+
+                /* raise the index levels below the partition level */
+                for (i = 0; i < plevels; i++) {
+                        if (id < nparts)
+                                part->raised[i + 1] =
+                                        bg_raise_ilevel(part,
+                                                        part->starts[i],
+                                                        part->starts[i + 1],
+                                                        i + 1,
+                                                        ptst);
+                        pthread_barrier_wait(&bg_barrier);
+                }
+
+                if (0 == id)
+                        bg_finish_loop(inodes, ptst);
+
+                #ifdef USE_GC
+                ptst_critical_exit(ptst);
                 #endif
+        }
 
-                bg_non_deleted = 0;
-                bg_tall_deleted = 0;
+        return NULL;
+}
 
-                /* traverse the node level and do physical deletes */
-                bg_trav_nodes(ptst);
+/**
+ * bg_plan - split the skip list into partitions for this loop
+ * @inodes: receives the first index node at each level
+ *
+ * Note: only called by thread 0 while the other threads wait at the
+ * barrier. We look for the highest index level that has enough items
+ * to give every thread a share, and use evenly spaced items of that
+ * level as partition boundaries. Levels up to and including that one
+ * contain the towers of all boundaries and can be raised in parallel.
+ */
+static void bg_plan(inode_t **inodes)
+{
+        inode_t *inode;
+        int i, j, s, count, step;
 
-                assert(set->head->level < MAX_LEVELS);
+        #ifdef BG_STATS
+        ++bg_stats.loops;
+        #endif
+
+        assert(set->head->level < MAX_LEVELS);
 
-                /* get the first index node at each level */
-                inode = set->top;
+        for (i = 0; i < MAX_LEVELS; i++)
+                inodes[i] = NULL;
+
+        /* get the first index node at each level */
+        inode = set->top;
+        for (i = set->head->level - 1; i >= 0; i--) {
+                inodes[i] = inode;
+                assert(NULL != inodes[i]);
+                inode = inode->down;
+        }
+        assert(NULL == inode);
+
+        /* find the partition level */
+        s = -1;
+        count = 0;
+        if (bg_nthreads > 1) {
                 for (i = set->head->level - 1; i >= 0; i--) {
-                        inodes[i] = inode;
-                        assert(NULL != inodes[i]);
-                        inode = inode->down;
+                        count = 0;
+                        for (inode = inodes[i]; NULL != inode;
+                             inode = inode->right)
+                                ++count;
+                        if (count >= bg_nthreads * BG_PART_MIN_ITEMS) {
+                                s = i;
+                                break;
+                        }
                 }
-                assert(NULL == inode);
+        }
 
-                /* raise bottom level nodes */
-                raised = bg_raise_nlevel(inodes[0], ptst);
+        for (i = 0; i < MAX_LEVELS; i++)
+                bg_parts[0].starts[i] = inodes[i];
+        bg_parts[0].has_hi = 0;
 
-                if (raised && (1 == set->head->level)) {
-                        /* add a new index level */
-                        inew = inode_new(NULL, set->top, set->head, ptst);
-                        set->top = inew;
-                        ++set->head->level;
-                        assert(NULL == inodes[1]);
-                        inodes[1] = set->top;
+        if (s < 0) {
+                /* too small to split - maintain everything in thread 0 */
+                bg_nparts = 1;
+                bg_plevels = set->head->level - 1;
+                return;
+        }
 
-                        #ifdef BG_STATS
-                        ++bg_stats.raises;
-                        #endif
+        /* pick the boundaries and walk down their towers */
+        step = count / bg_nthreads;
+        inode = inodes[s];
+        for (j = 1; j < bg_nthreads; j++) {
+                for (i = 0; i < step; i++)
+                        inode = inode->right;
+
+                bg_parts[j - 1].hi = inode->node->key;
+                bg_parts[j - 1].has_hi = 1;
+                bg_parts[j].has_hi = 0;
+
+                bg_parts[j].starts[s] = inode;
+                for (i = s - 1; i >= 0; i--) {
+                        bg_parts[j].starts[i] = bg_parts[j].starts[i + 1]->down;
+                        assert(NULL != bg_parts[j].starts[i]);
                 }
+        }
 
-                /* raise the index level nodes */
-                for (i = 0; i < (set->head->level - 1); i++) {
-                        assert(i < MAX_LEVELS-1);
-                        raised = bg_raise_ilevel(inodes[i],/* level raised */
-                                                 inodes[i + 1],/* level above */
-                                                 i + 1,/* current height */
-                                                 ptst);
-                }
+        bg_nparts = bg_nthreads;
+        bg_plevels = s;
+}
 
-                if (raised) {
-                        /* add a new index level */
-                        inew = inode_new(NULL, set->top, set->head, ptst);
-                        set->top = inew;
-                        ++set->head->level;
+/**
+ * bg_finish_loop - finish a maintenance loop after the parallel phase
+ * @inodes: the first index node at each level, as computed by bg_plan()
+ * @ptst: per-thread state
+ *
+ * Note: only called by thread 0. Raises the index levels above the
+ * partition level over the whole key range, adds or removes whole
+ * levels, and adapts the sleep time to the node-level raise backlog.
+ */
+static void bg_finish_loop(inode_t **inodes, ptst_t *ptst)
+{
+        inode_t *inew;
+        int raised = 0; /* keep track of if we raised index level */
+        int threshold;  /* for testing if we should lower index level */
+        int i, p;
+
+        bg_non_deleted = 0;
+        bg_tall_deleted = 0;
+        bg_nraised = 0;
+        for (p = 0; p < bg_nparts; p++) {
+                bg_non_deleted += bg_parts[p].non_deleted;
+                bg_tall_deleted += bg_parts[p].tall_deleted;
+                bg_nraised += bg_parts[p].nraised;
+                raised |= bg_parts[p].raised[0];
+        }
 
-                        #ifdef BG_STATS
-                        ++bg_stats.raises;
-                        #endif
-                }
+        if (raised && (1 == set->head->level)) {
+                /* add a new index level */
+                inew = inode_new(NULL, set->top, set->head, ptst);
+                set->top = inew;
+                ++set->head->level;
+                assert(NULL == inodes[1]);
+                inodes[1] = set->top;
 
-                /* if needed, remove the lowest index level */
-                threshold = bg_non_deleted * 10;
-                if (bg_tall_deleted > threshold) {
-                        if (NULL != inodes[1]) {
-                                bg_lower_ilevel(inodes[1],/* level above */
-                                                ptst);
+                #ifdef BG_STATS
+                ++bg_stats.raises;
+                #endif
+        }
 
-                                #ifdef BG_STATS
-                                ++bg_stats.lowers;
-                                #endif
-                        }
-                }
+        /* the parallel levels, and then the rest of the index levels */
+        for (i = 0; i < bg_plevels; i++) {
+                raised = 0;
+                for (p = 0; p < bg_nparts; p++)
+                        raised |= bg_parts[p].raised[i + 1];
+        }
 
-                #ifdef USE_GC
-                ptst_critical_exit(ptst);
+        for (i = bg_plevels; i < (set->head->level - 1); i++) {
+                assert(i < MAX_LEVELS-1);
+                raised = bg_raise_ilevel(&bg_whole,
+                                         inodes[i],/* level raised */
+                                         inodes[i + 1],/* level above */
+                                         i + 1,/* current height */
+                                         ptst);
+        }
+
+        if (raised) {
+                /* add a new index level */
+                inew = inode_new(NULL, set->top, set->head, ptst);
+                set->top = inew;
+                ++set->head->level;
+
+                #ifdef BG_STATS
+                ++bg_stats.raises;
                 #endif
         }
 
-        return NULL;
+        /* if needed, remove the lowest index level */
+        threshold = bg_non_deleted * 10;
+        if (bg_tall_deleted > threshold) {
+                if (NULL != inodes[1]) {
+                        bg_lower_ilevel(inodes[1],/* level above */
+                                        ptst);
+
+                        #ifdef BG_STATS
+                        ++bg_stats.lowers;
+                        #endif
+                }
+        }
+
+        /* back off while the index keeps pace, catch up otherwise */
+        if (bg_nraised > BG_BACKLOG_THRESHOLD)
+                bg_cur_sleep = bg_sleep_time;
+        else if (bg_cur_sleep < BG_MAX_SLEEP_TIME)
+                bg_cur_sleep = bg_cur_sleep * 2 + 1;
+
+        if (bg_cur_sleep > BG_MAX_SLEEP_TIME)
+                bg_cur_sleep = BG_MAX_SLEEP_TIME;
+        if (bg_cur_sleep < bg_sleep_time)
+                bg_cur_sleep = bg_sleep_time;
+
+        bg_sample();
 }
 
 /**
- * bg_trav_nodes - traverse node level of skip list and maintain
+ * bg_trav_nodes - traverse node level of a partition and maintain
+ * @part: the partition to traverse
  * @ptst: per-thread state
  * 
- * Note: this will try to remove each of the nodes in the list,
+ * Note: this will try to remove each of the nodes in the partition,
  * in order to extract nodes that have already been logically deleted
- * but that are still accessible.
+ * but that are still accessible. The first node of a partition is tall
+ * and therefore never removed here.
  */
-static void bg_trav_nodes(ptst_t *ptst)
+static void bg_trav_nodes(bg_part_t *part, ptst_t *ptst)
 {
         node_t *prev, *node;
 
         assert(NULL != set && NULL != set->head);
 
-        prev = set->head;
+        part->non_deleted = 0;
+        part->tall_deleted = 0;
+
+        prev = part->starts[0]->node;
         node = prev->next;
-        while (NULL != node) {
+
+        /* the boundary node is counted by the partition it starts */
+        if (prev != set->head) {
+                if (NULL != prev->val && prev != prev->val)
+                        ++part->non_deleted;
+                else
+                        ++part->tall_deleted;
+        }
+
+        while (NULL != node && bg_in_range(part, node)) {
                 bg_remove(prev, node, ptst);
                 if (NULL != node->val && node != node->val)
-                        ++bg_non_deleted;
+                        ++part->non_deleted;
                 else if (node->level >= 1)
-                        ++bg_tall_deleted;
+                        ++part->tall_deleted;
                 prev = node;
                 node = node->next;
         }
@@ -242,30 +512,32 @@ static void bg_trav_nodes(ptst_t *ptst)
 
 /**
  * bg_raise_nlevel - raise level 0 nodes into index levels 
- * @inode: the index node at the start of the bottom index level
+ * @part: the partition to raise
  * @ptst: per-thread state
  *
  * Returns 1 if a node was raised and 0 otherwise.
  */
-static int bg_raise_nlevel(inode_t *inode, ptst_t *ptst)
+static int bg_raise_nlevel(bg_part_t *part, ptst_t *ptst)
 {
         int raised = 0;
         node_t *prev, *node, *next;
-        inode_t *inew, *above, *above_prev;
+        inode_t *inode, *inew, *above, *above_prev;
 
+        inode = part->starts[0];
         above = above_prev = inode;
+        part->nraised = 0;
 
         assert(NULL != inode);
 
-        prev = set->head;
-        node = set->head->next;
+        prev = inode->node;
+        node = prev->next;
 
         if (NULL == node)
                 return 0;
 
         next = node->next;
 
-        while (NULL != next) {
+        while (NULL != next && bg_in_range(part, node)) {
                 /* don't raise deleted nodes */
                 if (node != node->val) {
                         if (((prev->level == 0) &&
@@ -273,6 +545,7 @@ static int bg_raise_nlevel(inode_t *inode, ptst_t *ptst)
                              (next->level == 0)) {
 
                                 raised = 1;
+                                ++part->nraised;
 
                                 /* get the correct index above and behind */
                                 while (above && above->node->key < node->key) {
@@ -300,6 +573,7 @@ static int bg_raise_nlevel(inode_t *inode, ptst_t *ptst)
 
 /**
  * bg_raise_ilevel - raise the index levels
+ * @part: the partition being raised
  * @iprev: the first index node at this level
  * @iprev_tall: the first index node at the next highest level
  * @height: the height of the level we are raising
@@ -307,8 +581,8 @@ static int bg_raise_nlevel(inode_t *inode, ptst_t *ptst)
  *
  * Returns 1 if a node was raised and 0 otherwise.
  */
-static int bg_raise_ilevel(inode_t *iprev, inode_t *iprev_tall,
-                           int height, ptst_t *ptst)
+static int bg_raise_ilevel(bg_part_t *part, inode_t *iprev,
+                           inode_t *iprev_tall, int height, ptst_t *ptst)
 {
         int raised = 0;
         inode_t *index, *inext, *inew, *above, *above_prev;
@@ -320,12 +594,16 @@ static int bg_raise_ilevel(inode_t *iprev, inode_t *iprev_tall,
 
         index = iprev->right;
 
-        while ((NULL != index) && (NULL != (inext = index->right))) {
+        while ((NULL != index) && bg_in_range(part, index->node) &&
+               (NULL != (inext = index->right))) {
                 while (index->node->val == index->node) {
                         /* skip deleted nodes */
                         iprev->right = inext;
-                        if (NULL == inext)
+                        if (NULL == inext ||
+                            !bg_in_range(part, inext->node)) {
+                                inext = NULL;
                                 break;
+                        }
 
                         index = inext;
                         inext = inext->right;
@@ -384,6 +662,43 @@ void bg_lower_ilevel(inode_t *new_low, ptst_t *ptst)
         }
 }
 
+/**
+ * bg_sample - record the index height and steps per op
+ *
+ * Note: only called by thread 0 at the end of a loop. At most one sample
+ * is kept every BG_SAMPLE_INTERVAL seconds; older samples are overwritten
+ * once the ring buffer is full.
+ */
+static void bg_sample(void)
+{
+        bg_sample_t *sample;
+        double now = bg_now();
+        long steps, ops;
+
+        if (now - bg_last_sample < BG_SAMPLE_INTERVAL)
+                return;
+
+        steps = (long)bg_total_steps;
+        ops = (long)bg_total_ops;
+
+        pthread_mutex_lock(&bg_sample_lock);
+        sample = &bg_samples[bg_sample_count % BG_MAX_SAMPLES];
+        sample->time = now - bg_start_time;
+        sample->height = set->head->level;
+        sample->parts = bg_nparts;
+        sample->nodes = bg_non_deleted;
+        sample->nraised = bg_nraised;
+        sample->sleep_time = bg_cur_sleep;
+        sample->steps_per_op = (ops == bg_last_ops) ? 0.0 :
+                (double)(steps - bg_last_steps) / (double)(ops - bg_last_ops);
+        ++bg_sample_count;
+        pthread_mutex_unlock(&bg_sample_lock);
+
+        bg_last_sample = now;
+        bg_last_steps = steps;
+        bg_last_ops = ops;
+}
+
 /* - Public Background Interface - */
 
 /**
@@ -400,38 +715,136 @@ void bg_init(set_t *s)
         bg_stats.raises = 0;
         bg_stats.lowers = 0;
         bg_stats.delete_succeeds = 0;
+
+        bg_total_steps = 0;
+        bg_total_ops = 0;
+        bg_sample_count = 0;
 }
 
 /**
- * bg_start - start the background thread
- * @sleep_time: the time to sleep the bg thread per iteration
+ * bg_set_threads - set the number of background threads
+ * @num_threads: the number of threads used by the next bg_start()
  *
- * Note: Only starts the background thread if it is not currently
- * running.
+ * Note: each thread maintains its own key range of the skip list;
+ * the default is a single thread as in the original algorithm.
+ */
+void bg_set_threads(int num_threads)
+{
+        if (num_threads < 1)
+                num_threads = 1;
+        if (num_threads > BG_MAX_THREADS)
+                num_threads = BG_MAX_THREADS;
+
+        bg_num_threads = num_threads;
+}
+
+/**
+ * bg_start - start the background threads
+ * @sleep_time: the minimum time to sleep the bg thread per iteration
+ *
+ * Note: Only starts the background threads if they are not currently
+ * running. The actual sleep time backs off up to BG_MAX_SLEEP_TIME
+ * while there is no node-level raise backlog.
  */
 void bg_start(int sleep_time)
 {
+        long i;
+
         if (!bg_running) {
                 bg_running = 1;
                 bg_finished = 0;
+                bg_exit = 0;
                 bg_sleep_time = sleep_time;
-                pthread_create(&bg_thread, NULL, bg_loop, NULL);
+                bg_cur_sleep = sleep_time;
+                bg_nthreads = bg_num_threads;
+
+                bg_start_time = bg_now();
+                bg_last_sample = 0.0;
+                bg_last_steps = (long)bg_total_steps;
+                bg_last_ops = (long)bg_total_ops;
+
+                pthread_barrier_init(&bg_barrier, NULL, bg_nthreads);
+                for (i = 0; i < bg_nthreads; i++)
+                        pthread_create(&bg_threads[i], NULL, bg_loop,
+                                       (void *)i);
         }
 }
 
 /**
- * bg_stop - stop the background thread
+ * bg_stop - stop the background threads
  */
 void bg_stop(void)
 {
+        int i;
+
         if (bg_running) {
                 bg_finished = 1;
-                pthread_join(bg_thread, NULL);
+                for (i = 0; i < bg_nthreads; i++)
+                        pthread_join(bg_threads[i], NULL);
+                pthread_barrier_destroy(&bg_barrier);
                 BARRIER();
                 bg_running = 0;
         }
 }
 
+/**
+ * bg_add_steps - publish traversal steps of a worker thread
+ * @steps: the number of steps taken since the last call
+ * @ops: the number of operations those steps belong to
+ */
+void bg_add_steps(long steps, long ops)
+{
+        AO_fetch_and_add_full(&bg_total_steps, (AO_t)steps);
+        AO_fetch_and_add_full(&bg_total_ops, (AO_t)ops);
+}
+
+/**
+ * bg_check_index - check that the index levels cover the whole list
+ *
+ * Returns the number of problems found, and prints each of them.
+ * Note: only meaningful once the background threads have run a few
+ * loops with no concurrent updates. Every index level that is raised
+ * by the background threads (i.e. all but the top one) must then have
+ * no three consecutive items that are missing from the level above,
+ * and no items of deleted nodes, anywhere in the key range.
+ */
+int bg_check_index(void)
+{
+        inode_t *top, *inode;
+        int i, pos, run, errors = 0;
+
+        assert(NULL != set);
+
+        top = set->top;
+        for (i = set->head->level - 1; i > 0; i--) {
+                top = top->down;
+                assert(NULL != top);
+
+                /* top is the first index node at index level i - 1 */
+                run = 0;
+                pos = 0;
+                for (inode = top->right; NULL != inode; inode = inode->right) {
+                        ++pos;
+                        if (inode->node->val == inode->node &&
+                            NULL != inode->right) {
+                                printf("Index level %d: item %d is deleted\n",
+                                       i - 1, pos);
+                                ++errors;
+                        }
+
+                        if (inode->node->level > i) {
+                                run = 0;
+                        } else if (++run == 3) {
+                                printf("Index level %d: items %d - %d "
+                                       "not raised\n", i - 1, pos - 2, pos);
+                                ++errors;
+                        }
+                }
+        }
+
+        return errors;
+}
+
 /**
  * bg_print_stats - print background statistics
  *
@@ -448,6 +861,35 @@ void bg_print_stats(void)
         #endif
 }
 
+/**
+ * bg_print_samples - print and clear the index height samples
+ *
+ * Note: prints to stderr one line per sample, oldest first.
+ */
+void bg_print_samples(void)
+{
+        bg_sample_t *sample;
+        int i, first;
+
+        pthread_mutex_lock(&bg_sample_lock);
+        first = (bg_sample_count > BG_MAX_SAMPLES) ?
+                bg_sample_count - BG_MAX_SAMPLES : 0;
+
+        fprintf(stderr, "Skiplist background (%d threads):\n", bg_nthreads);
+        for (i = first; i < bg_sample_count; i++) {
+                sample = &bg_samples[i % BG_MAX_SAMPLES];
+                fprintf(stderr,
+                        "    t = %.2f height = %d parts = %d nodes = %d "
+                        "raised = %d sleep = %d steps/op = %f\n",
+                        sample->time, sample->height, sample->parts,
+                        sample->nodes, sample->nraised, sample->sleep_time,
+                        sample->steps_per_op);
+        }
+
+        bg_sample_count = 0;
+        pthread_mutex_unlock(&bg_sample_lock);
+}
+
 /**
  * bg_help_remove - finish physically removing a node
  * @prev: the node before the one to remove
@@ -10,9 +10,13 @@
 #include "ptst.h"
 
 void bg_init(set_t *s);
+void bg_set_threads(int num_threads);
 void bg_start(int sleep_time);
 void bg_stop(void);
+void bg_add_steps(long steps, long ops);
 void bg_print_stats(void);
+void bg_print_samples(void);
+int bg_check_index(void);
 void bg_remove(node_t *prev, node_t *node, ptst_t *ptst);
 void bg_help_remove(node_t *prev, node_t *node, ptst_t *ptst);
 
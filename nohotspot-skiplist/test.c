@@ -31,6 +31,7 @@
 #include <sys/time.h>
 #include <time.h>
 #include <stdint.h>
+#include <unistd.h>
 
 #include <atomic_ops.h>
 
@@ -51,6 +52,7 @@
 #define DEFAULT_EFFECTIVE               1
 
 #define DEFAULT_UNBALANCED              0
+#define DEFAULT_BG_THREADS              1
 
 #define XSTR(s)                         STR(s)
 #define STR(s)                          #s
@@ -323,6 +325,7 @@ int main(int argc, char **argv)
 		{"seed",                      required_argument, NULL, 's'},
 		{"update-rate",               required_argument, NULL, 'u'},
 		{"elasticity",                required_argument, NULL, 'x'},
+		{"bg-threads",                required_argument, NULL, 'b'},
 		{NULL, 0, NULL, 0}
 	};
 	
@@ -353,10 +356,12 @@ int main(int argc, char **argv)
         struct sl_node *temp;
 
         int unbalanced = DEFAULT_UNBALANCED;
+        int bg_threads = DEFAULT_BG_THREADS;
+        int bg_errors;
 
 	while(1) {
 		i = 0;
-		c = getopt_long(argc, argv, "hAf:d:i:t:r:S:u:x:U:"
+		c = getopt_long(argc, argv, "hAf:d:i:t:r:S:u:x:U:b:"
 										, long_options, &i);
 		
 		if(c == -1)
@@ -402,6 +407,8 @@ int main(int argc, char **argv)
 								 "        3 = read/add elastic-tx,\n"
 								 "        4 = read/add/rem elastic-tx,\n"
 								 "        5 = fraser lock-free\n"
+								 "  -b, --bg-threads <int>\n"
+								 "        Number of background threads (default=" XSTR(DEFAULT_BG_THREADS) ")\n"
 								 );
 					exit(0);
 				case 'A':
@@ -434,6 +441,9 @@ int main(int argc, char **argv)
                                 case 'U':
                                         unbalanced = atoi(optarg);
                                         break;
+                                case 'b':
+                                        bg_threads = atoi(optarg);
+                                        break;
 				case '?':
 					printf("Use -h or --help for help\n");
 					exit(0);
@@ -458,6 +468,7 @@ int main(int argc, char **argv)
 	printf("Elasticity   : %d\n", unit_tx);
 	printf("Alternate    : %d\n", alternate);
 	printf("Efffective   : %d\n", effective);
+	printf("BG threads   : %d\n", bg_threads);
 	printf("Type sizes   : int=%d/long=%d/ptr=%d/word=%d\n",
 				 (int)sizeof(int),
 				 (int)sizeof(long),
@@ -487,6 +498,7 @@ int main(int argc, char **argv)
         ptst_subsystem_init();
         gc_subsystem_init();
         set_subsystem_init();
+        bg_set_threads(bg_threads);
         set = set_new(1);
 	stop = 0;
 
@@ -712,7 +724,17 @@ int main(int argc, char **argv)
 	printf("  #failures   : %lu\n",  failures_because_contention);
 	printf("Max retries   : %lu\n", max_retries);
 
+        // let the background threads catch up with no updates going
+        // on, then check that the whole key range has index levels
+        bg_stop();
+        bg_start(0);
+        usleep(200000);
         bg_stop();
+        bg_errors = bg_check_index();
+        printf("Index check   : %s (%d problems, %d levels)\n",
+               0 == bg_errors ? "passed" : "FAILED", bg_errors,
+               set->head->level);
+
         bg_print_stats();
 
         /*sl_set_print(set, 1);*/
@@ -731,6 +753,6 @@ int main(int argc, char **argv)
 	free(threads);
 	free(data);
 	
-	return 0;
+	return (0 == bg_errors) ? 0 : 1;
 }
 
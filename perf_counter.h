@@ -0,0 +1,386 @@
+
+#ifndef _PERF_COUNTER_H
+#define _PERF_COUNTER_H
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+
+/*
+ * perf_counter.h - Per-thread hardware counters based on perf_event_open(2)
+ *
+ * Every worker started by StartThreads() opens its own counters, which only
+ * count the worker itself (on whichever core it runs), and adds them to the
+ * totals of the phase when it is done. If the PMU cannot be used (e.g. inside
+ * most VMs, or because of perf_event_paranoid) software counters are opened
+ * instead, so that a run never fails because of the monitor
+ *
+ * Other monitors (see mem_monitor.h) register their own event lists, which
+ * the workers open and accumulate in the same way
+ */
+namespace perf_monitor {
+
+/*
+ * struct EventDesc - One counter as passed to perf_event_open()
+ */
+struct EventDesc {
+  uint32_t type;
+  uint64_t config;
+  const char *name;
+};
+
+// Encodes the config of a generalized cache event (PERF_TYPE_HW_CACHE)
+constexpr uint64_t CacheEvent(uint64_t cache, uint64_t op, uint64_t result) {
+  return cache | (op << 8) | (result << 16);
+}
+
+static constexpr int MAX_EVENT_COUNT = 6;
+
+static const EventDesc hardware_event_list[] = {
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch_misses"},
+  {PERF_TYPE_HW_CACHE,
+   CacheEvent(PERF_COUNT_HW_CACHE_L1D,
+              PERF_COUNT_HW_CACHE_OP_READ,
+              PERF_COUNT_HW_CACHE_RESULT_MISS),
+   "l1d_misses"},
+  // The generic cache miss event is mapped to last level cache misses
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "llc_misses"},
+  {PERF_TYPE_HW_CACHE,
+   CacheEvent(PERF_COUNT_HW_CACHE_DTLB,
+              PERF_COUNT_HW_CACHE_OP_READ,
+              PERF_COUNT_HW_CACHE_RESULT_MISS),
+   "dtlb_misses"},
+};
+
+static const EventDesc software_event_list[] = {
+  {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, "task_clock_ns"},
+  {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN, "minor_faults"},
+  {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ, "major_faults"},
+  {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context_switches"},
+  {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS, "cpu_migrations"},
+};
+
+// Independent sets of events; each is enabled by its own Init function
+enum MonitorType {
+  CORE_MONITOR = 0,
+  MEMORY_MONITOR,
+  NUMA_MONITOR,
+
+  MONITOR_COUNT,
+};
+
+/*
+ * struct MonitorState - Events chosen for one monitor and the totals of
+ *                       the current phase
+ */
+struct MonitorState {
+  // Set once at least one of the events could be opened
+  bool enabled;
+  bool hardware;
+  const EventDesc *event_list;
+  int event_count;
+  bool available[MAX_EVENT_COUNT];
+
+  std::atomic<uint64_t> totals[MAX_EVENT_COUNT];
+  std::atomic<uint64_t> thread_count;
+};
+
+inline MonitorState &GetState(int monitor) {
+  static MonitorState state_list[MONITOR_COUNT]{};
+  return state_list[monitor];
+}
+
+/*
+ * OpenEvent() - Opens a disabled counter for the calling thread
+ *
+ * Returns -1 and sets errno if the event is not supported
+ */
+inline int OpenEvent(const EventDesc &desc) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = desc.type;
+  attr.config = desc.config;
+  attr.disabled = 1;
+  // Unprivileged users may only count user space
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // If there are more events than PMU registers the kernel multiplexes them
+  // and we scale by the fraction of time each one was actually counting
+  attr.read_format = \
+    PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ * SelectEvents() - Probes the hardware events of a monitor, or the software
+ *                  events if the first hardware event cannot be opened
+ *
+ * Call this once in the main thread before the first phase. Returns false if
+ * none of the events could be opened
+ */
+inline bool SelectEvents(int monitor,
+                         const EventDesc *hardware_list,
+                         int hardware_count,
+                         const EventDesc *software_list,
+                         int software_count) {
+  MonitorState &state = GetState(monitor);
+
+  state.hardware = true;
+  state.event_list = hardware_list;
+  state.event_count = hardware_count;
+
+  int fd = OpenEvent(hardware_list[0]);
+  if(fd == -1) {
+    fprintf(stderr,
+            "  Counter %s not available (%s); using software counters\n",
+            hardware_list[0].name,
+            strerror(errno));
+    state.hardware = false;
+    state.event_list = software_list;
+    state.event_count = software_count;
+  } else {
+    close(fd);
+  }
+
+  for(int i = 0;i < state.event_count;i++) {
+    fd = OpenEvent(state.event_list[i]);
+    if(fd == -1) {
+      fprintf(stderr,
+              "  Counter %s not available (%s)\n",
+              state.event_list[i].name,
+              strerror(errno));
+      state.available[i] = false;
+    } else {
+      close(fd);
+      state.available[i] = true;
+      state.enabled = true;
+    }
+  }
+
+  if(state.enabled == false) {
+    fprintf(stderr, "  No perf counter could be opened; monitor disabled\n");
+  }
+
+  return state.enabled;
+}
+
+/*
+ * InitPerfMonitor() - Chooses the events printed by EndPerfMonitor()
+ */
+inline void InitPerfMonitor() {
+  SelectEvents(CORE_MONITOR,
+               hardware_event_list,
+               (int)(sizeof(hardware_event_list) / sizeof(EventDesc)),
+               software_event_list,
+               (int)(sizeof(software_event_list) / sizeof(EventDesc)));
+
+  return;
+}
+
+/*
+ * ResetTotals() - Clears the totals of a monitor before a phase
+ */
+inline void ResetTotals(int monitor) {
+  MonitorState &state = GetState(monitor);
+  for(int i = 0;i < MAX_EVENT_COUNT;i++) {
+    state.totals[i].store(0UL);
+  }
+
+  state.thread_count.store(0UL);
+
+  return;
+}
+
+/*
+ * GetTotal() - Reads the phase total of an event of a monitor
+ *
+ * Returns false if the event is not being counted
+ */
+inline bool GetTotal(int monitor, int event, uint64_t *value_p) {
+  const MonitorState &state = GetState(monitor);
+  if(state.enabled == false || \
+     event >= state.event_count || \
+     state.available[event] == false) {
+    return false;
+  }
+
+  *value_p = state.totals[event].load();
+
+  return true;
+}
+
+/*
+ * class ThreadCounters - The counters of one worker thread
+ *
+ * Start() and Stop() must be called by the thread that is measured. They
+ * cover the events of every enabled monitor, and are no-ops if there is none
+ */
+class ThreadCounters {
+ public:
+  ThreadCounters() {
+    for(int monitor = 0;monitor < MONITOR_COUNT;monitor++) {
+      for(int i = 0;i < MAX_EVENT_COUNT;i++) {
+        fd_list[monitor][i] = -1;
+      }
+    }
+  }
+
+  ~ThreadCounters() {
+    Close();
+  }
+
+  void Start() {
+    for(int monitor = 0;monitor < MONITOR_COUNT;monitor++) {
+      const MonitorState &state = GetState(monitor);
+      if(state.enabled == false) {
+        continue;
+      }
+
+      for(int i = 0;i < state.event_count;i++) {
+        if(state.available[i] == true) {
+          fd_list[monitor][i] = OpenEvent(state.event_list[i]);
+        }
+      }
+    }
+
+    // All events are opened before any is enabled, so that they cover
+    // (almost) the same interval
+    for(int monitor = 0;monitor < MONITOR_COUNT;monitor++) {
+      for(int i = 0;i < MAX_EVENT_COUNT;i++) {
+        if(fd_list[monitor][i] != -1) {
+          ioctl(fd_list[monitor][i], PERF_EVENT_IOC_RESET, 0);
+          ioctl(fd_list[monitor][i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+      }
+    }
+
+    return;
+  }
+
+  /*
+   * Stop() - Stops counting and adds the values to the phase totals
+   */
+  void Stop() {
+    for(int monitor = 0;monitor < MONITOR_COUNT;monitor++) {
+      for(int i = 0;i < MAX_EVENT_COUNT;i++) {
+        if(fd_list[monitor][i] != -1) {
+          ioctl(fd_list[monitor][i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+      }
+    }
+
+    for(int monitor = 0;monitor < MONITOR_COUNT;monitor++) {
+      MonitorState &state = GetState(monitor);
+      if(state.enabled == false) {
+        continue;
+      }
+
+      for(int i = 0;i < MAX_EVENT_COUNT;i++) {
+        if(fd_list[monitor][i] == -1) {
+          continue;
+        }
+
+        // value, time enabled, time running
+        uint64_t data[3];
+        if(read(fd_list[monitor][i], data, sizeof(data)) != \
+           (ssize_t)sizeof(data)) {
+          continue;
+        }
+
+        uint64_t value = data[0];
+        if(data[2] != 0 && data[2] < data[1]) {
+          value = (uint64_t)((double)value * data[1] / data[2]);
+        }
+
+        state.totals[i].fetch_add(value);
+      }
+
+      state.thread_count.fetch_add(1);
+    }
+
+    Close();
+
+    return;
+  }
+
+ private:
+  void Close() {
+    for(int monitor = 0;monitor < MONITOR_COUNT;monitor++) {
+      for(int i = 0;i < MAX_EVENT_COUNT;i++) {
+        if(fd_list[monitor][i] != -1) {
+          close(fd_list[monitor][i]);
+          fd_list[monitor][i] = -1;
+        }
+      }
+    }
+  }
+
+  int fd_list[MONITOR_COUNT][MAX_EVENT_COUNT];
+};
+
+/*
+ * StartPerfMonitor() - Clears the totals before a phase
+ */
+inline void StartPerfMonitor() {
+  ResetTotals(CORE_MONITOR);
+  return;
+}
+
+/*
+ * EndPerfMonitor() - Prints the totals of the phase, and each of them
+ *                    divided by the number of operations in the phase
+ */
+inline void EndPerfMonitor(const char *phase_name, uint64_t op_count) {
+  const MonitorState &state = GetState(CORE_MONITOR);
+  if(state.enabled == false) {
+    return;
+  }
+
+  double op_num = (op_count == 0UL) ? 1.0 : (double)op_count;
+
+  fprintf(stderr,
+          "Perf counters (%s, %s, %lu threads):",
+          phase_name,
+          state.hardware ? "hardware" : "software",
+          state.thread_count.load());
+  for(int i = 0;i < state.event_count;i++) {
+    if(state.available[i] == true) {
+      uint64_t total = state.totals[i].load();
+      fprintf(stderr,
+              " %s = %lu (%.3f/op);",
+              state.event_list[i].name,
+              total,
+              total / op_num);
+    } else {
+      fprintf(stderr, " %s = n/a;", state.event_list[i].name);
+    }
+  }
+
+  // Cycles and instructions are the first two hardware events
+  if(state.hardware == true && \
+     state.available[0] == true && \
+     state.available[1] == true && \
+     state.totals[0].load() != 0UL) {
+    fprintf(stderr,
+            " IPC = %.2f",
+            (double)state.totals[1].load() / state.totals[0].load());
+  }
+
+  fprintf(stderr, "\n");
+
+  return;
+}
+
+} // namespace perf_monitor
+
+#endif
@@ -0,0 +1,370 @@
+
+#ifndef _RESULTS_H
+#define _RESULTS_H
+
+#include <time.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "index.h"
+#include "perf_counter.h"
+
+/*
+ * results.h - One machine readable record per phase
+ *
+ * With --results [file] the drivers append a record to the file after every
+ * phase, in addition to the usual output. Files ending in .csv get a header
+ * line and one CSV line per record; all other files get one JSON object per
+ * line. Counters that vary between indexes (IndexStats and perf events) are
+ * a nested object in JSON and a single "name=value;..." column in CSV
+ */
+namespace results {
+
+// One in this many operations of each worker is timed
+static constexpr uint64_t LATENCY_SAMPLE_OPS = 64;
+
+/*
+ * struct RunInfo - Describes the run; filled in by the driver once
+ */
+struct RunInfo {
+  std::string workload;
+  std::string key_type;
+  std::string pinning;
+};
+
+/*
+ * struct PhaseRecord - What the driver knows at the end of a phase
+ */
+struct PhaseRecord {
+  const char *phase;
+  const char *index_name;
+  int thread_num;
+  uint64_t op_count;
+  double seconds;
+  // Mops/sec
+  double throughput;
+  // Resident set size in KiB
+  size_t memory_kb;
+  IndexStats stats;
+};
+
+/*
+ * struct PaddedSampleList - Latency samples of one worker (ns)
+ */
+struct PaddedSampleList {
+  std::vector<uint64_t> sample_list;
+  char padding[CACHE_LINE_SIZE - sizeof(std::vector<uint64_t>)];
+};
+
+/*
+ * struct ResultState - The output file and the samples of the current phase
+ */
+struct ResultState {
+  FILE *fp;
+  bool csv;
+  RunInfo run_info;
+  std::vector<PaddedSampleList> latency_list;
+};
+
+inline ResultState &GetState() {
+  static ResultState state{};
+  return state;
+}
+
+/*
+ * GetBuildFlags() - Returns the compile time options of the driver that
+ *                   change what is measured
+ */
+inline std::string GetBuildFlags() {
+  std::string flags;
+#ifdef NDEBUG
+  flags += " NDEBUG";
+#endif
+#ifdef BTREE_SLOWER_LAYOUT
+  flags += " BTREE_SLOWER_LAYOUT";
+#endif
+#ifdef USE_TBB
+  flags += " USE_TBB";
+#endif
+#ifdef USE_GENERIC_KEY
+  flags += " USE_GENERIC_KEY";
+#endif
+#ifdef INTERLEAVED_INSERT
+  flags += " INTERLEAVED_INSERT";
+#endif
+#ifdef COUNT_READ_MISS
+  flags += " COUNT_READ_MISS";
+#endif
+#ifdef BWTREE_NODEBUG
+  flags += " BWTREE_NODEBUG";
+#endif
+#ifdef BWTREE_USE_CAS
+  flags += " BWTREE_USE_CAS";
+#endif
+#ifdef BWTREE_USE_MAPPING_TABLE
+  flags += " BWTREE_USE_MAPPING_TABLE";
+#endif
+#ifdef BWTREE_USE_DELTA_UPDATE
+  flags += " BWTREE_USE_DELTA_UPDATE";
+#endif
+#ifdef BWTREE_ADAPTIVE_CONSOLIDATION
+  flags += " BWTREE_ADAPTIVE_CONSOLIDATION";
+#endif
+#ifdef BWTREE_CONSOLIDATE_AFTER_INSERT
+  flags += " BWTREE_CONSOLIDATE_AFTER_INSERT";
+#endif
+#ifdef BWTREE_COLLECT_STATISTICS
+  flags += " BWTREE_COLLECT_STATISTICS";
+#endif
+#ifdef INDEX_COLLECT_STATISTICS
+  flags += " INDEX_COLLECT_STATISTICS";
+#endif
+#ifdef USE_OLD_EPOCH
+  flags += " USE_OLD_EPOCH";
+#endif
+
+  return flags.empty() ? flags : flags.substr(1);
+}
+
+/*
+ * OpenResults() - Opens the file records are appended to
+ *
+ * Returns false if the file could not be opened
+ */
+inline bool OpenResults(const char *path, const RunInfo &run_info) {
+  ResultState &state = GetState();
+
+  std::string path_str{path};
+  state.csv = (path_str.size() >= 4 && \
+               path_str.compare(path_str.size() - 4, 4, ".csv") == 0);
+
+  state.fp = fopen(path, "a");
+  if(state.fp == nullptr) {
+    return false;
+  }
+
+  state.run_info = run_info;
+
+  // Only a new file gets the header, so that runs can append to it
+  fseek(state.fp, 0L, SEEK_END);
+  if(state.csv == true && ftell(state.fp) == 0L) {
+    fprintf(state.fp,
+            "phase,index,workload,key_type,threads,pinning,build_flags,"
+            "ops,seconds,throughput_mops,latency_p50_ns,latency_p90_ns,"
+            "latency_p99_ns,latency_p999_ns,memory_kb,counters\n");
+  }
+
+  return true;
+}
+
+/*
+ * SetRunInfo() - Changes the run described by the following records; used
+ *                by the matrix mode of the driver between cells
+ */
+inline void SetRunInfo(const RunInfo &run_info) {
+  GetState().run_info = run_info;
+  return;
+}
+
+inline bool IsEnabled() {
+  return GetState().fp != nullptr;
+}
+
+/*
+ * StartPhase() - Clears the latency samples before a phase
+ */
+inline void StartPhase(int thread_num) {
+  ResultState &state = GetState();
+  if(state.fp == nullptr) {
+    return;
+  }
+
+  state.latency_list.clear();
+  state.latency_list.resize(thread_num);
+
+  return;
+}
+
+/*
+ * GetSampleList() - Returns where a worker stores its latency samples, or
+ *                   nullptr if no results are written
+ */
+inline std::vector<uint64_t> *GetSampleList(uint64_t thread_id) {
+  ResultState &state = GetState();
+  if(state.fp == nullptr || thread_id >= state.latency_list.size()) {
+    return nullptr;
+  }
+
+  return &state.latency_list[thread_id].sample_list;
+}
+
+inline uint64_t GetNowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+/*
+ * class LatencySampler - Times every LATENCY_SAMPLE_OPS-th operation of a
+ *                        worker if results are written
+ *
+ * Begin() and End() go around each operation
+ */
+class LatencySampler {
+ public:
+  explicit LatencySampler(uint64_t thread_id) :
+    sample_list_p{GetSampleList(thread_id)},
+    op_start{0UL}
+  {}
+
+  inline void Begin(uint64_t op_index) {
+    if(sample_list_p != nullptr && op_index % LATENCY_SAMPLE_OPS == 0) {
+      op_start = GetNowNs();
+    }
+  }
+
+  inline void End() {
+    if(op_start != 0UL) {
+      sample_list_p->push_back(GetNowNs() - op_start);
+      op_start = 0UL;
+    }
+  }
+
+ private:
+  std::vector<uint64_t> *sample_list_p;
+  uint64_t op_start;
+};
+
+/*
+ * AppendCounters() - Collects the tracked index counters and the perf
+ *                    totals as (name, value) pairs
+ */
+inline void AppendCounters(const IndexStats &stats,
+                           std::vector<std::pair<std::string, uint64_t>> *counter_list_p) {
+  for(int i = 0;i < IndexStats::COUNTER_COUNT;i++) {
+    if(stats.IsTracked(i) == true) {
+      counter_list_p->emplace_back(IndexStats::GetName(i), stats.counters[i]);
+    }
+  }
+
+  for(int monitor = 0;monitor < perf_monitor::MONITOR_COUNT;monitor++) {
+    const perf_monitor::MonitorState &monitor_state = \
+      perf_monitor::GetState(monitor);
+    for(int i = 0;i < monitor_state.event_count;i++) {
+      uint64_t value;
+      if(perf_monitor::GetTotal(monitor, i, &value) == true) {
+        counter_list_p->emplace_back(monitor_state.event_list[i].name, value);
+      }
+    }
+  }
+
+  return;
+}
+
+/*
+ * WritePhase() - Appends the record of a phase, with the latency
+ *                percentiles of the samples taken during the phase
+ */
+inline void WritePhase(const PhaseRecord &record) {
+  ResultState &state = GetState();
+  if(state.fp == nullptr) {
+    return;
+  }
+
+  std::vector<uint64_t> sample_list;
+  for(const PaddedSampleList &list : state.latency_list) {
+    sample_list.insert(sample_list.end(),
+                       list.sample_list.begin(),
+                       list.sample_list.end());
+  }
+
+  std::sort(sample_list.begin(), sample_list.end());
+
+  // Nearest rank; 0 if nothing was sampled
+  static const double percentile_list[] = {0.50, 0.90, 0.99, 0.999};
+  uint64_t latency_list[4] = {0UL, 0UL, 0UL, 0UL};
+  if(sample_list.empty() == false) {
+    for(int i = 0;i < 4;i++) {
+      size_t rank = (size_t)(percentile_list[i] * sample_list.size());
+      latency_list[i] = sample_list[std::min(rank, sample_list.size() - 1)];
+    }
+  }
+
+  std::vector<std::pair<std::string, uint64_t>> counter_list;
+  AppendCounters(record.stats, &counter_list);
+
+  const RunInfo &run_info = state.run_info;
+  std::string build_flags = GetBuildFlags();
+
+  if(state.csv == true) {
+    fprintf(state.fp,
+            "%s,%s,%s,%s,%d,\"%s\",\"%s\",%lu,%f,%f,%lu,%lu,%lu,%lu,%lu,\"",
+            record.phase,
+            record.index_name,
+            run_info.workload.c_str(),
+            run_info.key_type.c_str(),
+            record.thread_num,
+            run_info.pinning.c_str(),
+            build_flags.c_str(),
+            record.op_count,
+            record.seconds,
+            record.throughput,
+            latency_list[0],
+            latency_list[1],
+            latency_list[2],
+            latency_list[3],
+            record.memory_kb);
+    for(size_t i = 0;i < counter_list.size();i++) {
+      fprintf(state.fp,
+              "%s%s=%lu",
+              (i == 0) ? "" : ";",
+              counter_list[i].first.c_str(),
+              counter_list[i].second);
+    }
+
+    fprintf(state.fp, "\"\n");
+  } else {
+    fprintf(state.fp,
+            "{\"phase\": \"%s\", \"index\": \"%s\", \"workload\": \"%s\", "
+            "\"key_type\": \"%s\", \"threads\": %d, \"pinning\": \"%s\", "
+            "\"build_flags\": \"%s\", \"ops\": %lu, \"seconds\": %f, "
+            "\"throughput_mops\": %f, \"latency_ns\": {\"p50\": %lu, "
+            "\"p90\": %lu, \"p99\": %lu, \"p999\": %lu}, "
+            "\"memory_kb\": %lu, \"counters\": {",
+            record.phase,
+            record.index_name,
+            run_info.workload.c_str(),
+            run_info.key_type.c_str(),
+            record.thread_num,
+            run_info.pinning.c_str(),
+            build_flags.c_str(),
+            record.op_count,
+            record.seconds,
+            record.throughput,
+            latency_list[0],
+            latency_list[1],
+            latency_list[2],
+            latency_list[3],
+            record.memory_kb);
+    for(size_t i = 0;i < counter_list.size();i++) {
+      fprintf(state.fp,
+              "%s\"%s\": %lu",
+              (i == 0) ? "" : ", ",
+              counter_list[i].first.c_str(),
+              counter_list[i].second);
+    }
+
+    fprintf(state.fp, "}}\n");
+  }
+
+  fflush(state.fp);
+
+  return;
+}
+
+} // namespace results
+
+#endif
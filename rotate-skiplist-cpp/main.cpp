@@ -10,6 +10,8 @@ using namespace rotate_skiplist;
 void ThreadStateTest1() {
   fprintf(stderr, "Testing class ThreadState basic\n");
 
+  // Thread states own a thread local GC object
+  GCGlobalState::Init();
   ThreadState::Init();
   ThreadState *thread_state_p = ThreadState::EnterCritical();
 
@@ -55,8 +57,7 @@ void GCChunkTest2() {
   // This will be a compilation error
   //GCGlobalState nonsense{};
 
-  // This is a local object but we have constructor
-  GCGlobalState::Init();
+  // This has been initialized in ThreadStateTest1()
   GCGlobalState *global_state_p = GCGlobalState::Get();
 
   fprintf(stderr, 
@@ -92,15 +93,122 @@ void GCChunkTest2() {
 }
 
 /*
- * main() - The main testing function
+ * RotateSkiplistTest1() - Tests single threaded operations
  */
-int main() {
+void RotateSkiplistTest1() {
+  fprintf(stderr, "Testing RotateSkiplist basic\n");
+
   RotateSkiplist<uint64_t, uint64_t> rsl{};
-  (void)rsl;
+  static constexpr uint64_t key_num = 100000UL;
+
+  for(uint64_t i = 0;i < key_num;i++) {
+    bool ret = rsl.Insert(i * 2, i);
+    assert(ret == true);
+  }
+
+  // Duplicated keys are rejected
+  assert(rsl.Insert(0UL, 1UL) == false);
+  assert(rsl.GetSize() == key_num);
+
+  uint64_t value = 0UL;
+  for(uint64_t i = 0;i < key_num;i++) {
+    assert(rsl.GetValue(i * 2, &value) == true);
+    assert(value == i);
+    assert(rsl.GetValue(i * 2 + 1, &value) == false);
+  }
+
+  // Start in the middle of a gap
+  std::vector<uint64_t> value_list{};
+  assert(rsl.Scan(1001UL, 10UL, &value_list) == 10UL);
+  for(uint64_t i = 0;i < 10UL;i++) {
+    assert(value_list[i] == 501UL + i);
+  }
 
+  for(uint64_t i = 0;i < key_num;i += 2) {
+    assert(rsl.Delete(i * 2) == true);
+    assert(rsl.Delete(i * 2) == false);
+  }
+
+  // Give the background thread a chance to build and lower the index
+  usleep(100000);
+
+  for(uint64_t i = 0;i < key_num;i++) {
+    assert(rsl.GetValue(i * 2, &value) == (i % 2 == 1));
+  }
+
+  // Deleted keys are inserted again, and others are updated
+  for(uint64_t i = 0;i < key_num;i++) {
+    assert(rsl.Upsert(i * 2, i + 1) == (i % 2 == 0));
+  }
+
+  for(uint64_t i = 0;i < key_num;i++) {
+    assert(rsl.GetValue(i * 2, &value) == true);
+    assert(value == i + 1);
+  }
+
+  assert(rsl.GetSize() == key_num);
+  fprintf(stderr, "  Levels = %d\n", rsl.GetLevel());
+
+  return;
+}
+
+/*
+ * RotateSkiplistTest2() - Tests concurrent insert and delete
+ */
+void RotateSkiplistTest2() {
+  fprintf(stderr, "Testing RotateSkiplist multi-threaded\n");
+
+  using SkiplistType = RotateSkiplist<uint64_t, uint64_t>;
+  SkiplistType *rsl_p = new SkiplistType{};
+  static constexpr int thread_num = 4;
+  static constexpr uint64_t key_num = 50000UL;
+
+  // Thread i inserts keys that are equal to i modulo thread_num, and
+  // deletes half of them
+  auto func = [rsl_p](int id) {
+    for(uint64_t i = id;i < key_num * thread_num;i += thread_num) {
+      bool ret = rsl_p->Insert(i, i);
+      assert(ret == true);
+      (void)ret;
+    }
+
+    for(uint64_t i = id;i < key_num * thread_num;i += thread_num * 2) {
+      bool ret = rsl_p->Delete(i);
+      assert(ret == true);
+      (void)ret;
+    }
+  };
+
+  std::vector<std::thread> thread_list{};
+  for(int i = 0;i < thread_num;i++) {
+    thread_list.emplace_back(func, i);
+  }
+
+  for(auto &t : thread_list) {
+    t.join();
+  }
+
+  uint64_t value = 0UL;
+  for(uint64_t i = 0;i < key_num * thread_num;i++) {
+    bool deleted = (i % (thread_num * 2)) < thread_num;
+    assert(rsl_p->GetValue(i, &value) == !deleted);
+  }
+
+  assert(rsl_p->GetSize() == key_num * thread_num / 2);
+  delete rsl_p;
+
+  return;
+}
+
+/*
+ * main() - The main testing function
+ */
+int main() {
   ThreadStateTest1();
   GCChunkTest1();
   GCChunkTest2();
+  RotateSkiplistTest1();
+  RotateSkiplistTest2();
 
   fprintf(stderr, "All tests have passed\n");
   
@@ -7,6 +7,10 @@
 // This contains std::less and std::equal_to
 #include <functional> 
 #include <atomic>
+#include <thread>
+#include <vector>
+#include <type_traits>
+#include <new>
 
 // Traditional C libraries 
 #include <cstdlib>
@@ -21,7 +25,10 @@ namespace rotate_skiplist {
 
 // This prevents compiler rearranging the code cross this point
 // Usually a hardware memury fence is not needed for x86-64
+// Other skiplist modules may have defined it already
+#ifndef BARRIER
 #define BARRIER() asm volatile("" ::: "memory")
+#endif
 
 // Note that since this macro may be defined also in other modules, we
 // only define it if it is missing from the context
@@ -37,7 +44,17 @@ namespace rotate_skiplist {
 // This macro defines an empty array of cache line size
 // We use this to prevent false sharing
 // We should pass in a different _n to specify different names for the struct
+#ifndef CACHE_PAD
 #define CACHE_PAD(_n) char __pad ## _n [CACHE_LINE_SIZE]
+#endif
+
+// This macro bumps an operation counter of a ThreadState. Counters are only
+// maintained when they are enabled with INDEX_COLLECT_STATISTICS
+#ifdef INDEX_COLLECT_STATISTICS
+#define COUNT_OP(_thread_state_p, _name) ((_thread_state_p)->_name++)
+#else
+#define COUNT_OP(_thread_state_p, _name) ((void)0)
+#endif
 
 /////////////////////////////////////////////////////////////////////
 // GC related classes
@@ -59,7 +76,8 @@ class GCConstant {
 
   static constexpr int NUM_EPOCHS = 3;
   static constexpr int MAX_HOOKS = 4;
-  static constexpr int NUM_SIZES = 1;
+  // Each skiplist instantiation registers one size type for its nodes
+  static constexpr int NUM_SIZES = 4;
 
   // Number of chunks we allocate for a list
   static constexpr int CHUNK_PER_ALLOCATION_FROM_FREE_LIST = 300;
@@ -69,6 +87,9 @@ class GCConstant {
   // Max number of depeletd chunks we allow for thread local GC objects
   static constexpr int MAX_DEPLETED_CHUNK = 100;
 
+  // Number of critical section entries before a thread tries to reclaim
+  static constexpr unsigned int ENTRIES_PER_RECLAIM = 100;
+
   using GCHookFuncType = void (*)(ThreadState *, void *);
 };
 
@@ -121,18 +142,14 @@ class GCChunk : public GCConstant {
    *
    * Note that since the linked list we are linking is circular, we can treat
    * the pointer passed in as argument as a pointer to the actual tail,
-   * and use the next node as a head. This requires:
-   *    1. The linked list has at least 2 elements
-   *    2. The list we are linking into has at least 1 element (since the
-   *       free list is also a circular list we could not alter the first
-   *       element)
-   * which are all guaranteed
+   * and use the next node as a head. A single element list is also fine
+   * since head and tail are then the same chunk. This requires that the list
+   * we are linking into has at least 1 element (since the free list is also
+   * a circular list we could not alter the first element), which is
+   * guaranteed
    */
   static void LinkInto(GCChunk *new_list_p, GCChunk *link_into_p) {
-    // Checks condition 2
     assert(link_into_p != nullptr);
-    // Checks condition 1
-    assert(new_list_p->next_p != new_list_p);
 
     // This is a circular list, so no real head anyway
     GCChunk *head_p = new_list_p->next_p;
@@ -222,6 +239,9 @@ class GCGlobalState : public GCConstant {
 
   // The current epoch
   int current_epoch;
+  // Number of times the epoch has been advanced; only written by the
+  // thread holding gc_lock
+  uint64_t epoch_advance_count;
 
   CACHE_PAD(1);
 
@@ -331,6 +351,10 @@ class GCGlobalState : public GCConstant {
    */
   int AddSizeType(int size) {
     int size_type_index = size_type_count.fetch_add(1);
+    if(size_type_index >= NUM_SIZES) {
+      fprintf(stderr, "GCGlobalState::AddSizeType() Too many size types\n");
+      exit(1);
+    }
 
     // This is the value we fill in constructor
     assert(block_size_list[size_type_index] == 0);
@@ -484,6 +508,9 @@ class GCGlobalState : public GCConstant {
     return head_p;
   }
 
+  // Defined after class ThreadState since it scans all thread states
+  inline void Reclaim();
+
  private:
   /*
    * GCGlobalState() - Initialize the object (rather than static states)
@@ -492,6 +519,7 @@ class GCGlobalState : public GCConstant {
     assert(global_state_p == nullptr);
 
     current_epoch = 0;
+    epoch_advance_count = 0UL;
     gc_lock.clear();
 
     system_page_size = static_cast<unsigned int>(sysconf(_SC_PAGESIZE));
@@ -581,6 +609,8 @@ class GCThreadLocal : public GCConstant {
       GCChunk::LinkInto(new_chunk_p, head_p);
       assert(GCChunk::DebugCountChunk(head_p) == \
              CHUNK_PER_ALLOCATION_FOR_CACHE + 1);
+      // Otherwise we would hand out the head of the cache
+      next_p = head_p->next_p.load();
     }
 
     head_p->next_p.store(next_p->next_p.load());
@@ -648,7 +678,11 @@ class GCThreadLocal : public GCConstant {
    * We keep a non-full chunk at the beginning of the circular linked list
    * and add blocks into that chunk. If the chunk is full, then we allocate
    * an empty chunk from the local cache, and link the empty chunk to the head
-   * of the garbage chain.
+   * of the garbage chain. The tail is the oldest chunk and always points
+   * to the head, such that Reclaim() could detach all full chunks at once.
+   *
+   * Blocks must not be freed until they are unreachable by new operations;
+   * they are recycled only after all threads have passed two epochs.
    */
   void FreeSizeType(void *block_p, int size_type) {
     assert(block_p != nullptr);
@@ -667,9 +701,9 @@ class GCThreadLocal : public GCConstant {
       // Allocate a new chunk from the cache and prepend it to the beginning of
       // the garbage list
       GCChunk *new_chunk_p = GetFreeGCChunkFromCache();
-      new_chunk_p->next_p = garbage_chunk_p->next_p.load();
+      new_chunk_p->next_p = garbage_chunk_p;
       garbage_tail_list[local_epoch][size_type]->next_p = new_chunk_p;
-       garbage_list[local_epoch][size_type] = new_chunk_p;
+      garbage_list[local_epoch][size_type] = new_chunk_p;
       
       garbage_chunk_p = new_chunk_p;
     }
@@ -755,7 +789,18 @@ class ThreadState {
   // Points to the next state object in the linked list
   ThreadState *next_p;
   // Points to the gargabe collection state for the current thread
-  GCGlobalState *gc_p;
+  GCThreadLocal *gc_p;
+  // Nesting level of critical sections; Non-zero means the thread may
+  // hold references to blocks freed in the current epoch
+  unsigned int critical_count;
+
+  // Operation counters of the threads that owned this object. They are
+  // never reset, so readers take differences. See COUNT_OP()
+  uint64_t retry_count;
+  uint64_t cas_failure_count;
+  uint64_t retired_count;
+  uint64_t traversal_count;
+  uint64_t traversal_step_count;
 
   ///////////////////////////////////////////////////////////////////
   // Static data for maintaining the global linked list & thread ID
@@ -826,7 +871,33 @@ class ThreadState {
   inline static ThreadState *EnterCritical() {
     // This is the current thread's local object
     ThreadState *thread_state_p = GetCurrentThreadState();
-    // TODO: ENTER GC
+    GCThreadLocal *gc_p = thread_state_p->gc_p;
+
+    while(1) {
+      unsigned int old_count = thread_state_p->critical_count++;
+      BARRIER();
+
+      // Nested critical sections do not observe new epochs
+      if(old_count != 0) {
+        break;
+      }
+
+      unsigned int new_epoch = GCGlobalState::Get()->current_epoch;
+      if(gc_p->local_epoch != new_epoch) {
+        gc_p->local_epoch = new_epoch;
+        gc_p->entries_since_reclaim = 0U;
+      } else if(gc_p->entries_since_reclaim++ == \
+                GCConstant::ENTRIES_PER_RECLAIM) {
+        // Must leave the critical section because otherwise we would
+        // block the epoch from advancing
+        thread_state_p->critical_count--;
+        gc_p->entries_since_reclaim = 0U;
+        GCGlobalState::Get()->Reclaim();
+        continue;
+      }
+
+      break;
+    }
 
     return thread_state_p;
   }
@@ -838,11 +909,39 @@ class ThreadState {
    * This function is just a simple wrapper over GC
    */
   inline static void LeaveCritical(ThreadState *thread_state_p) {
-    (void)thread_state_p;
-    // TODO: ADD GC LEAVE
+    BARRIER();
+    thread_state_p->critical_count--;
+
     return;
   }
 
+  /*
+   * FreeBlock() - Hands a block over to the epoch based GC
+   *
+   * The caller must be inside a critical section
+   */
+  inline void FreeBlock(void *block_p, int size_type) {
+    assert(critical_count != 0U);
+    gc_p->FreeSizeType(block_p, size_type);
+    COUNT_OP(this, retired_count);
+
+    return;
+  }
+
+  /*
+   * AllocateBlock() - Allocates a block of the given size type
+   */
+  inline void *AllocateBlock(int size_type) {
+    return gc_p->AllocateSizeType(size_type);
+  }
+
+  /*
+   * GetCurrent() - Returns the thread state object of the calling thread
+   */
+  inline static const ThreadState *GetCurrent() {
+    return GetCurrentThreadState();
+  }
+
  private:
   /*
    * GetCurrentThreadState() - This function returns the current thread local
@@ -855,6 +954,8 @@ class ThreadState {
    * memory and then add it into the list and register with pthread
    */
   static ThreadState *GetCurrentThreadState() {
+    assert(inited == true);
+
     // 1. Try to obtain it as a registered per-thread object
     ThreadState *thread_state_p = static_cast<ThreadState *>(
       pthread_getspecific(thread_state_key));
@@ -877,6 +978,8 @@ class ThreadState {
         pthread_setspecific(thread_state_key, thread_state_p);
         return thread_state_p;
       }
+
+      thread_state_p = thread_state_p->next_p;
     }
 
     // If we are here then the while loop exited without finding
@@ -893,8 +996,14 @@ class ThreadState {
     thread_state_p->owned.test_and_set();
     // This atomically increments the counter and returns the old value
     thread_state_p->id = next_id.fetch_add(1U);
-    // TODO: ADD GC INIT HERE ALSO
-    thread_state_p->gc_p = nullptr;
+    // The GC global state must have been initialized before this
+    thread_state_p->gc_p = GCThreadLocal::Get();
+    thread_state_p->critical_count = 0U;
+    thread_state_p->retry_count = 0UL;
+    thread_state_p->cas_failure_count = 0UL;
+    thread_state_p->retired_count = 0UL;
+    thread_state_p->traversal_count = 0UL;
+    thread_state_p->traversal_step_count = 0UL;
 
     // Whether the new node is installed using CAS into the linked list
     bool installed;
@@ -909,10 +1018,72 @@ class ThreadState {
     // Also register this thread local
     pthread_setspecific(thread_state_key, thread_state_p);
 
-    return thread_state_head_p;
+    return thread_state_p;
   }
 };
 
+/*
+ * Reclaim() - Attempts to recycle garbage chunks from previous epochs
+ *
+ * We scan all thread states and check whether every thread inside a critical
+ * section has observed the current epoch. If this is true, then garbage
+ * freed three epochs ago could not be referenced by any thread, and we
+ * move the full chunks of these garbage lists into the global filled chunk
+ * lists (i.e. freed blocks will be allocated again). Finally the epoch is
+ * advanced. Only one thread could reclaim at a time.
+ */
+inline void GCGlobalState::Reclaim() {
+  if(gc_lock.test_and_set() == true) {
+    return;
+  }
+
+  // Grab the first thread state before the barrier
+  ThreadState *first_p = ThreadState::thread_state_head_p.load();
+  BARRIER();
+  int epoch = current_epoch;
+
+  bool all_observed = true;
+  for(ThreadState *p = first_p;p != nullptr;p = p->next_p) {
+    if(p->critical_count != 0U && \
+       p->gc_p->local_epoch != static_cast<unsigned int>(epoch)) {
+      all_observed = false;
+      break;
+    }
+  }
+
+  if(all_observed == true) {
+    int three_ago = (epoch + 1) % NUM_EPOCHS;
+    int size_count = size_type_count.load();
+    for(ThreadState *p = first_p;p != nullptr;p = p->next_p) {
+      GCThreadLocal *gc_p = p->gc_p;
+      for(int i = 0;i < size_count;i++) {
+        // Leave the head chunk behind as it is probably not full yet
+        GCChunk *head_p = gc_p->garbage_list[three_ago][i];
+        if(head_p == nullptr || head_p->next_p.load() == head_p) {
+          continue;
+        }
+
+        GCChunk *first_full_p = head_p->next_p.load();
+        gc_p->garbage_tail_list[three_ago][i]->next_p = first_full_p;
+        gc_p->garbage_tail_list[three_ago][i] = head_p;
+        head_p->next_p = head_p;
+
+        assert(first_full_p->IsFull());
+        GCChunk::LinkInto(first_full_p, filled_chunk_list[i]);
+      }
+    }
+
+    // All lists must be updated before threads observe the new epoch
+    BARRIER();
+    current_epoch = (epoch + 1) % NUM_EPOCHS;
+    epoch_advance_count++;
+  }
+
+  gc_lock.clear();
+
+  return;
+}
+
 /*
  * class RotateSkiplist - Main class of the skip list
  *
@@ -938,9 +1109,867 @@ class RotateSkiplist {
   using ValueType = _ValueType;
   using KeyLess = _KeyLess;
   using KeyEq = _KeyEq;
- 
+
+  // Maximum number of index levels. Index levels of a node are stored
+  // in a wheel of this many slots (see class Node)
+  static constexpr int MAX_INDEX_LEVELS = 30;
+
+  // Microseconds the background thread sleeps between two passes
+  static constexpr int DEFAULT_BG_SLEEP_US = 1;
+
+  // Values are read and written as a whole without locking, and nodes are
+  // recycled by the GC without running destructors
+  static_assert(std::is_trivially_copyable<ValueType>::value,
+                "RotateSkiplist requires a trivially copyable value type");
+  static_assert(std::is_trivially_destructible<KeyType>::value,
+                "RotateSkiplist requires a trivially destructible key type");
+
  private:
-  
+  /*
+   * enum NodeState - The state of the value stored in a node
+   *
+   * A node is logically deleted by moving it from NODE_LIVE to NODE_DELETED,
+   * after which either an insert revives it (through NODE_BUSY, while the new
+   * value is being written), or the background thread starts removing it
+   * physically by moving it to NODE_REMOVED, which is final.
+   */
+  enum NodeState : int {
+    NODE_LIVE = 0,
+    NODE_DELETED,
+    NODE_BUSY,
+    NODE_REMOVED,
+  };
+
+  /*
+   * class Node - Bottom level node, which also carries its index tower
+   *
+   * Index levels are not separate nodes. Instead, succs[] is a wheel and
+   * index level i of all nodes is stored in slot (zero + i) % MAX_INDEX_LEVELS.
+   * Removing the lowest index level then only requires clearing one slot
+   * per index node and advancing zero, which makes the old lowest slot the
+   * new highest slot.
+   */
+  class Node {
+   public:
+    KeyType key;
+    std::atomic<ValueType> value;
+    std::atomic<int> state;
+
+    std::atomic<Node *> prev_p;
+    std::atomic<Node *> next_p;
+
+    // Number of index levels this node is linked into
+    std::atomic<int> level;
+    // Set by the background thread when raising, and by workers before
+    // removing, such that a node is never raised and removed concurrently
+    std::atomic<int> raise_or_remove;
+    // Markers are inserted after a node to freeze its next pointer before
+    // it is unlinked
+    bool marker;
+
+    std::atomic<Node *> succs[MAX_INDEX_LEVELS];
+  };
+
+  // Always points to the same node whose key is never compared
+  Node *head_p;
+  // The slot of index level 0 in the wheel
+  std::atomic<unsigned long> zero;
+
+  KeyLess key_less_obj;
+  KeyEq key_eq_obj;
+
+  ///////////////////////////////////////////////////////////////////
+  // Background thread states
+  ///////////////////////////////////////////////////////////////////
+
+  std::thread bg_thread;
+  std::atomic<bool> bg_finished;
+  int bg_sleep_us;
+  // Whether workers should start removing nodes they deleted
+  std::atomic<bool> bg_should_delete;
+
+  // Counters of the current pass; Only used by the background thread
+  long bg_non_deleted;
+  long bg_deleted;
+  long bg_tall_deleted;
+
+ public:
+
+  /*
+   * Constructor - Initializes GC and thread states on first use, and starts
+   *               the background thread
+   */
+  RotateSkiplist(int p_bg_sleep_us = DEFAULT_BG_SLEEP_US,
+                 const KeyLess &p_key_less_obj = KeyLess{},
+                 const KeyEq &p_key_eq_obj = KeyEq{}) :
+    zero{0UL},
+    key_less_obj{p_key_less_obj},
+    key_eq_obj{p_key_eq_obj},
+    bg_finished{false},
+    bg_sleep_us{p_bg_sleep_us},
+    bg_should_delete{true},
+    bg_non_deleted{0L},
+    bg_deleted{0L},
+    bg_tall_deleted{0L} {
+    InitGlobalState();
+
+    ThreadState *thread_state_p = ThreadState::EnterCritical();
+    // The head has one level whose slot is always nullptr
+    head_p = AllocateNode(thread_state_p, KeyType{}, ValueType{},
+                          nullptr, nullptr, 1, false);
+    ThreadState::LeaveCritical(thread_state_p);
+
+    bg_thread = std::thread{&RotateSkiplist::BackgroundLoop, this};
+
+    return;
+  }
+
+  /*
+   * Destructor - Stops the background thread and hands over all nodes
+   *              still linked in the bottom level to the GC
+   *
+   * No other thread may access the skiplist at this point
+   */
+  ~RotateSkiplist() {
+    bg_finished.store(true);
+    bg_thread.join();
+
+    ThreadState *thread_state_p = ThreadState::EnterCritical();
+    Node *node_p = head_p;
+    while(node_p != nullptr) {
+      Node *next_p = node_p->next_p.load();
+      thread_state_p->FreeBlock(node_p, GetNodeSizeType());
+      node_p = next_p;
+    }
+    ThreadState::LeaveCritical(thread_state_p);
+
+    return;
+  }
+
+  RotateSkiplist(const RotateSkiplist &) = delete;
+  RotateSkiplist &operator=(const RotateSkiplist &) = delete;
+
+  /*
+   * Insert() - Inserts a key value pair
+   *
+   * Returns false if the key already exists
+   */
+  bool Insert(const KeyType &key, const ValueType &value) {
+    int result = DoOperation(key,
+      [this, &key, &value](Node *node_p, int node_state,
+                           Node *next_p, ThreadState *thread_state_p) {
+        if(KeyMatch(key, node_p) == true) {
+          if(node_state == NODE_LIVE) {
+            return 0;
+          } else if(node_state == NODE_DELETED) {
+            return ReviveNode(node_p, value, thread_state_p) ? 1 : -1;
+          }
+
+          // Wait for the concurrent revive or removal
+          return -1;
+        }
+
+        return LinkNewNode(key, value, node_p, next_p, thread_state_p) ? 1 : -1;
+      });
+
+    return result == 1;
+  }
+
+  /*
+   * Upsert() - Inserts a key value pair, or overwrites the existing value
+   *
+   * Returns true if the key did not exist
+   */
+  bool Upsert(const KeyType &key, const ValueType &value) {
+    int result = DoOperation(key,
+      [this, &key, &value](Node *node_p, int node_state,
+                           Node *next_p, ThreadState *thread_state_p) {
+        if(KeyMatch(key, node_p) == true) {
+          if(node_state == NODE_LIVE) {
+            node_p->value.store(value);
+            return 0;
+          } else if(node_state == NODE_DELETED) {
+            return ReviveNode(node_p, value, thread_state_p) ? 1 : -1;
+          }
+
+          return -1;
+        }
+
+        return LinkNewNode(key, value, node_p, next_p, thread_state_p) ? 1 : -1;
+      });
+
+    return result == 1;
+  }
+
+  /*
+   * Delete() - Logically deletes a key
+   *
+   * Physical removal is done by either the worker itself (if the background
+   * thread observed many deleted nodes in its last pass) or the background
+   * thread. Returns false if the key does not exist
+   */
+  bool Delete(const KeyType &key) {
+    int result = DoOperation(key,
+      [this, &key](Node *node_p, int node_state,
+                   Node *next_p, ThreadState *thread_state_p) {
+        (void)node_state;
+        (void)next_p;
+        if(KeyMatch(key, node_p) == false) {
+          return 0;
+        }
+
+        while(1) {
+          int state = node_p->state.load();
+          if(state == NODE_DELETED || state == NODE_REMOVED) {
+            return 0;
+          } else if(state == NODE_BUSY) {
+            continue;
+          }
+
+          if(node_p->state.compare_exchange_strong(state, NODE_DELETED)) {
+            int expected = 0;
+            if(bg_should_delete.load() == true && \
+               node_p->raise_or_remove.compare_exchange_strong(expected, 1)) {
+              Remove(node_p->prev_p.load(), node_p, thread_state_p);
+            }
+
+            return 1;
+          }
+        }
+
+        assert(false);
+        return 0;
+      });
+
+    return result == 1;
+  }
+
+  /*
+   * GetValue() - Looks up a key and copies its value into value_p
+   *
+   * Returns false if the key does not exist
+   */
+  bool GetValue(const KeyType &key, ValueType *value_p) {
+    int result = DoOperation(key,
+      [this, &key, value_p](Node *node_p, int node_state,
+                            Node *next_p, ThreadState *thread_state_p) {
+        (void)next_p;
+        (void)thread_state_p;
+        if(KeyMatch(key, node_p) == true) {
+          if(node_state == NODE_LIVE) {
+            *value_p = node_p->value.load();
+            return 1;
+          } else if(node_state == NODE_BUSY) {
+            return -1;
+          }
+        }
+
+        return 0;
+      });
+
+    return result == 1;
+  }
+
+  /*
+   * Scan() - Appends values of at most count keys that are greater than or
+   *          equal to start_key into value_list_p in key order
+   *
+   * Returns the number of values appended
+   */
+  size_t Scan(const KeyType &start_key,
+              size_t count,
+              std::vector<ValueType> *value_list_p) {
+    size_t scanned = 0UL;
+    DoOperation(start_key,
+      [this, &start_key, count, value_list_p, &scanned](
+        Node *node_p, int node_state,
+        Node *next_p, ThreadState *thread_state_p) {
+        (void)thread_state_p;
+        if(KeyMatch(start_key, node_p) == true && node_state == NODE_LIVE) {
+          value_list_p->push_back(node_p->value.load());
+          scanned++;
+        }
+
+        // Removed nodes still point forward, so we just skip them
+        while(scanned < count && next_p != nullptr) {
+          if(next_p->marker == false && next_p->state.load() == NODE_LIVE) {
+            value_list_p->push_back(next_p->value.load());
+            scanned++;
+          }
+
+          next_p = next_p->next_p.load();
+        }
+
+        return 1;
+      });
+
+    return scanned;
+  }
+
+  /*
+   * GetSize() - Returns the number of live keys
+   *
+   * This is not atomic with concurrent modifications
+   */
+  size_t GetSize() {
+    size_t size = 0UL;
+    ThreadState *thread_state_p = ThreadState::EnterCritical();
+    Node *node_p = head_p->next_p.load();
+    while(node_p != nullptr) {
+      if(node_p->marker == false && node_p->state.load() == NODE_LIVE) {
+        size++;
+      }
+
+      node_p = node_p->next_p.load();
+    }
+    ThreadState::LeaveCritical(thread_state_p);
+
+    return size;
+  }
+
+  /*
+   * GetLevel() - Returns the number of index levels plus one
+   */
+  int GetLevel() const {
+    return head_p->level.load();
+  }
+
+ private:
+  /*
+   * InitGlobalState() - Initializes the GC and thread state singletons
+   *                     if no other skiplist has done so
+   *
+   * This is not thread-safe and should be called from the main thread
+   */
+  static void InitGlobalState() {
+    if(GCGlobalState::Get() == nullptr) {
+      GCGlobalState::Init();
+    }
+
+    if(ThreadState::inited == false) {
+      ThreadState::Init();
+    }
+
+    return;
+  }
+
+  /*
+   * GetNodeSizeType() - Returns the GC size type of nodes, which is
+   *                     registered once per instantiation
+   */
+  static int GetNodeSizeType() {
+    static int node_size_type = \
+      GCGlobalState::Get()->AddSizeType(static_cast<int>(sizeof(Node)));
+    return node_size_type;
+  }
+
+  /*
+   * GetLevelIndex() - Returns the slot of index level i in the wheel
+   */
+  inline static int GetLevelIndex(int i, unsigned long zero_snapshot) {
+    return static_cast<int>((zero_snapshot + i) % MAX_INDEX_LEVELS);
+  }
+
+  inline bool KeyCmpLess(const KeyType &key1, const KeyType &key2) const {
+    return key_less_obj(key1, key2);
+  }
+
+  /*
+   * KeyMatch() - Whether the node is not the head and has the given key
+   */
+  inline bool KeyMatch(const KeyType &key, const Node *node_p) const {
+    return node_p != head_p && key_eq_obj(key, node_p->key);
+  }
+
+  /*
+   * AllocateNode() - Allocates a node from the GC and initializes it
+   */
+  Node *AllocateNode(ThreadState *thread_state_p,
+                     const KeyType &key,
+                     const ValueType &value,
+                     Node *prev_p,
+                     Node *next_p,
+                     int level,
+                     bool marker) {
+    void *block_p = thread_state_p->AllocateBlock(GetNodeSizeType());
+    // Zero-initializes all index slots
+    Node *node_p = new (block_p) Node();
+
+    node_p->key = key;
+    node_p->value.store(value);
+    node_p->state.store(NODE_LIVE);
+    node_p->prev_p.store(prev_p);
+    node_p->next_p.store(next_p);
+    node_p->level.store(level);
+    node_p->raise_or_remove.store(0);
+    node_p->marker = marker;
+
+    assert(node_p->next_p.load() != node_p);
+    return node_p;
+  }
+
+  /*
+   * DoOperation() - Finds the node with the greatest key less than or equal
+   *                 to the search key, and the node after it, and calls
+   *                 finish_func with both
+   *
+   * We first descend the index levels to find an entry point on the node
+   * level, and then walk the node level, backing off from nodes that are
+   * being removed and helping removals that are in progress. finish_func
+   * returns -1 to request a retry from the current position, or the result.
+   */
+  template <typename FinishFunc>
+  int DoOperation(const KeyType &key, FinishFunc finish_func) {
+    ThreadState *thread_state_p = ThreadState::EnterCritical();
+    COUNT_OP(thread_state_p, traversal_count);
+    Node *node_p = FindEntryNode(key, thread_state_p);
+    int result;
+
+    while(1) {
+      // The head is never removed, so this will terminate
+      while(node_p->marker == true || \
+            node_p->state.load() == NODE_REMOVED) {
+        node_p = node_p->prev_p.load();
+      }
+
+      int node_state = node_p->state.load();
+      Node *next_p = node_p->next_p.load();
+      if(next_p != nullptr) {
+        // Markers are only inserted after removed nodes, so node_p
+        // must have been removed after we checked it
+        if(next_p->marker == true) {
+          continue;
+        } else if(next_p->state.load() == NODE_REMOVED) {
+          HelpRemove(node_p, next_p, thread_state_p);
+          continue;
+        }
+      }
+
+      if(next_p == nullptr || KeyCmpLess(key, next_p->key)) {
+        result = finish_func(node_p, node_state, next_p, thread_state_p);
+        if(result != -1) {
+          break;
+        }
+
+        COUNT_OP(thread_state_p, retry_count);
+        continue;
+      }
+
+      node_p = next_p;
+      COUNT_OP(thread_state_p, traversal_step_count);
+    }
+
+    ThreadState::LeaveCritical(thread_state_p);
+
+    return result;
+  }
+
+  /*
+   * FindEntryNode() - Descends the index levels and returns the node with
+   *                   the greatest indexed key that is not greater than the
+   *                   search key
+   *
+   * The index may be modified by the background thread concurrently. This is
+   * fine because the returned node is only used as a starting point.
+   */
+  Node *FindEntryNode(const KeyType &key, ThreadState *thread_state_p) {
+    unsigned long zero_snapshot = zero.load();
+    int i = head_p->level.load() - 1;
+    Node *item_p = head_p;
+
+    while(1) {
+      Node *next_item_p = \
+        item_p->succs[GetLevelIndex(i, zero_snapshot)].load();
+      if(next_item_p == nullptr || KeyCmpLess(key, next_item_p->key)) {
+        if(i == 0) {
+          return item_p;
+        }
+
+        i--;
+      } else {
+        item_p = next_item_p;
+        COUNT_OP(thread_state_p, traversal_step_count);
+      }
+    }
+
+    assert(false);
+    return nullptr;
+  }
+
+  /*
+   * ReviveNode() - Writes a new value into a logically deleted node
+   *
+   * Returns false if the node changed its state concurrently
+   */
+  bool ReviveNode(Node *node_p,
+                  const ValueType &value,
+                  ThreadState *thread_state_p) {
+    int expected = NODE_DELETED;
+    if(node_p->state.compare_exchange_strong(expected, NODE_BUSY) == false) {
+      COUNT_OP(thread_state_p, cas_failure_count);
+      return false;
+    }
+
+    node_p->value.store(value);
+    node_p->state.store(NODE_LIVE);
+
+    return true;
+  }
+
+  /*
+   * LinkNewNode() - Links a new node between node_p and next_p
+   *
+   * Returns false if node_p->next_p has changed
+   */
+  bool LinkNewNode(const KeyType &key,
+                   const ValueType &value,
+                   Node *node_p,
+                   Node *next_p,
+                   ThreadState *thread_state_p) {
+    Node *new_node_p = \
+      AllocateNode(thread_state_p, key, value, node_p, next_p, 0, false);
+    Node *expected_p = next_p;
+    if(node_p->next_p.compare_exchange_strong(expected_p, new_node_p)) {
+      // The prev pointer is only a hint, so failing this is fine
+      if(next_p != nullptr) {
+        Node *old_prev_p = next_p->prev_p.load();
+        next_p->prev_p.compare_exchange_strong(old_prev_p, new_node_p);
+      }
+
+      return true;
+    }
+
+    // The node was never published
+    COUNT_OP(thread_state_p, cas_failure_count);
+    thread_state_p->FreeBlock(new_node_p, GetNodeSizeType());
+
+    return false;
+  }
+
+  /*
+   * HelpRemove() - Finishes physically removing a node
+   *
+   * The node must have been in NODE_REMOVED state. We first insert a marker
+   * after the node such that no node could be inserted after it. Then, if no
+   * node was inserted between prev_p and node_p, unlink both the node and
+   * the marker by pointing prev_p past them.
+   */
+  void HelpRemove(Node *prev_p, Node *node_p, ThreadState *thread_state_p) {
+    if(node_p->state.load() != NODE_REMOVED || node_p->marker == true) {
+      return;
+    }
+
+    Node *n_p = node_p->next_p.load();
+    while(n_p == nullptr || n_p->marker == false) {
+      Node *marker_p = \
+        AllocateNode(thread_state_p, KeyType{}, ValueType{},
+                     node_p, n_p, 0, true);
+      if(node_p->next_p.compare_exchange_strong(n_p, marker_p) == false) {
+        COUNT_OP(thread_state_p, cas_failure_count);
+        thread_state_p->FreeBlock(marker_p, GetNodeSizeType());
+      }
+
+      n_p = node_p->next_p.load();
+    }
+
+    if(prev_p->next_p.load() != node_p || prev_p->marker == true) {
+      return;
+    }
+
+    Node *expected_p = node_p;
+    if(prev_p->next_p.compare_exchange_strong(expected_p, n_p->next_p.load())) {
+      thread_state_p->FreeBlock(node_p, GetNodeSizeType());
+      thread_state_p->FreeBlock(n_p, GetNodeSizeType());
+    }
+
+    // The prev pointer does not need to be exact
+    Node *prev_next_p = prev_p->next_p.load();
+    if(prev_next_p != nullptr) {
+      prev_next_p->prev_p.store(prev_p);
+    }
+
+    return;
+  }
+
+  /*
+   * Remove() - Starts physically removing a logically deleted node
+   *
+   * Only nodes without index levels are removed. Tall nodes are removed
+   * after the index levels they are in have been lowered.
+   */
+  void Remove(Node *prev_p, Node *node_p, ThreadState *thread_state_p) {
+    if(node_p->level.load() != 0) {
+      return;
+    }
+
+    int expected = NODE_DELETED;
+    node_p->state.compare_exchange_strong(expected, NODE_REMOVED);
+    if(node_p->state.load() == NODE_REMOVED) {
+      HelpRemove(prev_p, node_p, thread_state_p);
+    }
+
+    return;
+  }
+
+  ///////////////////////////////////////////////////////////////////
+  // Background maintenance
+  ///////////////////////////////////////////////////////////////////
+
+  /*
+   * BackgroundLoop() - Maintains index levels until the skiplist is destroyed
+   *
+   * Each pass traverses the node level to remove deleted nodes and raise
+   * nodes into index level 0, raises nodes in each index level into the
+   * level above, and lowers the index if there are too many deleted
+   * tall nodes.
+   */
+  void BackgroundLoop() {
+    while(bg_finished.load() == false) {
+      if(bg_sleep_us > 0) {
+        usleep(bg_sleep_us);
+      }
+
+      bg_non_deleted = 0L;
+      bg_deleted = 0L;
+      bg_tall_deleted = 0L;
+
+      bool raised = TraverseNodes();
+      if(raised == true && head_p->level.load() == 1) {
+        AddIndexLevel();
+      }
+
+      for(int i = 0;i + 1 < head_p->level.load();i++) {
+        raised = RaiseIndexLevel(i + 1);
+        if(raised == true && i + 1 == head_p->level.load() - 1) {
+          AddIndexLevel();
+        }
+      }
+
+      if(bg_tall_deleted > bg_non_deleted * 10 && head_p->level.load() > 1) {
+        LowerIndexLevel();
+      }
+
+      bg_should_delete.store(bg_deleted > bg_non_deleted * 3);
+    }
+
+    return;
+  }
+
+  /*
+   * AddIndexLevel() - Adds an empty index level on top of the head
+   */
+  void AddIndexLevel() {
+    int level = head_p->level.load();
+    if(level >= MAX_INDEX_LEVELS) {
+      return;
+    }
+
+    // Clear the slot before it becomes visible to workers
+    head_p->succs[GetLevelIndex(level, zero.load())].store(nullptr);
+    head_p->level.store(level + 1);
+
+    return;
+  }
+
+  /*
+   * FindIndexAbove() - Advances *above_prev_pp and *above_next_pp on index
+   *                    level i such that a node with the given key could be
+   *                    linked between them
+   *
+   * The search starts from above_head_p which is either the head or the node
+   * raised last time, since nodes are raised in key order.
+   */
+  void FindIndexAbove(Node *above_head_p,
+                      Node **above_prev_pp,
+                      Node **above_next_pp,
+                      int i,
+                      const KeyType &key,
+                      unsigned long zero_snapshot) {
+    int slot = GetLevelIndex(i, zero_snapshot);
+    while(*above_next_pp != nullptr && \
+          (*above_next_pp == head_p || \
+           KeyCmpLess((*above_next_pp)->key, key))) {
+      *above_next_pp = (*above_next_pp)->succs[slot].load();
+      if(*above_next_pp != above_head_p->succs[slot].load()) {
+        *above_prev_pp = (*above_prev_pp)->succs[slot].load();
+      }
+    }
+
+    return;
+  }
+
+  /*
+   * TraverseNodes() - Traverses the node level, removes deleted nodes, and
+   *                   raises every node surrounded by nodes without index
+   *                   levels into index level 0
+   *
+   * Returns true if a node was raised
+   */
+  bool TraverseNodes() {
+    ThreadState *thread_state_p = ThreadState::EnterCritical();
+    unsigned long zero_snapshot = zero.load();
+    int slot = GetLevelIndex(0, zero_snapshot);
+    bool raised = false;
+
+    Node *above_head_p = head_p;
+    Node *above_prev_p = head_p;
+    Node *above_next_p = head_p;
+
+    Node *prev_p = head_p;
+    Node *node_p = prev_p->next_p.load();
+    if(node_p == nullptr) {
+      ThreadState::LeaveCritical(thread_state_p);
+      return false;
+    }
+
+    Node *next_p = node_p->next_p.load();
+    while(next_p != nullptr) {
+      if(node_p->marker == false) {
+        int node_state = node_p->state.load();
+        if(node_state == NODE_DELETED) {
+          Remove(prev_p, node_p, thread_state_p);
+          if(node_p->level.load() >= 1) {
+            bg_tall_deleted++;
+          }
+
+          bg_deleted++;
+        } else if(node_state == NODE_LIVE) {
+          int expected = 0;
+          if(prev_p->level.load() == 0 && \
+             node_p->level.load() == 0 && \
+             next_p->level.load() == 0 && \
+             node_p->raise_or_remove.compare_exchange_strong(expected, 1)) {
+            node_p->level.store(1);
+            raised = true;
+
+            FindIndexAbove(above_head_p, &above_prev_p, &above_next_p,
+                           0, node_p->key, zero_snapshot);
+
+            // Link the node to its successor before it becomes reachable
+            node_p->succs[slot].store(above_next_p);
+            above_prev_p->succs[slot].store(node_p);
+
+            above_head_p = above_prev_p = above_next_p = node_p;
+          }
+
+          bg_non_deleted++;
+        }
+      }
+
+      prev_p = node_p;
+      node_p = next_p;
+      next_p = next_p->next_p.load();
+    }
+
+    ThreadState::LeaveCritical(thread_state_p);
+
+    return raised;
+  }
+
+  /*
+   * RaiseIndexLevel() - Raises nodes on index level (h - 1) into level h if
+   *                     both of their neighbours are not on level h
+   *
+   * Returns true if a node was raised
+   */
+  bool RaiseIndexLevel(int h) {
+    ThreadState *thread_state_p = ThreadState::EnterCritical();
+    unsigned long zero_snapshot = zero.load();
+    int below = GetLevelIndex(h - 1, zero_snapshot);
+    int above = GetLevelIndex(h, zero_snapshot);
+    bool raised = false;
+
+    Node *above_head_p = head_p;
+    Node *above_prev_p = head_p;
+    Node *above_next_p = head_p;
+
+    Node *iprev_p = head_p;
+    Node *index_p = iprev_p->succs[below].load();
+    if(index_p == nullptr) {
+      ThreadState::LeaveCritical(thread_state_p);
+      return false;
+    }
+
+    Node *inext_p;
+    while((inext_p = index_p->succs[below].load()) != nullptr) {
+      // Unlink removed nodes from this level
+      while(index_p->state.load() == NODE_REMOVED) {
+        iprev_p->succs[below].store(inext_p);
+        index_p->level.fetch_sub(1);
+
+        if(inext_p == nullptr) {
+          break;
+        }
+
+        index_p = inext_p;
+        inext_p = inext_p->succs[below].load();
+      }
+
+      if(inext_p == nullptr) {
+        break;
+      }
+
+      if(iprev_p->level.load() <= h && \
+         index_p->level.load() == h && \
+         inext_p->level.load() <= h && \
+         index_p->state.load() == NODE_LIVE) {
+        raised = true;
+
+        FindIndexAbove(above_head_p, &above_prev_p, &above_next_p,
+                       h, index_p->key, zero_snapshot);
+
+        index_p->succs[above].store(above_next_p);
+        above_prev_p->succs[above].store(index_p);
+        index_p->level.fetch_add(1);
+
+        assert(index_p->level.load() == h + 1);
+
+        above_head_p = above_prev_p = above_next_p = index_p;
+      }
+
+      iprev_p = index_p;
+      index_p = index_p->succs[below].load();
+    }
+
+    ThreadState::LeaveCritical(thread_state_p);
+
+    return raised;
+  }
+
+  /*
+   * LowerIndexLevel() - Removes index level 0
+   *
+   * All index nodes are on index level 0, so we clear their level 0 slot
+   * and decrement their levels while walking that level, and then rotate
+   * the wheel such that the old level 1 becomes level 0.
+   */
+  void LowerIndexLevel() {
+    ThreadState *thread_state_p = ThreadState::EnterCritical();
+    unsigned long zero_snapshot = zero.load();
+    int slot = GetLevelIndex(0, zero_snapshot);
+
+    Node *node_p = head_p;
+    while(node_p != nullptr) {
+      Node *next_p = node_p->succs[slot].load();
+      if(node_p->marker == false && node_p->level.load() > 0) {
+        // Nodes dropping to the node level could be raised or removed again
+        if(node_p->level.load() == 1) {
+          node_p->raise_or_remove.store(0);
+        }
+
+        node_p->succs[slot].store(nullptr);
+        node_p->level.fetch_sub(1);
+      }
+
+      node_p = next_p;
+    }
+
+    zero.store(zero_snapshot + 1);
+
+    ThreadState::LeaveCritical(thread_state_p);
+
+    return;
+  }
 };
 
 } // end of namespace rotate-skiplist
@@ -1,6 +1,8 @@
 #!/bin/bash
 
 RUNS=1
+# Every phase of every run also appends one JSON record here
+RESULTS_FILE=results.json
 
 for RUN in `seq 1 $RUNS`; do
   for KEY_TYPE in mono rand rdtsc; do
@@ -16,11 +18,8 @@ for RUN in `seq 1 $RUNS`; do
           if [ "$INDEX_TYPE" = "btreeolc" ] && [ "$WORKLOAD_TYPE" == "e" ]; then
             continue
           fi
-          if [ "$INDEX_TYPE" = "artolc" ] && [ "$WORKLOAD_TYPE" == "e" ] && [ "$THREAD_COUNT" -eq 40 ]; then
-            continue
-          fi
 
-          CMD="./workload $WORKLOAD_TYPE $KEY_TYPE $INDEX_TYPE $THREAD_COUNT"
+          CMD="./workload $WORKLOAD_TYPE $KEY_TYPE $INDEX_TYPE $THREAD_COUNT --results $RESULTS_FILE"
           OUTPUT="result_${THREAD_COUNT}_${KEY_TYPE}_${WORKLOAD_TYPE}_${INDEX_TYPE}_${RUN}"
             echo
           echo ===========================================
@@ -1,13 +1,21 @@
 
+#include <cmath>
+
 #include "indexkey.h"
 #include "microbench.h"
 #include "index.h"
+#include "perf_counter.h"
+#include "results.h"
 
 #ifndef _UTIL_H
 #define _UTIL_H
 
 bool hyperthreading = false;
 
+// Whether the driver loops call the index through the virtual Index
+// interface rather than through the concrete adapter type
+bool virtual_dispatch = false;
+
 //This enum enumerates index types we support
 enum {
   TYPE_BWTREE = 0,
@@ -16,6 +24,10 @@ enum {
   TYPE_BTREEOLC,
   TYPE_SKIPLIST,
   TYPE_BTREERTM,
+  TYPE_ROTATE_SKIPLIST,
+  TYPE_MASSTREE_INLINE,
+  TYPE_BWTREE_SMALL,
+  TYPE_BWTREE_LARGE,
   TYPE_NONE,
 };
 
@@ -45,29 +57,152 @@ enum {
 //==============================================================
 // GET INSTANCE
 //==============================================================
+
+/*
+ * DispatchIndexType() - Calls fn with a null pointer of the adapter type of
+ *                       an index type
+ *
+ * This is the only list that maps index types to adapters; getInstance()
+ * and DispatchIndex() are built on top of it. fn must have a templated
+ * operator() taking a pointer to the adapter
+ */
 template<typename KeyType, 
          typename KeyComparator=std::less<KeyType>, 
          typename KeyEuqal=std::equal_to<KeyType>, 
-         typename KeyHash=std::hash<KeyType>>
-Index<KeyType, KeyComparator> *getInstance(const int type, const uint64_t kt) {
+         typename KeyHash=std::hash<KeyType>,
+         typename Fn>
+void DispatchIndexType(const int type, Fn &fn) {
   if (type == TYPE_BWTREE)
-    return new BwTreeIndex<KeyType, KeyComparator, KeyEuqal, KeyHash>(kt);
+    fn(static_cast<BwTreeIndex<KeyType, KeyComparator, KeyEuqal, KeyHash> *>(nullptr));
   else if (type == TYPE_MASSTREE)
-    return new MassTreeIndex<KeyType, KeyComparator>(kt);
+    fn(static_cast<MassTreeIndex<KeyType, KeyComparator> *>(nullptr));
   else if (type == TYPE_ARTOLC)
-      return new ArtOLCIndex<KeyType, KeyComparator>(kt);
+    fn(static_cast<ArtOLCIndex<KeyType, KeyComparator> *>(nullptr));
   else if (type == TYPE_BTREEOLC)
-    return new BTreeOLCIndex<KeyType, KeyComparator>(kt);
+    fn(static_cast<BTreeOLCIndex<KeyType, KeyComparator> *>(nullptr));
   else if (type == TYPE_SKIPLIST)
-    return new SkipListIndex<KeyType, KeyComparator>(kt);
+    fn(static_cast<SkipListIndex<KeyType, KeyComparator> *>(nullptr));
   else if (type == TYPE_BTREERTM)
-    return new BTreeRTMIndex<KeyType, KeyComparator>(kt);
+    fn(static_cast<BTreeRTMIndex<KeyType, KeyComparator> *>(nullptr));
+  else if (type == TYPE_ROTATE_SKIPLIST)
+    fn(static_cast<RotateSkiplistIndex<KeyType, KeyComparator, KeyEuqal> *>(nullptr));
+  else if (type == TYPE_MASSTREE_INLINE)
+    fn(static_cast<MassTreeIndex<KeyType, KeyComparator, true> *>(nullptr));
+  else if (type == TYPE_BWTREE_SMALL)
+    fn(static_cast<BwTreeIndex<KeyType, KeyComparator, KeyEuqal, KeyHash, BwTreeSmallNodeSizing> *>(nullptr));
+  else if (type == TYPE_BWTREE_LARGE)
+    fn(static_cast<BwTreeIndex<KeyType, KeyComparator, KeyEuqal, KeyHash, BwTreeLargeNodeSizing> *>(nullptr));
   else {
     fprintf(stderr, "Unknown index type: %d\n", type);
     exit(1);
   }
-  
-  return nullptr;
+
+  return;
+}
+
+/*
+ * struct IndexFactory - Constructs the adapter it is called with
+ */
+template<typename KeyType, typename KeyComparator>
+struct IndexFactory {
+  const uint64_t kt;
+  Index<KeyType, KeyComparator> *idx;
+
+  template<typename IndexType>
+  void operator()(IndexType *) {
+    idx = new IndexType(kt);
+  }
+};
+
+template<typename KeyType, 
+         typename KeyComparator=std::less<KeyType>, 
+         typename KeyEuqal=std::equal_to<KeyType>, 
+         typename KeyHash=std::hash<KeyType>>
+Index<KeyType, KeyComparator> *getInstance(const int type, const uint64_t kt) {
+  IndexFactory<KeyType, KeyComparator> factory{kt, nullptr};
+  DispatchIndexType<KeyType, KeyComparator, KeyEuqal, KeyHash>(type, factory);
+
+  return factory.idx;
+}
+
+/*
+ * GetIndexName() - Returns the command line name of an index type
+ */
+inline const char *GetIndexName(const int type) {
+  switch(type) {
+    case TYPE_BWTREE: return "bwtree";
+    case TYPE_MASSTREE: return "masstree";
+    case TYPE_ARTOLC: return "artolc";
+    case TYPE_BTREEOLC: return "btreeolc";
+    case TYPE_SKIPLIST: return "skiplist";
+    case TYPE_BTREERTM: return "btreertm";
+    case TYPE_ROTATE_SKIPLIST: return "rotateskiplist";
+    case TYPE_MASSTREE_INLINE: return "masstreeinline";
+    case TYPE_BWTREE_SMALL: return "bwtreesmall";
+    case TYPE_BWTREE_LARGE: return "bwtreelarge";
+    default: return "unknown";
+  }
+}
+
+/*
+ * GetIndexType() - Returns the index type with the given command line name,
+ *                  or -1 if there is none
+ */
+inline int GetIndexType(const char *name) {
+  // This is a special type used for measuring base cost (i.e.
+  // only loading the workload files but do not invoke the index)
+  if(strcmp(name, "none") == 0) {
+    return TYPE_NONE;
+  }
+
+  for(int type = TYPE_BWTREE;type < TYPE_NONE;type++) {
+    if(strcmp(name, GetIndexName(type)) == 0) {
+      return type;
+    }
+  }
+
+  return -1;
+}
+
+/*
+ * struct IndexCaster - Converts an index back to the adapter type it is
+ *                      called with and passes it on to fn
+ */
+template<typename KeyType, typename KeyComparator, typename Fn>
+struct IndexCaster {
+  Index<KeyType, KeyComparator> *idx;
+  Fn &fn;
+
+  template<typename IndexType>
+  void operator()(IndexType *) {
+    fn(static_cast<IndexType *>(idx));
+  }
+};
+
+/*
+ * DispatchIndex() - Calls fn with an index returned by getInstance(),
+ *                   converted back to its adapter type
+ *
+ * fn must have a templated operator() taking a pointer to the index. Calls
+ * through the adapter type are direct (adapters are final) and can be inlined
+ * into the driver loops, so fn is instantiated once per index type. With
+ * virtual_dispatch fn receives the Index pointer instead
+ */
+template<typename KeyType, 
+         typename KeyComparator=std::less<KeyType>, 
+         typename KeyEuqal=std::equal_to<KeyType>, 
+         typename KeyHash=std::hash<KeyType>,
+         typename Fn>
+void DispatchIndex(Index<KeyType, KeyComparator> *idx, const int type, Fn &fn) {
+  if(virtual_dispatch == true) {
+    fn(idx);
+    return;
+  }
+
+  IndexCaster<KeyType, KeyComparator, Fn> caster{idx, fn};
+  DispatchIndexType<KeyType, KeyComparator, KeyEuqal, KeyHash>(type, caster);
+
+  return;
 }
 
 inline double get_now() { 
@@ -107,18 +242,42 @@ static int core_alloc_map_numa[] = {
 
 constexpr static size_t MAX_CORE_NUM = 40;
 
-inline void PinToCore(size_t thread_id) {
-  cpu_set_t cpu_set;
-  CPU_ZERO(&cpu_set);
-
+/*
+ * GetCoreId() - Returns the core a worker thread is pinned to
+ */
+inline int GetCoreId(size_t thread_id) {
   size_t core_id = thread_id % MAX_CORE_NUM;
 
   if(hyperthreading == true) {
-    CPU_SET(core_alloc_map_hyper[core_id], &cpu_set);
-  } else {
-    CPU_SET(core_alloc_map_numa[core_id], &cpu_set);
+    return core_alloc_map_hyper[core_id];
+  }
+
+  return core_alloc_map_numa[core_id];
+}
+
+/*
+ * GetPinning() - Returns the cores of the first thread_num workers as a
+ *                space separated list
+ */
+inline std::string GetPinning(int thread_num) {
+  std::string pinning;
+  for(int i = 0;i < thread_num;i++) {
+    if(i != 0) {
+      pinning += ' ';
+    }
+
+    pinning += std::to_string(GetCoreId(i));
   }
 
+  return pinning;
+}
+
+inline void PinToCore(size_t thread_id) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+
+  CPU_SET(GetCoreId(thread_id), &cpu_set);
+
   int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
   if(ret != 0) {
     fprintf(stderr, "PinToCore() returns non-0\n");
@@ -128,26 +287,42 @@ inline void PinToCore(size_t thread_id) {
   return;
 }
 
-template <typename Fn, typename... Args>
-void StartThreads(Index<keytype, keycomp> *tree_p,
+template <typename KeyType, typename KeyComparator, typename Fn, typename... Args>
+void StartThreads(Index<KeyType, KeyComparator> *tree_p,
                   uint64_t num_threads,
                   Fn &&fn,
                   Args &&...args) {
   std::vector<std::thread> thread_group;
 
+  // Each worker only writes its own slot, and only once it is done
+  std::vector<PaddedIndexStats> stats_slots(num_threads);
+  IndexStats global_stats{};
+
   if(tree_p != nullptr) {
     tree_p->UpdateThreadLocal(num_threads);
+    tree_p->CollectGlobalStats(&global_stats);
   }
 
-  auto fn2 = [tree_p, &fn](uint64_t thread_id, Args ...args) {
+  auto fn2 = [tree_p, &fn, &stats_slots](uint64_t thread_id, Args ...args) {
+    IndexStats start_stats{};
     if(tree_p != nullptr) {
       tree_p->AssignGCID(thread_id);
+      tree_p->CollectThreadStats(&start_stats);
     }
 
     PinToCore(thread_id);
+
+    // Does nothing unless the perf monitor was initialized
+    perf_monitor::ThreadCounters thread_counters{};
+    thread_counters.Start();
     fn(thread_id, args...);
+    thread_counters.Stop();
 
     if(tree_p != nullptr) {
+      IndexStats &thread_stats = stats_slots[thread_id].stats;
+      tree_p->CollectThreadStats(&thread_stats);
+      thread_stats.Subtract(start_stats);
+
       tree_p->UnregisterThread(thread_id);
     }
 
@@ -162,6 +337,17 @@ void StartThreads(Index<keytype, keycomp> *tree_p,
     thread_group[thread_itr].join();
   }
 
+  if(tree_p != nullptr) {
+    IndexStats stats{};
+    tree_p->CollectGlobalStats(&stats);
+    stats.Subtract(global_stats);
+    for(const PaddedIndexStats &slot : stats_slots) {
+      stats.Merge(slot.stats);
+    }
+
+    tree_p->SetStats(stats);
+  }
+
   // Print statistical data before we destruct thread local data
 #ifdef BWTREE_COLLECT_STATISTICS
   tree_p->CollectStatisticalCounter(num_threads);
@@ -174,6 +360,81 @@ void StartThreads(Index<keytype, keycomp> *tree_p,
   return;
 }
 
+/*
+ * SplitList() - Splits a comma separated command line argument
+ */
+inline std::vector<std::string> SplitList(const char *arg) {
+  std::vector<std::string> item_list;
+  std::string item;
+
+  for(const char *p = arg;*p != '\0';p++) {
+    if(*p == ',') {
+      item_list.push_back(item);
+      item.clear();
+    } else {
+      item.push_back(*p);
+    }
+  }
+
+  item_list.push_back(item);
+
+  return item_list;
+}
+
+/*
+ * struct TrialSummary - Mean, sample standard deviation and half width of
+ *                       the 95% confidence interval of repeated trials
+ */
+struct TrialSummary {
+  double mean;
+  double stddev;
+  double ci95;
+};
+
+/*
+ * SummarizeTrials() - Computes the TrialSummary of a list of measurements
+ *
+ * The confidence interval uses Student's t distribution, since there are
+ * usually only a handful of trials. With a single trial stddev and ci95
+ * are 0
+ */
+inline TrialSummary SummarizeTrials(const std::vector<double> &sample_list) {
+  // Two-sided 97.5% quantiles for 1 - 30 degrees of freedom
+  static const double t_list[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+  };
+  static const size_t t_count = sizeof(t_list) / sizeof(double);
+
+  TrialSummary summary{0.0, 0.0, 0.0};
+  size_t n = sample_list.size();
+  if(n == 0) {
+    return summary;
+  }
+
+  for(double sample : sample_list) {
+    summary.mean += sample;
+  }
+
+  summary.mean /= n;
+  if(n == 1) {
+    return summary;
+  }
+
+  double var = 0.0;
+  for(double sample : sample_list) {
+    var += (sample - summary.mean) * (sample - summary.mean);
+  }
+
+  summary.stddev = sqrt(var / (n - 1));
+
+  double t = (n - 1 <= t_count) ? t_list[n - 2] : 1.960;
+  summary.ci95 = t * summary.stddev / sqrt((double)n);
+
+  return summary;
+}
+
 /*
  * GetTxnCount() - Counts transactions and return 
  */
@@ -1,7 +1,7 @@
 
 #include "./pcm/pcm-memory.cpp"
 #include "./pcm/pcm-numa.cpp"
-#include "./papi_util.cpp"
+#include "./mem_monitor.h"
 
 #include "microbench.h"
 
@@ -10,8 +10,20 @@
 #include <atomic>
 
 thread_local long skiplist_steps = 0;
+thread_local long skiplist_ops = 0;
 std::atomic<long> skiplist_total_steps;
 
+// Used for masstree
+uint64_t masstree_rcu_ops = 4096;
+uint64_t masstree_rcu_us = 0;
+
+// Used for BwTree
+bool bwtree_iterator_scan = false;
+bool bwtree_background_gc = false;
+
+// Used for ART
+bool art_node_pool = false;
+
 //#define USE_TBB
 
 #ifdef USE_TBB
@@ -51,12 +63,27 @@ extern bool hyperthreading;
 static bool memory_bandwidth = false;
 // Whether to measure NUMA Throughput
 static bool numa = false;
+// Whether to read per-thread perf counters in each phase
+static bool perf_counters = false;
+// --mem and --numa use PCM as root, and mem_monitor.h otherwise
+static bool use_pcm = false;
+// File that gets one JSON or CSV record per phase (see results.h)
+static const char *results_path = nullptr;
 // Whether we only perform insert
 static bool insert_only = false;
 
 // We could set an upper bound of the number of loaded keys
 static int64_t max_init_key = -1;
 
+// Whether to build the index with BulkLoad() in the load phase, and how
+// full the bulk loaded nodes are (fraction of the split threshold)
+static bool bulk_load = false;
+static double bulk_fill_factor = 0.7;
+
+// Whether to run the workload once for every BwTree node sizing and
+// report throughput and allocation utilization of each
+static bool bwtree_sweep = false;
+
 #include "util.h"
 
 /*
@@ -82,6 +109,52 @@ size_t MemUsage() {
   return rss * (4096 / 1024); // in KiB (not kB)
 }
 
+/*
+ * StartMemoryMonitors() - Starts the --mem and --numa monitors of a phase
+ */
+void StartMemoryMonitors() {
+  if(memory_bandwidth == true) {
+    if(use_pcm == true) {
+      PCM_memory::StartMemoryMonitor();
+    } else {
+      mem_monitor::StartMemoryMonitor();
+    }
+  }
+
+  if(numa == true) {
+    if(use_pcm == true) {
+      PCM_NUMA::StartNUMAMonitor();
+    } else {
+      mem_monitor::StartNUMAMonitor();
+    }
+  }
+
+  return;
+}
+
+/*
+ * EndMemoryMonitors() - Ends and prints the --mem and --numa monitors
+ */
+void EndMemoryMonitors() {
+  if(memory_bandwidth == true) {
+    if(use_pcm == true) {
+      PCM_memory::EndMemoryMonitor();
+    } else {
+      mem_monitor::EndMemoryMonitor();
+    }
+  }
+
+  if(numa == true) {
+    if(use_pcm == true) {
+      PCM_NUMA::EndNUMAMonitor();
+    } else {
+      mem_monitor::EndNUMAMonitor();
+    }
+  }
+
+  return;
+}
+
 //==============================================================
 // LOAD
 //==============================================================
@@ -234,16 +307,25 @@ inline void load(int wl,
 //==============================================================
 // EXEC
 //==============================================================
-inline void exec(int wl, 
-                 int index_type, 
-                 int num_thread,
-                 std::vector<keytype> &init_keys, 
-                 std::vector<keytype> &keys, 
-                 std::vector<uint64_t> &values, 
-                 std::vector<int> &ranges, 
-                 std::vector<int> &ops) {
 
-  Index<keytype, keycomp> *idx = getInstance<keytype, keycomp>(index_type, key_type);
+/*
+ * exec() - Runs the load phase and then the transaction phase on idx, and
+ *          deletes it
+ *
+ * IndexType is either the adapter type of idx or Index<keytype, keycomp>
+ * (see DispatchIndex()). Returns the throughput of the transaction phase
+ * (Mops/sec), or of the load phase if only inserts are executed
+ */
+template <typename IndexType>
+double exec(IndexType *idx,
+            int wl, 
+            int index_type, 
+            int num_thread,
+            std::vector<keytype> &init_keys, 
+            std::vector<keytype> &keys, 
+            std::vector<uint64_t> &values, 
+            std::vector<int> &ranges, 
+            std::vector<int> &ops) {
 
   //WRITE ONLY TEST-----------------
   int count = (int)init_keys.size();
@@ -291,14 +373,15 @@ inline void exec(int wl,
     size_t start_index = key_per_thread * thread_id;
     size_t end_index = start_index + key_per_thread;
    
-    threadinfo *ti = threadinfo::make(threadinfo::TI_MAIN, -1);
-
-    int gc_counter = 0;
+    // Masstree binds its own threadinfo in AssignGCID()
+    threadinfo *ti = nullptr;
+    results::LatencySampler sampler{thread_id};
 #ifdef INTERLEAVED_INSERT
     for(size_t i = thread_id;i < total_num_key;i += num_thread) {
 #else
     for(size_t i = start_index;i < end_index;i++) {
 #endif
+      sampler.Begin(i);
       if(index_type == TYPE_SKIPLIST) {
         idx->insert(init_keys[start_index + end_index - 1 - i], 
                     values[start_index + end_index - 1 - i], 
@@ -310,41 +393,51 @@ inline void exec(int wl,
         idx->insert_bwtree_fast(init_keys[i], values[i]);
 #endif
       }
-      gc_counter++;
-      if(gc_counter % 4096 == 0) {
-        ti->rcu_quiesce();
-      }
+      sampler.End();
     } 
-
-    ti->rcu_quiesce();
     
     return;
   };
  
-  if(memory_bandwidth == true) {
-    PCM_memory::StartMemoryMonitor();
-  }
+  StartMemoryMonitors();
 
-  if(numa == true) {
-    PCM_NUMA::StartNUMAMonitor();
-  }
+  perf_monitor::StartPerfMonitor();
+  results::StartPhase(num_thread);
  
   double start_time = get_now(); 
-  StartThreads(idx, num_thread, func, false);
+  bool bulk_loaded = false;
+  if(bulk_load == true) {
+    // Bulk loading is driven by the main thread, which is the only thread
+    // the perf counters see in this case
+    perf_monitor::ThreadCounters thread_counters{};
+    thread_counters.Start();
+    bulk_loaded = \
+      idx->BulkLoad(init_keys, values, bulk_fill_factor, num_thread);
+    thread_counters.Stop();
+  }
+
+  if(bulk_loaded == true) {
+    fprintf(stderr, "Bulk loaded %d keys\n", count);
+  } else {
+    if(bulk_load == true) {
+      fprintf(stderr, "Bulk load not supported; inserting instead\n");
+    }
+
+    StartThreads(idx, num_thread, func, false);
+  }
   double end_time = get_now();
 
   if(index_type == TYPE_SKIPLIST) {
     fprintf(stderr, "SkipList size = %lu\n", idx->GetIndexSize());
     fprintf(stderr, "Skiplist avg. steps = %f\n", (double)skiplist_total_steps / (double)init_keys.size());
-  }
- 
-  if(memory_bandwidth == true) {
-    PCM_memory::EndMemoryMonitor();
+    bg_print_samples();
   }
 
-  if(numa == true) {
-    PCM_NUMA::EndNUMAMonitor();
-  }
+  idx->PrintGCStats();
+  idx->GetStats().Print();
+  perf_monitor::EndPerfMonitor("load", count);
+ 
+  EndMemoryMonitors();
 #endif   
   
   double tput = count / (end_time - start_time) / 1000000; //Mops/sec
@@ -352,6 +445,15 @@ inline void exec(int wl,
   std::cout << "\033[1;32m";
   std::cout << "insert " << tput << "\033[0m" << "\n";
 
+  results::WritePhase({"load",
+                       GetIndexName(index_type),
+                       num_thread,
+                       (uint64_t)count,
+                       end_time - start_time,
+                       tput,
+                       MemUsage(),
+                       idx->GetStats()});
+
   // Only execute consolidation if BwTree delta chain is used
 #ifdef BWTREE_CONSOLIDATE_AFTER_INSERT
   fprintf(stderr, "Starting consolidating delta chain on each level\n");
@@ -360,8 +462,13 @@ inline void exec(int wl,
 
   // If the workload only executes load phase then we return here
   if(insert_only == true) {
+    // Reports allocation utilization of BwTree nodes
+    if(bwtree_sweep == true) {
+      idx->AfterLoadCallback();
+    }
+
     delete idx;
-    return;
+    return tput;
   }
 
   //READ/UPDATE/SCAN TEST----------------
@@ -381,9 +488,16 @@ inline void exec(int wl,
   read_miss_counter.store(0UL);
   read_hit_counter.store(0UL);
 
+  // Scan results are only folded into a sink so that the calls cannot be
+  // optimized away. What scan() returns differs between indexes (record
+  // counts, value sums), so the sink is never reported.
+  std::atomic<uint64_t> scan_sink{};
+  scan_sink.store(0UL);
+
   auto func2 = [num_thread, 
                 idx, 
                 &read_miss_counter,
+                &scan_sink,
                 &read_hit_counter,
                 &keys,
                 &values,
@@ -397,11 +511,13 @@ inline void exec(int wl,
     std::vector<uint64_t> v;
     v.reserve(10);
  
-    threadinfo *ti = threadinfo::make(threadinfo::TI_MAIN, -1);
-
-    int counter = 0;
+    // Masstree binds its own threadinfo in AssignGCID()
+    threadinfo *ti = nullptr;
+    results::LatencySampler sampler{thread_id};
+    uint64_t local_sink = 0UL;
     for(size_t i = start_index;i < end_index;i++) {
       int op = ops[i];
+      sampler.Begin(i);
       if (op == OP_INSERT) { //INSERT
         idx->insert(keys[i], values[i], ti);
       }
@@ -428,40 +544,26 @@ inline void exec(int wl,
         idx->upsert(keys[i], reinterpret_cast<uint64_t>(&keys[i]), ti);
       }
       else if (op == OP_SCAN) { //SCAN
-        idx->scan(keys[i], ranges[i], ti);
-      }
-
-      counter++;
-      if(counter % 4096 == 0) {
-        ti->rcu_quiesce();
+        local_sink += idx->scan(keys[i], ranges[i], ti);
       }
+      sampler.End();
     }
 
-    // Perform GC after all operations
-    ti->rcu_quiesce();
+    scan_sink.fetch_add(local_sink);
     
     return;
   };
 
-  if(memory_bandwidth == true) {
-    PCM_memory::StartMemoryMonitor();
-  }
+  StartMemoryMonitors();
 
-  if(numa == true) {
-    PCM_NUMA::StartNUMAMonitor();
-  }
+  perf_monitor::StartPerfMonitor();
+  results::StartPhase(num_thread);
 
   start_time = get_now();  
   StartThreads(idx, num_thread, func2, false);
   end_time = get_now();
 
-  if(memory_bandwidth == true) {
-    PCM_memory::EndMemoryMonitor();
-  }
-
-  if(numa == true) {
-    PCM_NUMA::EndNUMAMonitor();
-  }
+  EndMemoryMonitors();
 
   // Print out how many reads have missed in the index (do not have a value)
 #ifdef COUNT_READ_MISS
@@ -473,7 +575,7 @@ inline void exec(int wl,
 
   tput = txn_num / (end_time - start_time) / 1000000; //Mops/sec
 
-  std::cout << "sum = " << sum << "\n";
+  sum = scan_sink.load();
   std::cout << "\033[1;31m";
 
   if (wl == WORKLOAD_A) {  
@@ -492,30 +594,104 @@ inline void exec(int wl,
   if(index_type == TYPE_SKIPLIST) {
     fprintf(stderr, "SkipList size = %lu\n", idx->GetIndexSize());
     fprintf(stderr, "Skiplist avg. steps = %f\n", (double)skiplist_total_steps / (double)init_keys.size());
+    bg_print_samples();
+  }
+
+  idx->PrintGCStats();
+  idx->GetStats().Print();
+  perf_monitor::EndPerfMonitor("txn", txn_num);
+
+  results::WritePhase({"txn",
+                       GetIndexName(index_type),
+                       num_thread,
+                       (uint64_t)txn_num,
+                       end_time - start_time,
+                       tput,
+                       MemUsage(),
+                       idx->GetStats()});
+
+  // Reports allocation utilization of BwTree nodes
+  if(bwtree_sweep == true) {
+    idx->AfterLoadCallback();
   }
 
   delete idx;
 
-  return;
+  return tput;
+}
+
+/*
+ * struct ExecRunner - Passes the arguments of exec() through DispatchIndex()
+ */
+struct ExecRunner {
+  int wl;
+  int index_type;
+  int num_thread;
+  std::vector<keytype> &init_keys;
+  std::vector<keytype> &keys;
+  std::vector<uint64_t> &values;
+  std::vector<int> &ranges;
+  std::vector<int> &ops;
+  double tput;
+
+  template <typename IndexType>
+  void operator()(IndexType *idx) {
+    tput = exec(idx,
+                wl,
+                index_type,
+                num_thread,
+                init_keys,
+                keys,
+                values,
+                ranges,
+                ops);
+  }
+};
+
+/*
+ * exec() - Creates an index of the given type and runs the workload on it
+ */
+inline double exec(int wl, 
+                 int index_type, 
+                 int num_thread,
+                 std::vector<keytype> &init_keys, 
+                 std::vector<keytype> &keys, 
+                 std::vector<uint64_t> &values, 
+                 std::vector<int> &ranges, 
+                 std::vector<int> &ops) {
+  Index<keytype, keycomp> *idx = getInstance<keytype, keycomp>(index_type, key_type);
+
+  ExecRunner runner{wl,
+                    index_type,
+                    num_thread,
+                    init_keys,
+                    keys,
+                    values,
+                    ranges,
+                    ops,
+                    0.0};
+  DispatchIndex<keytype, keycomp>(idx, index_type, runner);
+
+  return runner.tput;
 }
 
 /*
  * run_rdtsc_benchmark() - This function runs the RDTSC benchmark which is a high
  *                         contention insert-only benchmark
  *
- * Note that key num is the total key num
+ * Note that key num is the total key num. Returns the throughput (Mops/sec)
  */
-void run_rdtsc_benchmark(int index_type, int thread_num, int key_num) {
+double run_rdtsc_benchmark(int index_type, int thread_num, int key_num) {
   Index<keytype, keycomp> *idx = getInstance<keytype, keycomp>(index_type, key_type);
 
   auto func = [idx, thread_num, key_num](uint64_t thread_id, bool) {
     size_t key_per_thread = key_num / thread_num;
 
-    threadinfo *ti = threadinfo::make(threadinfo::TI_MAIN, -1);
+    // Masstree binds its own threadinfo in AssignGCID()
+    threadinfo *ti = nullptr;
 
     uint64_t *values = new uint64_t[key_per_thread];
 
-    int gc_counter = 0;
     for(size_t i = 0;i < key_per_thread;i++) {
       // Note that RDTSC may return duplicated keys from different cores
       // to counter this we combine RDTSC with thread IDs to make it unique
@@ -524,30 +700,26 @@ void run_rdtsc_benchmark(int index_type, int thread_num, int key_num) {
       values[i] = key;
       //fprintf(stderr, "%lx\n", key);
       idx->insert(key, reinterpret_cast<uint64_t>(values + i), ti);
-      gc_counter++;
-      if(gc_counter % 4096 == 0) {
-        ti->rcu_quiesce();
-      }
     }
 
-    ti->rcu_quiesce();
-
     delete [] values;
 
     return;
   };
 
-  if(numa == true) {
-    PCM_NUMA::StartNUMAMonitor();
-  }
+  StartMemoryMonitors();
+
+  perf_monitor::StartPerfMonitor();
 
   double start_time = get_now();
   StartThreads(idx, thread_num, func, false);
   double end_time = get_now();
 
-  if(numa == true) {
-    PCM_NUMA::EndNUMAMonitor();
-  }
+  idx->PrintGCStats();
+  idx->GetStats().Print();
+  perf_monitor::EndPerfMonitor("insert", key_num);
+
+  EndMemoryMonitors();
 
   // Only execute consolidation if BwTree delta chain is used
 #ifdef BWTREE_CONSOLIDATE_AFTER_INSERT
@@ -557,6 +729,43 @@ void run_rdtsc_benchmark(int index_type, int thread_num, int key_num) {
   double tput = key_num * 1.0 / (end_time - start_time) / 1000000; //Mops/sec
   std::cout << "insert " << tput << "\n";
 
+  delete idx;
+
+  return tput;
+}
+
+/*
+ * struct MatrixCell - One combination of the matrix mode and the throughput
+ *                     (Mops/sec) of each of its trials
+ */
+struct MatrixCell {
+  const char *workload;
+  const char *key_dist;
+  int index_type;
+  int num_thread;
+  std::vector<double> tput_list;
+};
+
+/*
+ * PrintMatrixCell() - Prints the mean, standard deviation and 95% confidence
+ *                     interval of the throughput of a cell
+ */
+void PrintMatrixCell(const MatrixCell &cell) {
+  TrialSummary summary = SummarizeTrials(cell.tput_list);
+
+  fprintf(stderr,
+          "    %s %s %s %d threads: mean = %f; stddev = %f; "
+          "95%% CI = [%f, %f] (%lu trials)\n",
+          cell.workload,
+          cell.key_dist,
+          GetIndexName(cell.index_type),
+          cell.num_thread,
+          summary.mean,
+          summary.stddev,
+          summary.mean - summary.ci95,
+          summary.mean + summary.ci95,
+          cell.tput_list.size());
+
   return;
 }
 
@@ -564,75 +773,91 @@ int main(int argc, char *argv[]) {
 
   if (argc < 5) {
     std::cout << "Usage:\n";
-    std::cout << "1. workload type: a, c, e, none\n";
+    std::cout << "1. workload type: a, c, e\n";
+    std::cout << "2. key distribution: rand, mono, rdtsc\n";
+    std::cout << "3. index type: bwtree bwtreesmall bwtreelarge skiplist rotateskiplist masstree masstreeinline artolc btreeolc btreertm none\n";
     std::cout << "   \"none\" type means we just load the file and exit. \n"
                  "This serves as the base line for microbenchamrks\n";
-    std::cout << "2. key distribution: rand, mono\n";
-    std::cout << "3. index type: bwtree skiplist masstree artolc btreeolc btreertm\n";
     std::cout << "4. number of threads (integer)\n";
+    std::cout << "   Arguments 1 - 4 may be comma separated lists (e.g. a,c rand bwtree,artolc 1,20);\n"
+                 "   every combination then runs in this process, and each workload file is only read once\n";
     std::cout << "   --hyper: Whether to pin all threads on NUMA node 0\n";
-    std::cout << "   --mem: Whether to monitor memory access\n";
-    std::cout << "   --numa: Whether to monitor NUMA throughput\n";
+    std::cout << "   --mem: Whether to monitor memory access (estimated if not root)\n";
+    std::cout << "   --numa: Whether to monitor NUMA throughput (estimated if not root)\n";
+    std::cout << "   --perf: Whether to read per-thread perf counters in each phase\n";
     std::cout << "   --insert-only: Whether to only execute insert operations\n";
+    std::cout << "   --repeat: Run each combination 5 times\n";
+    std::cout << "   --trials [n]: Run each combination n times\n";
+    std::cout << "   --sl-bg-threads [n]: Number of skiplist background threads\n";
+    std::cout << "   --mt-rcu-ops [n]: Masstree quiesces every n operations (default 4096)\n";
+    std::cout << "   --mt-rcu-us [n]: Masstree quiesces every n microseconds instead\n";
+    std::cout << "   --bulk-load: Build the index with BulkLoad() if supported\n";
+    std::cout << "   --bulk-fill [f]: Bulk loaded node fill factor (default 0.7)\n";
+    std::cout << "   --bwtree-iter-scan: BwTree scans use the iterator instead of Scan()\n";
+    std::cout << "   --bwtree-gc-thread: Reclaim BwTree garbage in the epoch thread\n";
+    std::cout << "   --bwtree-sweep: Run BwTree with every node sizing (bwtree only)\n";
+    std::cout << "   --art-node-pool: Recycle ART nodes through per-thread pools\n";
+    std::cout << "   --virtual: Call the index through the virtual interface (for comparison)\n";
+    std::cout << "   --results [file]: Append a record per phase to file (.csv for CSV, JSON lines otherwise)\n";
     
     return 1;
   }
 
-  // Then read the workload type
-  int wl;
-  if (strcmp(argv[1], "a") == 0) {
-    wl = WORKLOAD_A;
-  } else if (strcmp(argv[1], "c") == 0) {
-    wl = WORKLOAD_C;
-  } else if (strcmp(argv[1], "e") == 0) {
-    wl = WORKLOAD_E;
-  } else {
-    fprintf(stderr, "Unknown workload: %s\n", argv[1]);
-    exit(1);
+  // Then read the workload types
+  std::vector<std::string> wl_name_list = SplitList(argv[1]);
+  std::vector<int> wl_list;
+  for(const std::string &name : wl_name_list) {
+    if (name == "a") {
+      wl_list.push_back(WORKLOAD_A);
+    } else if (name == "c") {
+      wl_list.push_back(WORKLOAD_C);
+    } else if (name == "e") {
+      wl_list.push_back(WORKLOAD_E);
+    } else {
+      fprintf(stderr, "Unknown workload: %s\n", name.c_str());
+      exit(1);
+    }
   }
 
-  // Then read key type
-  int kt;
-  if (strcmp(argv[2], "rand") == 0) {
-    kt = RAND_KEY;
-  } else if (strcmp(argv[2], "mono") == 0) {
-    kt = MONO_KEY;
-  } else if (strcmp(argv[2], "rdtsc") == 0) {
-    kt = RDTSC_KEY;
-  } else {
-    fprintf(stderr, "Unknown key type: %s\n", argv[2]);
-    exit(1);
+  // Then read key types
+  std::vector<std::string> kt_name_list = SplitList(argv[2]);
+  std::vector<int> kt_list;
+  for(const std::string &name : kt_name_list) {
+    if (name == "rand") {
+      kt_list.push_back(RAND_KEY);
+    } else if (name == "mono") {
+      kt_list.push_back(MONO_KEY);
+    } else if (name == "rdtsc") {
+      kt_list.push_back(RDTSC_KEY);
+    } else {
+      fprintf(stderr, "Unknown key type: %s\n", name.c_str());
+      exit(1);
+    }
   }
 
-  int index_type;
-  if (strcmp(argv[3], "bwtree") == 0)
-    index_type = TYPE_BWTREE;
-  else if (strcmp(argv[3], "masstree") == 0)
-    index_type = TYPE_MASSTREE;
-  else if (strcmp(argv[3], "artolc") == 0)
-    index_type = TYPE_ARTOLC;
-  else if (strcmp(argv[3], "btreeolc") == 0)
-    index_type = TYPE_BTREEOLC;
-  else if (strcmp(argv[3], "skiplist") == 0)
-    index_type = TYPE_SKIPLIST;
-  else if (strcmp(argv[3], "btreertm") == 0)
-    index_type = TYPE_BTREERTM;
-  else if (strcmp(argv[3], "none") == 0)
-    // This is a special type used for measuring base cost (i.e.
-    // only loading the workload files but do not invoke the index)
-    index_type = TYPE_NONE;
-  else {
-    fprintf(stderr, "Unknown index type: %d\n", index_type);
-    exit(1);
+  std::vector<int> index_type_list;
+  for(const std::string &name : SplitList(argv[3])) {
+    int index_type = GetIndexType(name.c_str());
+    if(index_type == -1) {
+      fprintf(stderr, "Unknown index type: %s\n", name.c_str());
+      exit(1);
+    }
+
+    index_type_list.push_back(index_type);
   }
   
   // Then read number of threads using command line
-  int num_thread = atoi(argv[4]);
-  if(num_thread < 1 || num_thread > 40) {
-    fprintf(stderr, "Do not support %d threads\n", num_thread);
-    exit(1);
-  } else {
-    fprintf(stderr, "Number of threads: %d\n", num_thread);
+  std::vector<int> num_thread_list;
+  for(const std::string &name : SplitList(argv[4])) {
+    int num_thread = atoi(name.c_str());
+    if(num_thread < 1 || num_thread > 40) {
+      fprintf(stderr, "Do not support %d threads\n", num_thread);
+      exit(1);
+    } else {
+      fprintf(stderr, "Number of threads: %d\n", num_thread);
+    }
+
+    num_thread_list.push_back(num_thread);
   }
   
   // Then read all remianing arguments
@@ -647,11 +872,22 @@ int main(int argc, char *argv[]) {
       memory_bandwidth = true;
     } else if(strcmp(*v, "--numa") == 0) {
       numa = true;
+    } else if(strcmp(*v, "--perf") == 0) {
+      perf_counters = true;
     } else if(strcmp(*v, "--insert-only") == 0) {
       insert_only = true;
     } else if(strcmp(*v, "--repeat") == 0) {
       // If we repeat, then exec() will be called for 5 times
       repeat_counter = 5;
+    } else if(strcmp(*v, "--trials") == 0 && v + 1 != argv_end) {
+      repeat_counter = atoi(*(v + 1));
+      if(repeat_counter < 1) {
+        fprintf(stderr, "Illegal number of trials: %d\n", repeat_counter);
+        exit(1);
+      }
+
+      // Ignore the next argument
+      v++;
     } else if(strcmp(*v, "--max-init-key") == 0) {
       max_init_key = atoll(*(v + 1));
       if(max_init_key <= 0) {
@@ -659,6 +895,66 @@ int main(int argc, char *argv[]) {
         exit(1);
       } 
 
+      // Ignore the next argument
+      v++;
+    } else if(strcmp(*v, "--sl-bg-threads") == 0) {
+      int bg_thread_num = atoi(*(v + 1));
+      if(bg_thread_num < 1) {
+        fprintf(stderr, "Illegal skiplist background threads: %d\n", bg_thread_num);
+        exit(1);
+      }
+
+      fprintf(stderr, "  Skiplist background threads: %d\n", bg_thread_num);
+      bg_set_threads(bg_thread_num);
+
+      // Ignore the next argument
+      v++;
+    } else if(strcmp(*v, "--mt-rcu-ops") == 0) {
+      long rcu_ops = atol(*(v + 1));
+      if(rcu_ops < 1) {
+        fprintf(stderr, "Illegal masstree RCU op interval: %ld\n", rcu_ops);
+        exit(1);
+      }
+
+      fprintf(stderr, "  Masstree quiesces every %ld ops\n", rcu_ops);
+      masstree_rcu_ops = (uint64_t)rcu_ops;
+
+      // Ignore the next argument
+      v++;
+    } else if(strcmp(*v, "--mt-rcu-us") == 0) {
+      long rcu_us = atol(*(v + 1));
+      if(rcu_us < 1) {
+        fprintf(stderr, "Illegal masstree RCU interval: %ld us\n", rcu_us);
+        exit(1);
+      }
+
+      fprintf(stderr, "  Masstree quiesces every %ld us\n", rcu_us);
+      masstree_rcu_us = (uint64_t)rcu_us;
+
+      // Ignore the next argument
+      v++;
+    } else if(strcmp(*v, "--bwtree-sweep") == 0) {
+      bwtree_sweep = true;
+    } else if(strcmp(*v, "--bwtree-iter-scan") == 0) {
+      bwtree_iterator_scan = true;
+    } else if(strcmp(*v, "--bwtree-gc-thread") == 0) {
+      bwtree_background_gc = true;
+    } else if(strcmp(*v, "--virtual") == 0) {
+      virtual_dispatch = true;
+    } else if(strcmp(*v, "--results") == 0 && v + 1 != argv_end) {
+      results_path = *(v + 1);
+      v++;
+    } else if(strcmp(*v, "--art-node-pool") == 0) {
+      art_node_pool = true;
+    } else if(strcmp(*v, "--bulk-load") == 0) {
+      bulk_load = true;
+    } else if(strcmp(*v, "--bulk-fill") == 0) {
+      bulk_fill_factor = atof(*(v + 1));
+      if(bulk_fill_factor <= 0.0 || bulk_fill_factor > 1.0) {
+        fprintf(stderr, "Illegal bulk load fill factor: %f\n", bulk_fill_factor);
+        exit(1);
+      }
+
       // Ignore the next argument
       v++;
     } else {
@@ -672,6 +968,33 @@ int main(int argc, char *argv[]) {
     fprintf(stderr, "  NOTE: Memory is not affected in this case\n");
   }
 
+  if(bulk_load == true) {
+    fprintf(stderr, "  Bulk loading with fill factor %f\n", bulk_fill_factor);
+  }
+
+  if(bwtree_iterator_scan == true) {
+    fprintf(stderr, "  BwTree scans use the iterator\n");
+  }
+
+  if(bwtree_background_gc == true) {
+    fprintf(stderr, "  BwTree garbage is reclaimed by the epoch thread\n");
+  }
+
+  if(art_node_pool == true) {
+    fprintf(stderr, "  ART nodes are recycled through per-thread pools\n");
+  }
+
+  if(bwtree_sweep == true) {
+    if(index_type_list.size() != 1 || index_type_list[0] != TYPE_BWTREE) {
+      fprintf(stderr, "BwTree sweep could only use bwtree\n");
+      exit(1);
+    }
+
+    // Every sizing is a cell of the matrix
+    fprintf(stderr, "  Sweeping BwTree node sizings\n");
+    index_type_list = {TYPE_BWTREE, TYPE_BWTREE_SMALL, TYPE_BWTREE_LARGE};
+  }
+
 #ifdef COUNT_READ_MISS
   fprintf(stderr, "  Counting read misses\n");
 #endif
@@ -696,16 +1019,26 @@ int main(int argc, char *argv[]) {
           LEAF_DELTA_CHAIN_LENGTH_THRESHOLD,
           INNER_DELTA_CHAIN_LENGTH_THRESHOLD);
 
+#ifdef BWTREE_ADAPTIVE_CONSOLIDATION
+  fprintf(stderr, "  Leaf threshold adapts between %d and %d\n",
+          LEAF_DELTA_CHAIN_LENGTH_MIN,
+          LEAF_DELTA_CHAIN_LENGTH_MAX);
+#endif
+
 #ifndef BWTREE_USE_MAPPING_TABLE
   fprintf(stderr, "  BwTree does not use mapping table\n");
-  if(wl != WORKLOAD_C) {
-    fprintf(stderr, "Could only use workload C\n");
-    exit(1);
+  for(int wl : wl_list) {
+    if(wl != WORKLOAD_C) {
+      fprintf(stderr, "Could only use workload C\n");
+      exit(1);
+    }
   }
 
-  if(index_type != TYPE_BWTREE) {
-    fprintf(stderr, "Could only use BwTree\n");
-    exit(1);
+  for(int index_type : index_type_list) {
+    if(index_type != TYPE_BWTREE) {
+      fprintf(stderr, "Could only use BwTree\n");
+      exit(1);
+    }
   }
 #endif
 
@@ -715,8 +1048,10 @@ int main(int argc, char *argv[]) {
 
 #ifndef BWTREE_USE_DELTA_UPDATE
   fprintf(stderr, "  BwTree does not use delta update\n");
-  if(index_type != TYPE_BWTREE) {
-    fprintf(stderr, "Could only use BwTree\n");
+  for(int index_type : index_type_list) {
+    if(index_type != TYPE_BWTREE) {
+      fprintf(stderr, "Could only use BwTree\n");
+    }
   }
 #endif
 
@@ -734,27 +1069,59 @@ int main(int argc, char *argv[]) {
             repeat_counter);
   }
 
-  if(memory_bandwidth == true) {
-    if(geteuid() != 0) {
-      fprintf(stderr, "Please run the program as root in order to measure memory bandwidth\n");
+  size_t cell_count = wl_list.size() * kt_list.size() * \
+                      index_type_list.size() * num_thread_list.size();
+  if(cell_count != 1) {
+    fprintf(stderr, "  Running %lu combinations in process\n", cell_count);
+  }
+
+  if(virtual_dispatch == true) {
+    fprintf(stderr, "  Index calls go through the virtual interface\n");
+  }
+
+  if(results_path != nullptr) {
+    results::RunInfo run_info{wl_name_list[0],
+                              kt_name_list[0],
+                              GetPinning(num_thread_list[0])};
+    if(results::OpenResults(results_path, run_info) == false) {
+      fprintf(stderr, "Could not open results file %s\n", results_path);
       exit(1);
     }
 
-    fprintf(stderr, "  Measuring memory bandwidth\n");
+    fprintf(stderr, "  Writing results to %s\n", results_path);
+  }
 
-    PCM_memory::InitMemoryMonitor();
+  // PCM needs root to access MSRs; otherwise fall back to perf events
+  // and procfs, which only estimate traffic
+  use_pcm = (geteuid() == 0);
+  if((memory_bandwidth == true || numa == true) && use_pcm == false) {
+    fprintf(stderr, "  Not running as root; using perf events instead of PCM\n");
   }
 
-  if(numa == true) {
-    if(geteuid() != 0) {
-      fprintf(stderr, "Please run the program as root in order to measure NUMA operations\n");
-      exit(1);
+  if(memory_bandwidth == true) {
+    fprintf(stderr, "  Measuring memory bandwidth\n");
+
+    if(use_pcm == true) {
+      PCM_memory::InitMemoryMonitor();
+    } else {
+      mem_monitor::InitMemoryMonitor();
     }
+  }
 
+  if(numa == true) {
     fprintf(stderr, "  Measuring NUMA operations\n");
 
     // Call init here to avoid calling it mutiple times
-    PCM_NUMA::InitNUMAMonitor();
+    if(use_pcm == true) {
+      PCM_NUMA::InitNUMAMonitor();
+    } else {
+      mem_monitor::InitNUMAMonitor();
+    }
+  }
+
+  if(perf_counters == true) {
+    fprintf(stderr, "  Measuring perf counters\n");
+    perf_monitor::InitPerfMonitor();
   }
 
   if(insert_only == true) {
@@ -765,14 +1132,21 @@ int main(int argc, char *argv[]) {
   fprintf(stderr, "  BTree element pair count: %lu\n", 
           (uint64_t)btreeolc::BTreeLeaf<uint64_t, uint64_t>::maxEntries);
 
-  // If the key type is RDTSC we just run the special function
-  if(kt != RDTSC_KEY) {
-    std::vector<keytype> init_keys;
-    std::vector<keytype> keys;
-    std::vector<uint64_t> values;
-    std::vector<int> ranges;
-    std::vector<int> ops; //INSERT = 0, READ = 1, UPDATE = 2
+  std::vector<keytype> init_keys;
+  std::vector<keytype> keys;
+  std::vector<uint64_t> values;
+  std::vector<int> ranges;
+  std::vector<int> ops; //INSERT = 0, READ = 1, UPDATE = 2
+
+  // RDTSC keys are generated by the workers and need no buffers
+  bool rdtsc_only = true;
+  for(int kt : kt_list) {
+    if(kt != RDTSC_KEY) {
+      rdtsc_only = false;
+    }
+  }
 
+  if(rdtsc_only == false) {
     init_keys.reserve(50000000);
     keys.reserve(10000000);
     values.reserve(10000000);
@@ -784,22 +1158,84 @@ int main(int argc, char *argv[]) {
     memset(&values[0], 0x00, 10000000 * sizeof(uint64_t));
     memset(&ranges[0], 0x00, 10000000 * sizeof(int));
     memset(&ops[0], 0x00, 10000000 * sizeof(int));
+  }
 
-    load(wl, kt, index_type, init_keys, keys, values, ranges, ops);
-    printf("Finished loading workload file (mem = %lu)\n", MemUsage());
-    if(index_type != TYPE_NONE) {
-      // Then repeat executing the same workload
-      while(repeat_counter > 0) {
-        exec(wl, index_type, num_thread, init_keys, keys, values, ranges, ops);
-        repeat_counter--;
-        printf("Finished running benchmark (mem = %lu)\n", MemUsage());
+  // Every workload file is read once, and all index types and thread
+  // counts run on it; each trial gets a fresh index from exec()
+  std::vector<MatrixCell> cell_list;
+  for(size_t wl_index = 0;wl_index < wl_list.size();wl_index++) {
+    for(size_t kt_index = 0;kt_index < kt_list.size();kt_index++) {
+      int wl = wl_list[wl_index];
+      int kt = kt_list[kt_index];
+
+      // If the key type is RDTSC we just run the special function
+      if(kt != RDTSC_KEY) {
+        init_keys.clear();
+        keys.clear();
+        values.clear();
+        ranges.clear();
+        ops.clear();
+
+        load(wl, kt, index_type_list[0], init_keys, keys, values, ranges, ops);
+        printf("Finished loading workload file (mem = %lu)\n", MemUsage());
+      }
+
+      for(int index_type : index_type_list) {
+        if(index_type == TYPE_NONE) {
+          fprintf(stderr, "Type None is selected - no execution phase\n");
+          continue;
+        }
+
+        for(int num_thread : num_thread_list) {
+          MatrixCell cell{wl_name_list[wl_index].c_str(),
+                          kt_name_list[kt_index].c_str(),
+                          index_type,
+                          num_thread,
+                          {}};
+
+          if(results_path != nullptr) {
+            results::SetRunInfo({cell.workload,
+                                 cell.key_dist,
+                                 GetPinning(num_thread)});
+          }
+
+          if(cell_count != 1) {
+            fprintf(stderr, "Matrix: running %s %s %s with %d threads\n",
+                    cell.workload,
+                    cell.key_dist,
+                    GetIndexName(index_type),
+                    num_thread);
+          }
+
+          // Then repeat executing the same workload
+          for(int i = 0;i < repeat_counter;i++) {
+            if(kt == RDTSC_KEY) {
+              fprintf(stderr, "Running RDTSC benchmark...\n");
+              cell.tput_list.push_back(
+                run_rdtsc_benchmark(index_type, num_thread, 50 * 1000 * 1000));
+            } else {
+              cell.tput_list.push_back(
+                exec(wl, index_type, num_thread, init_keys, keys, values, ranges, ops));
+              printf("Finished running benchmark (mem = %lu)\n", MemUsage());
+            }
+          }
+
+          if(repeat_counter != 1) {
+            PrintMatrixCell(cell);
+          }
+
+          cell_list.push_back(std::move(cell));
+        }
       }
-    } else {
-      fprintf(stderr, "Type None is selected - no execution phase\n");
     }
-  } else {
-    fprintf(stderr, "Running RDTSC benchmark...\n");
-    run_rdtsc_benchmark(index_type, num_thread, 50 * 1000 * 1000);
+  }
+
+  // Allocation utilization of each BwTree sizing is printed by its own run
+  if(cell_list.size() > 1) {
+    fprintf(stderr, "Matrix results (Mops/sec):\n");
+    for(const MatrixCell &cell : cell_list) {
+      PrintMatrixCell(cell);
+    }
   }
 
   exit_cleanup();
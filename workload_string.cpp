@@ -3,15 +3,51 @@
 
 // Used for skiplist
 thread_local long skiplist_steps = 0;
+thread_local long skiplist_ops = 0;
 std::atomic<long> skiplist_total_steps;
 
-typedef GenericKey<31> keytype;
-typedef GenericComparator<31> keycomp;
+// Used for masstree
+uint64_t masstree_rcu_ops = 4096;
+uint64_t masstree_rcu_us = 0;
+
+// Used for BwTree
+bool bwtree_iterator_scan = false;
+bool bwtree_background_gc = false;
+
+// Used for ART
+bool art_node_pool = false;
 
 extern bool hyperthreading;
 
-using KeyEuqalityChecker = GenericEqualityChecker<31>;
-using KeyHashFunc = GenericHasher<31>;
+/*
+ * struct StringKeyTraits - Key type and the functors passed to the indexes
+ *                          for fixed width keys of keySize bytes
+ *
+ * The key holds at most keySize - 1 characters; longer keys are truncated
+ */
+template <std::size_t keySize>
+struct StringKeyTraits {
+  using KeyType = GenericKey<keySize>;
+  using KeyComparator = GenericComparator<keySize>;
+  using KeyEqualityChecker = GenericEqualityChecker<keySize>;
+  using KeyHashFunc = GenericHasher<keySize>;
+};
+
+/*
+ * struct VarKeyTraits - Variable length keys keep the first prefixSize bytes
+ *                       inline and the rest in an arena
+ */
+template <std::size_t prefixSize>
+struct VarKeyTraits {
+  using KeyType = VarKey<prefixSize>;
+  using KeyComparator = VarKeyComparator<prefixSize>;
+  using KeyEqualityChecker = VarKeyEqualityChecker<prefixSize>;
+  using KeyHashFunc = VarKeyHasher<prefixSize>;
+};
+
+// Key width selected with --key-width; 0 means variable length keys
+static const int DEFAULT_KEY_WIDTH = 31;
+static const int VAR_KEY_WIDTH = 0;
 
 static const uint64_t key_type=0;
 static const uint64_t value_type=1; // 0 = random pointers, 1 = pointers to keys
@@ -22,6 +58,10 @@ static const uint64_t value_type=1; // 0 = random pointers, 1 = pointers to keys
 
 // Whether to exit after insert operation
 static bool insert_only = false;
+// Whether to read per-thread perf counters in each phase
+static bool perf_counters = false;
+// File that gets one JSON or CSV record per phase (see results.h)
+static const char *results_path = nullptr;
 
 /*
  * MemUsage() - Reads memory usage from /proc file system
@@ -49,14 +89,17 @@ size_t MemUsage() {
 //==============================================================
 // LOAD
 //==============================================================
-inline void load(int wl, 
-                 int kt, 
-                 int index_type, 
-                 std::vector<keytype> &init_keys, 
-                 std::vector<keytype> &keys, 
-                 std::vector<uint64_t> &values, 
-                 std::vector<int> &ranges, 
-                 std::vector<int> &ops) {
+template <typename KeyTraits>
+void load(int wl, 
+          int kt, 
+          int index_type, 
+          std::vector<typename KeyTraits::KeyType> &init_keys, 
+          std::vector<typename KeyTraits::KeyType> &keys, 
+          std::vector<uint64_t> &values, 
+          std::vector<int> &ranges, 
+          std::vector<int> &ops) {
+  using keytype = typename KeyTraits::KeyType;
+
   std::string init_file;
   std::string txn_file;
 
@@ -134,7 +177,7 @@ inline void load(int wl,
   }
   else {
     while (count < INIT_LIMIT) {
-      values.push_back((uint64_t)init_keys_data[count].data);
+      values.push_back((uint64_t)&init_keys_data[count]);
       count++;
     }
   }
@@ -184,18 +227,24 @@ inline void load(int wl,
 //==============================================================
 // EXEC
 //==============================================================
-inline void exec(int wl, 
-                 int index_type, 
-                 int num_thread, 
-                 std::vector<keytype> &init_keys, 
-                 std::vector<keytype> &keys, 
-                 std::vector<uint64_t> &values, 
-                 std::vector<int> &ranges, 
-                 std::vector<int> &ops) {
-
-  Index<keytype, keycomp> *idx = \
-    getInstance<keytype, keycomp, KeyEuqalityChecker, KeyHashFunc>(index_type, key_type);
 
+/*
+ * exec() - Runs the load phase and then the transaction phase on idx, and
+ *          deletes it
+ *
+ * IndexType is either the adapter type of idx or the Index base class (see
+ * DispatchIndex())
+ */
+template <typename KeyTraits, typename IndexType>
+void exec(IndexType *idx,
+          int wl, 
+          int index_type, 
+          int num_thread, 
+          std::vector<typename KeyTraits::KeyType> &init_keys, 
+          std::vector<typename KeyTraits::KeyType> &keys, 
+          std::vector<uint64_t> &values, 
+          std::vector<int> &ranges, 
+          std::vector<int> &ops) {
   // WRITE ONLY TEST--------------
   int count = (int)init_keys.size();
   double start_time = get_now();
@@ -205,22 +254,20 @@ inline void exec(int wl,
     size_t start_index = key_per_thread * thread_id;
     size_t end_index = start_index + key_per_thread;
 
-    threadinfo *ti = threadinfo::make(threadinfo::TI_MAIN, -1);
-
-    int counter = 0;
+    // Masstree binds its own threadinfo in AssignGCID()
+    threadinfo *ti = nullptr;
+    results::LatencySampler sampler{thread_id};
     for(size_t i = start_index;i < end_index;i++) {
+      sampler.Begin(i);
       idx->insert(init_keys[i], values[i], ti);
-      counter++;
-      if(counter % 4096 == 0) {
-        ti->rcu_quiesce();
-      }
+      sampler.End();
     }
 
-    ti->rcu_quiesce();
-
     return;
   };
 
+  perf_monitor::StartPerfMonitor();
+  results::StartPhase(num_thread);
   StartThreads(idx, num_thread, func, false);
 
   double end_time = get_now();
@@ -228,12 +275,26 @@ inline void exec(int wl,
 
   if(index_type == TYPE_SKIPLIST) {
     fprintf(stderr, "SkipList size = %lu\n", idx->GetIndexSize());
+    bg_print_samples();
   }
+
+  idx->PrintGCStats();
+  idx->GetStats().Print();
+  perf_monitor::EndPerfMonitor("load", count);
   
   std::cout << "\033[1;32m";
   std::cout << "insert " << tput;
   std::cout << "\033[0m" << "\n";
 
+  results::WritePhase({"load",
+                       GetIndexName(index_type),
+                       num_thread,
+                       (uint64_t)count,
+                       end_time - start_time,
+                       tput,
+                       MemUsage(),
+                       idx->GetStats()});
+
   if(insert_only == true) {
     delete idx;
     return;
@@ -244,29 +305,6 @@ inline void exec(int wl,
   int txn_num = GetTxnCount(ops, index_type);
   uint64_t sum = 0;
 
-#ifdef PAPI_IPC
-  //Variables for PAPI
-  float real_time, proc_time, ipc;
-  long long ins;
-  int retval;
-
-  if((retval = PAPI_ipc(&real_time, &proc_time, &ins, &ipc)) < PAPI_OK) {    
-    printf("PAPI error: retval: %d\n", retval);
-    exit(1);
-  }
-#endif
-
-#ifdef PAPI_CACHE
-  int events[3] = {PAPI_L1_TCM, PAPI_L2_TCM, PAPI_L3_TCM};
-  long long counters[3] = {0, 0, 0};
-  int retval;
-
-  if ((retval = PAPI_start_counters(events, 3)) != PAPI_OK) {
-    fprintf(stderr, "PAPI failed to start counters: %s\n", PAPI_strerror(retval));
-    exit(1);
-  }
-#endif
-
   if(values.size() < keys.size()) {
     fprintf(stderr, "Values array too small\n");
     exit(1);
@@ -274,8 +312,15 @@ inline void exec(int wl,
 
   fprintf(stderr, "# of Txn: %d\n", txn_num);
 
+  // Scan results are only folded into a sink so that the calls cannot be
+  // optimized away. What scan() returns differs between indexes (record
+  // counts, value sums), so the sink is never reported.
+  std::atomic<uint64_t> scan_sink{};
+  scan_sink.store(0UL);
+
   auto func2 = [num_thread,
                 idx,
+                &scan_sink,
                 &keys,
                 &values,
                 &ranges,
@@ -288,11 +333,13 @@ inline void exec(int wl,
     std::vector<uint64_t> v;
     v.reserve(10);
 
-    threadinfo *ti = threadinfo::make(threadinfo::TI_MAIN, -1);
-    
-    int counter = 0;
+    // Masstree binds its own threadinfo in AssignGCID()
+    threadinfo *ti = nullptr;
+    results::LatencySampler sampler{thread_id};
+    uint64_t local_sink = 0UL;
     for(size_t i = start_index;i < end_index;i++) {
       int op = ops[i];
+      sampler.Begin(i);
 
       if (op == OP_INSERT) { //INSERT
         idx->insert(keys[i], values[i], ti);
@@ -302,49 +349,30 @@ inline void exec(int wl,
         idx->find(keys[i], &v, ti);
       }
       else if (op == OP_UPSERT) { //UPDATE
-        idx->upsert(keys[i], (uint64_t)keys[i].data, ti);
+        idx->upsert(keys[i], (uint64_t)&keys[i], ti);
       }
       else if (op == OP_SCAN) { //SCAN
-        idx->scan(keys[i], ranges[i], ti);
-      }
-
-      counter++;
-      if(counter % 4096 == 0) {
-        ti->rcu_quiesce();
+        local_sink += idx->scan(keys[i], ranges[i], ti);
       }
+      sampler.End();
     }
 
-    ti->rcu_quiesce();
+    scan_sink.fetch_add(local_sink);
 
     return;
   };
 
+  perf_monitor::StartPerfMonitor();
+  results::StartPhase(num_thread);
   StartThreads(idx, num_thread, func2, false);
 
   end_time = get_now();
 
-#ifdef PAPI_IPC
-  if((retval = PAPI_ipc(&real_time, &proc_time, &ins, &ipc)) < PAPI_OK) {    
-    printf("PAPI error: retval: %d\n", retval);
-    exit(1);
-  }
-
-  std::cout << "Time = " << real_time << "\n";
-  std::cout << "Tput = " << LIMIT/real_time << "\n";
-  std::cout << "Inst = " << ins << "\n";
-  std::cout << "IPC = " << ipc << "\n";
-#endif
-
-#ifdef PAPI_CACHE
-  if ((retval = PAPI_read_counters(counters, 3)) != PAPI_OK) {
-    fprintf(stderr, "PAPI failed to read counters: %s\n", PAPI_strerror(retval));
-    exit(1);
-  }
+  idx->PrintGCStats();
+  idx->GetStats().Print();
+  perf_monitor::EndPerfMonitor("txn", txn_num);
 
-  std::cout << "L1 miss = " << counters[0] << "\n";
-  std::cout << "L2 miss = " << counters[1] << "\n";
-  std::cout << "L3 miss = " << counters[2] << "\n";
-#endif
+  sum = scan_sink.load();
 
   tput = txn_num / (end_time - start_time) / 1000000; //Mops/sec
 
@@ -365,22 +393,130 @@ inline void exec(int wl,
 
   std::cout << "\033[0m" << "\n";
 
+  results::WritePhase({"txn",
+                       GetIndexName(index_type),
+                       num_thread,
+                       (uint64_t)txn_num,
+                       end_time - start_time,
+                       tput,
+                       MemUsage(),
+                       idx->GetStats()});
+
   delete idx;
 
   return;
 }
 
+/*
+ * struct ExecRunner - Passes the arguments of exec() through DispatchIndex()
+ */
+template <typename KeyTraits>
+struct ExecRunner {
+  int wl;
+  int index_type;
+  int num_thread;
+  std::vector<typename KeyTraits::KeyType> &init_keys;
+  std::vector<typename KeyTraits::KeyType> &keys;
+  std::vector<uint64_t> &values;
+  std::vector<int> &ranges;
+  std::vector<int> &ops;
+
+  template <typename IndexType>
+  void operator()(IndexType *idx) {
+    exec<KeyTraits>(idx,
+                    wl,
+                    index_type,
+                    num_thread,
+                    init_keys,
+                    keys,
+                    values,
+                    ranges,
+                    ops);
+  }
+};
+
+/*
+ * exec() - Creates an index of the given type and runs the workload on it
+ */
+template <typename KeyTraits>
+void exec(int wl, 
+          int index_type, 
+          int num_thread, 
+          std::vector<typename KeyTraits::KeyType> &init_keys, 
+          std::vector<typename KeyTraits::KeyType> &keys, 
+          std::vector<uint64_t> &values, 
+          std::vector<int> &ranges, 
+          std::vector<int> &ops) {
+  using keytype = typename KeyTraits::KeyType;
+  using keycomp = typename KeyTraits::KeyComparator;
+
+  Index<keytype, keycomp> *idx = \
+    getInstance<keytype,
+                keycomp,
+                typename KeyTraits::KeyEqualityChecker,
+                typename KeyTraits::KeyHashFunc>(index_type, key_type);
+
+  ExecRunner<KeyTraits> runner{wl,
+                               index_type,
+                               num_thread,
+                               init_keys,
+                               keys,
+                               values,
+                               ranges,
+                               ops};
+  DispatchIndex<keytype,
+                keycomp,
+                typename KeyTraits::KeyEqualityChecker,
+                typename KeyTraits::KeyHashFunc>(idx, index_type, runner);
+
+  return;
+}
+
+/*
+ * run() - Loads the workload with keys of the given traits and executes it
+ */
+template <typename KeyTraits>
+void run(int wl, int kt, int index_type, int num_thread, int repeat_counter) {
+  using keytype = typename KeyTraits::KeyType;
+
+  fprintf(stderr, "sizeof(KeyType) = %lu\n", sizeof(keytype));
+
+  std::vector<keytype> init_keys;
+  std::vector<keytype> keys;
+  std::vector<uint64_t> values;
+  std::vector<int> ranges;
+  std::vector<int> ops; //INSERT = 0, READ = 1, UPDATE = 2
+
+  load<KeyTraits>(wl, kt, index_type, init_keys, keys, values, ranges, ops);
+  fprintf(stderr, "Finish loading (Mem = %lu)\n", MemUsage());
+
+  while(repeat_counter > 0) {
+    exec<KeyTraits>(wl, index_type, num_thread, init_keys, keys, values, ranges, ops);
+    fprintf(stderr, "Finished execution (Mem = %lu)\n", MemUsage());
+    repeat_counter--;
+  }
+
+  return;
+}
+
 int main(int argc, char *argv[]) {
 
   if (argc < 5) {
     std::cout << "Usage:\n";
     std::cout << "1. workload type: a, c, e\n";
     std::cout << "2. key distribution: email\n";
-    std::cout << "3. index type: bwtree skiplist masstree artolc btreeolc\n";
+    std::cout << "3. index type: bwtree skiplist rotateskiplist masstree masstreeinline artolc btreeolc\n";
     std::cout << "4. Number of threads: (1 - 40)\n";
     std::cout << "   --hyper: Whether to pin all threads on NUMA node 0\n";
     std::cout << "   --insert-only: Whether to only execute insert operations\n";
+    std::cout << "   --perf: Whether to read per-thread perf counters in each phase\n";
     std::cout << "   --repeat: Repeat 5 times\n";
+    std::cout << "   --sl-bg-threads [n]: Number of skiplist background threads\n";
+    std::cout << "   --mt-rcu-ops [n]: Masstree quiesces every n operations (default 4096)\n";
+    std::cout << "   --mt-rcu-us [n]: Masstree quiesces every n microseconds instead\n";
+    std::cout << "   --key-width [n]: Key width in bytes: 8, 16, 31 (default), 32, 64, 128 or var\n";
+    std::cout << "   --virtual: Call the index through the virtual interface (for comparison)\n";
+    std::cout << "   --results [file]: Append a record per phase to file (.csv for CSV, JSON lines otherwise)\n";
     return 1;
   }
 
@@ -414,6 +550,10 @@ int main(int argc, char *argv[]) {
     index_type = TYPE_BTREEOLC;
   } else if (strcmp(argv[3], "skiplist") == 0) { 
     index_type = TYPE_SKIPLIST;
+  } else if (strcmp(argv[3], "rotateskiplist") == 0) {
+    index_type = TYPE_ROTATE_SKIPLIST;
+  } else if (strcmp(argv[3], "masstreeinline") == 0) {
+    index_type = TYPE_MASSTREE_INLINE;
   } else {
     fprintf(stderr, "Unknown index type: %d\n", index_type);
     exit(1);
@@ -433,9 +573,16 @@ int main(int argc, char *argv[]) {
           LEAF_DELTA_CHAIN_LENGTH_THRESHOLD,
           INNER_DELTA_CHAIN_LENGTH_THRESHOLD);
 
+#ifdef BWTREE_ADAPTIVE_CONSOLIDATION
+  fprintf(stderr, "  Leaf threshold adapts between %d and %d\n",
+          LEAF_DELTA_CHAIN_LENGTH_MIN,
+          LEAF_DELTA_CHAIN_LENGTH_MAX);
+#endif
+
 
   // Then read all remianing arguments
   int repeat_counter = 1;
+  int key_width = DEFAULT_KEY_WIDTH;
   char **argv_end = argv + argc;
   for(char **v = argv + 5;v != argv_end;v++) {
     if(strcmp(*v, "--hyper") == 0) {
@@ -443,8 +590,51 @@ int main(int argc, char *argv[]) {
       hyperthreading = true;
     } else if(strcmp(*v, "--insert-only") == 0) {
       insert_only = true;
+    } else if(strcmp(*v, "--perf") == 0) {
+      perf_counters = true;
     } else if(strcmp(*v, "--repeat") == 0) {
       repeat_counter = 5;
+    } else if(strcmp(*v, "--sl-bg-threads") == 0 && v + 1 != argv_end) {
+      int bg_thread_num = atoi(*(v + 1));
+      fprintf(stderr, "  Skiplist background threads: %d\n", bg_thread_num);
+      bg_set_threads(bg_thread_num);
+      v++;
+    } else if(strcmp(*v, "--bwtree-iter-scan") == 0) {
+      fprintf(stderr, "  BwTree scans use the iterator\n");
+      bwtree_iterator_scan = true;
+    } else if(strcmp(*v, "--bwtree-gc-thread") == 0) {
+      fprintf(stderr, "  BwTree garbage is reclaimed by the epoch thread\n");
+      bwtree_background_gc = true;
+    } else if(strcmp(*v, "--results") == 0 && v + 1 != argv_end) {
+      results_path = *(v + 1);
+      v++;
+    } else if(strcmp(*v, "--virtual") == 0) {
+      fprintf(stderr, "  Index calls go through the virtual interface\n");
+      virtual_dispatch = true;
+    } else if(strcmp(*v, "--art-node-pool") == 0) {
+      fprintf(stderr, "  ART nodes are recycled through per-thread pools\n");
+      art_node_pool = true;
+    } else if(strcmp(*v, "--key-width") == 0 && v + 1 != argv_end) {
+      if(strcmp(*(v + 1), "var") == 0) {
+        key_width = VAR_KEY_WIDTH;
+      } else {
+        key_width = atoi(*(v + 1));
+      }
+      v++;
+    } else if(strcmp(*v, "--mt-rcu-ops") == 0 && v + 1 != argv_end) {
+      long rcu_ops = atol(*(v + 1));
+      if(rcu_ops > 0) {
+        fprintf(stderr, "  Masstree quiesces every %ld ops\n", rcu_ops);
+        masstree_rcu_ops = (uint64_t)rcu_ops;
+      }
+      v++;
+    } else if(strcmp(*v, "--mt-rcu-us") == 0 && v + 1 != argv_end) {
+      long rcu_us = atol(*(v + 1));
+      if(rcu_us > 0) {
+        fprintf(stderr, "  Masstree quiesces every %ld us\n", rcu_us);
+        masstree_rcu_us = (uint64_t)rcu_us;
+      }
+      v++;
     }
   }
 
@@ -456,6 +646,11 @@ int main(int argc, char *argv[]) {
     fprintf(stderr, "  Insert-only mode\n");
   }
 
+  if(perf_counters == true) {
+    fprintf(stderr, "  Measuring perf counters\n");
+    perf_monitor::InitPerfMonitor();
+  }
+
 #ifdef USE_27MB_FILE
   fprintf(stderr, "  Using 27MB workload file\n");
 #endif 
@@ -466,19 +661,54 @@ int main(int argc, char *argv[]) {
 
   fprintf(stderr, "index type = %d\n", index_type);
 
-  std::vector<keytype> init_keys;
-  std::vector<keytype> keys;
-  std::vector<uint64_t> values;
-  std::vector<int> ranges;
-  std::vector<int> ops; //INSERT = 0, READ = 1, UPDATE = 2
+  if(key_width == VAR_KEY_WIDTH) {
+    fprintf(stderr, "  Key width: variable\n");
+  } else {
+    fprintf(stderr, "  Key width: %d\n", key_width);
+  }
 
-  load(wl, kt, index_type, init_keys, keys, values, ranges, ops);
-  fprintf(stderr, "Finish loading (Mem = %lu)\n", MemUsage());
+  if(results_path != nullptr) {
+    std::string key_type_name{argv[2]};
+    if(key_width == VAR_KEY_WIDTH) {
+      key_type_name += "_var";
+    } else {
+      key_type_name += "_" + std::to_string(key_width);
+    }
 
-  while(repeat_counter > 0) {
-    exec(wl, index_type, num_thread, init_keys, keys, values, ranges, ops);
-    fprintf(stderr, "Finished execution (Mem = %lu)\n", MemUsage());
-    repeat_counter--;
+    results::RunInfo run_info{argv[1], key_type_name, GetPinning(num_thread)};
+    if(results::OpenResults(results_path, run_info) == false) {
+      fprintf(stderr, "Could not open results file %s\n", results_path);
+      exit(1);
+    }
+
+    fprintf(stderr, "  Writing results to %s\n", results_path);
+  }
+
+  switch(key_width) {
+    case VAR_KEY_WIDTH:
+      run<VarKeyTraits<16>>(wl, kt, index_type, num_thread, repeat_counter);
+      break;
+    case 8:
+      run<StringKeyTraits<8>>(wl, kt, index_type, num_thread, repeat_counter);
+      break;
+    case 16:
+      run<StringKeyTraits<16>>(wl, kt, index_type, num_thread, repeat_counter);
+      break;
+    case 31:
+      run<StringKeyTraits<31>>(wl, kt, index_type, num_thread, repeat_counter);
+      break;
+    case 32:
+      run<StringKeyTraits<32>>(wl, kt, index_type, num_thread, repeat_counter);
+      break;
+    case 64:
+      run<StringKeyTraits<64>>(wl, kt, index_type, num_thread, repeat_counter);
+      break;
+    case 128:
+      run<StringKeyTraits<128>>(wl, kt, index_type, num_thread, repeat_counter);
+      break;
+    default:
+      fprintf(stderr, "Unsupported key width: %d\n", key_width);
+      exit(1);
   }
 
   return 0;